@@ -155,6 +155,13 @@ struct {  \
     __BPF_MAP_DEF(key_type, value_type, max_entries); \
 } __##name SEC(".maps");
 
+// BPF_MAP_TYPE_RINGBUF define (Linux 5.8+), max_entries为buffer字节数（2的次幂）
+#define MAP_RINGBUF(name, max_entries) \
+struct {  \
+    __uint(type, BPF_MAP_TYPE_RINGBUF); \
+    __uint(max_entries, (max_entries)); \
+} __##name SEC(".maps");
+
 #define MAP_HASH(name, key_type, value_type, max_entries) \
 struct { \
     __uint(type, BPF_MAP_TYPE_HASH); \
@@ -173,6 +180,37 @@ static __always_inline __attribute__((unused)) int name ## __delete(key_type *ke
     return bpf_map_delete_elem(& __##name, (const void *)key); \
 }
 
+/*
+ * LRU hash（Linux 4.10+，本项目最低支持4.14）。map满时由内核淘汰
+ * 最久未访问的表项，省去用户态的扫描回收。访问接口与MAP_HASH一致。
+ */
+#define MAP_LRU_HASH(name, key_type, value_type, max_entries) \
+struct { \
+    __uint(type, BPF_MAP_TYPE_LRU_HASH); \
+    __BPF_MAP_DEF(key_type, value_type, max_entries); \
+} __##name SEC(".maps"); \
+static __always_inline __attribute__((unused)) value_type * name ## __lookup(key_type *key) \
+{ \
+    return (value_type *) bpf_map_lookup_elem(& __##name, (const void *)key); \
+} \
+static __always_inline __attribute__((unused)) int name ## __update(key_type *key, value_type *value) \
+{ \
+    return bpf_map_update_elem(& __##name, (const void *)key, (const void *)value, BPF_ANY); \
+} \
+static __always_inline __attribute__((unused)) int name ## __delete(key_type *key) \
+{ \
+    return bpf_map_delete_elem(& __##name, (const void *)key); \
+}
+
+#define BPF_LRU_HASH3(_name, _key_type, _leaf_type) \
+  MAP_LRU_HASH(_name, _key_type, _leaf_type, 40960)
+
+#define BPF_LRU_HASH4(_name, _key_type, _leaf_type, _size) \
+  MAP_LRU_HASH(_name, _key_type, _leaf_type, _size)
+
+#define BPF_LRU_HASH(...) \
+  BPF_HASHX(__VA_ARGS__, BPF_LRU_HASH4, BPF_LRU_HASH3)(__VA_ARGS__)
+
 #define BPF_HASH3(_name, _key_type, _leaf_type) \
   MAP_HASH(_name, _key_type, _leaf_type, 40960)
 
@@ -1047,6 +1047,28 @@ static __inline enum message_type infer_kafka_message(const char *buf,
 	return MSG_UNKNOWN;
 }
 
+/*
+ * 推断成功后记录 服务端端口 -> L7协议 的启发项。请求方向的对端
+ * 端口、响应方向的本端端口更可能是服务端监听端口。
+ */
+static __inline void update_proto_infer_hint(const struct conn_info_t
+					     *conn_info,
+					     const struct protocol_message_t
+					     *msg)
+{
+	if (msg->protocol == PROTO_UNKNOWN)
+		return;
+
+	__u16 port;
+	if ((msg->type == MSG_REQUEST) == (conn_info->direction == T_EGRESS))
+		port = conn_info->tuple.dport;
+	else
+		port = conn_info->tuple.num;
+
+	__u8 proto = (__u8) msg->protocol;
+	proto_infer_hint_map__update(&port, &proto);
+}
+
 static __inline bool drop_msg_by_comm(void)
 {
 	char comm[16];
@@ -1104,6 +1126,83 @@ static __inline struct protocol_message_t infer_protocol(const char *buf,
 	if (count < 4 || conn_info->sk == NULL)
 		return inferred_message;
 
+	/*
+	 * 快速路径：socket的L7协议一旦被确认后实际不会再改变，直接走
+	 * 已确认协议的消息类型判断，跳过整个推断级联。
+	 */
+	if (is_socket_info_valid(conn_info->socket_info_ptr) &&
+	    conn_info->socket_info_ptr->l7_proto != PROTO_UNKNOWN) {
+		struct socket_info_t *sk_info = conn_info->socket_info_ptr;
+		char fast_buf[DATA_BUF_MAX];
+		bpf_probe_read(&fast_buf, sizeof(fast_buf), buf);
+
+		// MySQL、Kafka的消息类型判断需要4字节的预存数据
+		if (sk_info->l7_proto == PROTO_MYSQL ||
+		    sk_info->l7_proto == PROTO_KAFKA) {
+			if (count == 4) {
+				*(__u32 *) sk_info->prev_data =
+				    *(__u32 *) fast_buf;
+				sk_info->prev_data_len = 4;
+				sk_info->direction = conn_info->direction;
+				inferred_message.type = MSG_PRESTORE;
+				return inferred_message;
+			}
+
+			if (sk_info->prev_data_len != 0) {
+				if (conn_info->direction != sk_info->direction)
+					return inferred_message;
+
+				*(__u32 *) conn_info->prev_buf =
+				    *(__u32 *) sk_info->prev_data;
+				conn_info->prev_count = 4;
+				sk_info->prev_data_len = 0;
+			}
+		}
+
+		switch (sk_info->l7_proto) {
+		case PROTO_HTTP1:
+			inferred_message.type =
+			    infer_http_message(fast_buf, count, conn_info);
+			break;
+		case PROTO_REDIS:
+			inferred_message.type =
+			    infer_redis_message(fast_buf, count, conn_info);
+			break;
+		case PROTO_MQTT:
+			inferred_message.type =
+			    infer_mqtt_message(fast_buf, count, conn_info);
+			break;
+		case PROTO_DUBBO:
+			inferred_message.type =
+			    infer_dubbo_message(fast_buf, count, conn_info);
+			break;
+		case PROTO_DNS:
+			inferred_message.type =
+			    infer_dns_message(fast_buf, count, conn_info);
+			break;
+		case PROTO_HTTP2:
+			inferred_message.type =
+			    infer_http2_message(buf, count, conn_info);
+			break;
+		case PROTO_MYSQL:
+			inferred_message.type =
+			    infer_mysql_message(fast_buf, count, conn_info);
+			break;
+		case PROTO_KAFKA:
+			inferred_message.type =
+			    infer_kafka_message(fast_buf, count, conn_info);
+			break;
+		default:
+			break;
+		}
+
+		if (inferred_message.type != MSG_UNKNOWN &&
+		    inferred_message.type != MSG_PRESTORE)
+			inferred_message.protocol = sk_info->l7_proto;
+
+		return inferred_message;
+	}
+
 	// 明确被判定了协议的socket不进入drop_msg_by_comm
 	if (!is_socket_info_valid(conn_info->socket_info_ptr)) {
 		if (drop_msg_by_comm())
@@ -1113,6 +1212,49 @@ static __inline struct protocol_message_t infer_protocol(const char *buf,
 	char infer_buf[DATA_BUF_MAX];
 	bpf_probe_read(&infer_buf, sizeof(infer_buf), buf);
 
+	/*
+	 * 端口命中启发：未确认协议的新连接优先只执行该服务端口上次
+	 * 推断成功的那个matcher，命中则跳过整个级联；未命中再走完整
+	 * 级联确认。需要4字节预存数据的MySQL/Kafka与级联逻辑耦合，
+	 * 不参与快速尝试。
+	 */
+	__u8 *hint = proto_infer_hint_map__lookup(&conn_info->tuple.dport);
+	if (hint == NULL)
+		hint = proto_infer_hint_map__lookup(&conn_info->tuple.num);
+	if (hint != NULL) {
+		enum message_type hint_type = MSG_UNKNOWN;
+		switch (*hint) {
+		case PROTO_HTTP1:
+			hint_type =
+			    infer_http_message(infer_buf, count, conn_info);
+			break;
+		case PROTO_REDIS:
+			hint_type =
+			    infer_redis_message(infer_buf, count, conn_info);
+			break;
+		case PROTO_MQTT:
+			hint_type =
+			    infer_mqtt_message(infer_buf, count, conn_info);
+			break;
+		case PROTO_DUBBO:
+			hint_type =
+			    infer_dubbo_message(infer_buf, count, conn_info);
+			break;
+		case PROTO_DNS:
+			hint_type =
+			    infer_dns_message(infer_buf, count, conn_info);
+			break;
+		default:
+			break;
+		}
+
+		if (hint_type != MSG_UNKNOWN) {
+			inferred_message.type = hint_type;
+			inferred_message.protocol = *hint;
+			return inferred_message;
+		}
+	}
+
 	/*
 	 * 为了提高协议推断的准确率，做了一下处理：
 	 *
@@ -1148,8 +1290,10 @@ static __inline struct protocol_message_t infer_protocol(const char *buf,
 		inferred_message.protocol = PROTO_DNS;
 	}
 
-	if (inferred_message.protocol != MSG_UNKNOWN)
+	if (inferred_message.protocol != MSG_UNKNOWN) {
+		update_proto_infer_hint(conn_info, &inferred_message);
 		return inferred_message;
+	}
 
 	if (count == 4) {
 		if (is_socket_info_valid(conn_info->socket_info_ptr)) {
@@ -1196,6 +1340,7 @@ static __inline struct protocol_message_t infer_protocol(const char *buf,
 		inferred_message.protocol = PROTO_KAFKA;
 	}
 
+	update_proto_infer_hint(conn_info, &inferred_message);
 	return inferred_message;
 }
 
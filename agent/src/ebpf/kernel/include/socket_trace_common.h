@@ -123,6 +123,39 @@ struct trace_info_t {
 	__u64 socket_id; // Records the socket associated when tracing was created (记录创建追踪时关联的socket)
 };
 
+/*
+ * 内核侧数据过滤配置。在数据提交给perf buffer之前消费，被过滤掉的
+ * 流量不会产生任何下游（perf输出、用户态拷贝）开销。
+ */
+// pid过滤方式
+enum {
+	FILTER_PID_OFF = 0,	// 不进行pid过滤
+	FILTER_PID_ALLOW,	// 只放行__filter_pid_map中的pid
+	FILTER_PID_DENY		// 丢弃__filter_pid_map中的pid
+};
+
+// 端口过滤的范围数量
+#define FILTER_PORT_RANGE_NUM 8
+
+// 过载整流采样的满刻度，内核按(hash(socket_id) >> 16) < rate判定保留
+#define SAMPLE_SCALE_FULL 65536
+
+struct trace_filter_t {
+	__u8 pid_filter_mode;	// FILTER_PID_OFF/ALLOW/DENY
+	__u8 proto_drop[PROTO_NUM];	// 非0表示丢弃该协议的数据
+	// 丢弃本地端口或对端端口落在[min, max]内的数据，min == max == 0表示未使用
+	__u16 port_drop_min[FILTER_PORT_RANGE_NUM];
+	__u16 port_drop_max[FILTER_PORT_RANGE_NUM];
+	// 按协议的捕获截断长度（字节），0表示不截断
+	__u16 proto_snaplen[PROTO_NUM];
+};
+
+// SOCKOPT_SET_SOCKTRACE_SNAPLEN下发的数组元素
+struct proto_snaplen_t {
+	__u16 proto;	// enum traffic_protocol
+	__u16 snap_len;	// 截断长度，0表示恢复为不截断
+};
+
 // struct member_offsets -> data[]  arrays index.
 enum offsets_index {
 	runtime_g_goid_offset = 0,
@@ -29,16 +29,38 @@
 /***********************************************************
  * map definitions
  ***********************************************************/
+#ifdef USE_RINGBUF
+/*
+ * 向用户态传递数据的专用map。
+ * ringbuf模式（Linux 5.8+）：各CPU共享同一块buffer，由用户态单个
+ * 线程消费，避免per-CPU buffer的内存开销。大小必须是2的次幂。
+ */
+MAP_RINGBUF(socket_data, 8 * 1024 * 1024)
+
+#define socket_data_output(ctx, data, size) \
+	bpf_ringbuf_output(&NAME(socket_data), (data), (size), 0)
+#else
 /*
  * 向用户态传递数据的专用map
  */
 MAP_PERF_EVENT(socket_data, int, __u32, MAX_CPU)
 
+#define socket_data_output(ctx, data, size) \
+	bpf_perf_event_output(ctx, &NAME(socket_data), \
+			      BPF_F_CURRENT_CPU, (data), (size))
+#endif
+
 /*
  * 因为ebpf栈只有512字节无法存放http数据，这里使用map做为buffer。
  */
 MAP_PERARRAY(data_buf, __u32, struct __socket_data_buffer, 1)
 
+/*
+ * 小读写合并状态：data_buf内最后一个事件头的偏移。
+ * COALESCE_INVALID_OFF表示buffer为空或刚flush，不可合并。
+ */
+MAP_PERARRAY(data_tail_offset, __u32, __u32, 1)
+
 /*
  * 结构体成员偏移
  */
@@ -63,6 +85,24 @@ MAP_PERARRAY(trace_uid_map, __u32, struct trace_uid_t, 1)
  */
 MAP_PERARRAY(trace_stats_map, __u32, struct trace_stats, 1)
 
+/*
+ * 数据过滤配置（pid允许/拒绝、端口范围、协议），用户态在运行时
+ * 通过SOCKOPT_SET_SOCKTRACE_*配置。被过滤的数据在提交给perf
+ * buffer之前丢弃。
+ */
+MAP_ARRAY(trace_filter_map, __u32, struct trace_filter_t, 1)
+
+// pid过滤表，配合trace_filter_t->pid_filter_mode使用
+MAP_HASH(filter_pid_map, __u32, __u32, 65536)
+
+/*
+ * 过载整流采样率，用户态周期线程根据丢失计数反馈调整。按
+ * socket_id整流：同一socket的事件要么全部保留要么全部丢弃，
+ * 保证存活流的请求/响应配对完整。取值[0, SAMPLE_SCALE_FULL]，
+ * 0（map默认值）或满刻度表示全量采集。
+ */
+MAP_ARRAY(sample_rate_map, __u32, __u32, 1)
+
 // write() syscall's input argument.
 // Key is {tgid, pid}.
 BPF_HASH(active_write_args_map, __u64, struct data_args_t)
@@ -73,10 +113,20 @@ BPF_HASH(active_read_args_map, __u64, struct data_args_t)
 
 // socket_info_map, 这是个hash表，用于记录socket信息，
 // Key is {pid + fd}. value is struct socket_info_t
-BPF_HASH(socket_info_map, __u64, struct socket_info_t)
+// LRU类型：map满时内核淘汰最久未访问的socket，代替用户态扫描回收
+BPF_LRU_HASH(socket_info_map, __u64, struct socket_info_t)
 
 // Key is {tgid, pid}. value is trace_info_t
-BPF_HASH(trace_map, __u64, struct trace_info_t)
+// LRU类型，同socket_info_map
+BPF_LRU_HASH(trace_map, __u64, struct trace_info_t)
+
+/*
+ * 协议推断的端口命中启发表。Key是推断成功时记录的服务端端口，
+ * value是L7协议类型。同一服务端口上的协议高度稳定，新连接首包
+ * 优先只执行该端口上次命中的matcher，命中则跳过整个推断级联
+ * （见infer_protocol()）。LRU类型，偶发的临时端口项会被自然淘汰。
+ */
+BPF_LRU_HASH(proto_infer_hint_map, __u16, __u8, 4096)
 
 static __inline void delete_socket_info(__u64 conn_key,
 					struct socket_info_t *socket_info_ptr)
@@ -97,6 +147,16 @@ static __inline void delete_socket_info(__u64 conn_key,
 #define EVENT_BURST_NUM            16
 #define CONN_PERSIST_TIME_MAX_NS   100000000000ULL
 
+/*
+ * 同socket相邻小读写的合并参数。紧密循环里的4~16字节读写（Go TLS
+ * 记录头、Redis pipelining）每个syscall产生一个事件，事件头远大于
+ * 负载。提交前若与buffer内上一事件同socket同方向且字节流连续，负
+ * 载直接追加到上一事件尾部，省掉一个事件头和一份perf带宽。
+ */
+#define COALESCE_MAX_SIZE          256	// 仅此大小以下的读写参与合并
+#define COALESCE_MAX_DELAY_NS      1000000ULL	// 合并引入的时延上界：1ms
+#define COALESCE_INVALID_OFF       0xffffffffU
+
 #ifndef BPF_USE_CORE
 static __inline unsigned int __retry_get_sock_flags(void *sk,
 						    int offset)
@@ -341,9 +401,7 @@ static __inline void connect_submit(struct pt_regs *ctx, struct conn_info_t *v,
 		return;
 	}
 
-	int ret = bpf_perf_event_output(ctx, &NAME(socket_data),
-					BPF_F_CURRENT_CPU, v,
-					128);
+	int ret = socket_data_output(ctx, v, 128);
 
 	if (ret) bpf_debug("connect_submit: %d\n", ret);
 }
@@ -723,6 +781,42 @@ static __u32 __inline get_tcp_read_seq_from_fd(int fd)
 
 #include "uprobe_base_bpf.c" // get_go_version
 
+// 返回true表示该数据被过滤掉，不提交给用户态
+static __inline bool trace_filtered(__u32 tgid, struct conn_info_t *conn_info)
+{
+	__u32 k0 = 0;
+	struct trace_filter_t *f = trace_filter_map__lookup(&k0);
+	if (f == NULL)
+		return false;
+
+	if (f->pid_filter_mode != FILTER_PID_OFF) {
+		__u32 *v = filter_pid_map__lookup(&tgid);
+		if (f->pid_filter_mode == FILTER_PID_ALLOW && v == NULL)
+			return true;
+		if (f->pid_filter_mode == FILTER_PID_DENY && v != NULL)
+			return true;
+	}
+
+	__u32 proto = conn_info->protocol;
+	if (proto < PROTO_NUM && f->proto_drop[proto])
+		return true;
+
+	__u16 sport = conn_info->tuple.num;
+	__u16 dport = conn_info->tuple.dport;
+#pragma unroll
+	for (int i = 0; i < FILTER_PORT_RANGE_NUM; i++) {
+		if (f->port_drop_min[i] == 0 && f->port_drop_max[i] == 0)
+			continue;
+		if ((sport >= f->port_drop_min[i] &&
+		     sport <= f->port_drop_max[i]) ||
+		    (dport >= f->port_drop_min[i] &&
+		     dport <= f->port_drop_max[i]))
+			return true;
+	}
+
+	return false;
+}
+
 static __inline void
 data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 	    const struct data_args_t *args, const bool vecs, __u32 syscall_len,
@@ -755,6 +849,10 @@ data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 		return;
 	}
 
+	// 被过滤的流量在这里丢弃，不再产生任何下游开销
+	if (trace_filtered(tgid, conn_info))
+		return;
+
 	__u32 tcp_seq = 0;
 	__u64 thread_trace_id = 0;
 
@@ -862,6 +960,17 @@ data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 		}
 	}
 
+	/*
+	 * 过载整流采样：按socket_id哈希决定整条流保留或丢弃，
+	 * 避免随机尾部丢弃破坏存活流的请求/响应配对。
+	 */
+	__u32 *s_rate = sample_rate_map__lookup(&k0);
+	if (s_rate && *s_rate > 0 && *s_rate < SAMPLE_SCALE_FULL) {
+		__u32 h = (__u32) sk_info.uid * 2654435761U;
+		if ((h >> 16) >= *s_rate)
+			return;
+	}
+
 	struct __socket_data_buffer *v_buff = bpf_map_lookup_elem(&NAME(data_buf), &k0);
 	if (!v_buff)
 		return;
@@ -871,6 +980,68 @@ data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 	if (v_buff->len > (sizeof(v_buff->data) - sizeof(*v)))
 		return;
 
+	__u32 *tail_off = bpf_map_lookup_elem(&NAME(data_tail_offset), &k0);
+	if (!tail_off)
+		return;
+
+	__u16 submit_data_type = conn_info->protocol;
+	if (conn_info->protocol == PROTO_HTTP1 && extra->go && extra->tls)
+		submit_data_type = PROTO_GO_TLS_HTTP1;
+
+	/*
+	 * 按协议的捕获截断长度（用户态经SOCKOPT_SET_SOCKTRACE_SNAPLEN
+	 * 下发），0表示不截断。在协议推断确定类型之后、拷贝负载之前截
+	 * 断，节省perf buffer带宽和拷贝开销。
+	 */
+	__u32 copy_len = syscall_len;
+	struct trace_filter_t *tf = trace_filter_map__lookup(&k0);
+	if (tf && submit_data_type < PROTO_NUM) {
+		__u16 snap = tf->proto_snaplen[submit_data_type];
+		if (snap > 0 && snap < copy_len)
+			copy_len = snap;
+	}
+
+	/*
+	 * 同socket相邻小读写的合并：与buffer内上一事件同socket、同方
+	 * 向、同类型，TCP字节流连续（无采集间隙）且在时延上界内时，本
+	 * 次负载直接追加到上一事件尾部（上一事件的负载正好结束在
+	 * v_buff->len处），不再产生新的事件头。iovec读写、携带
+	 * prev_buf数据或上一事件负载被截断的场景不参与合并。
+	 */
+	if (v_buff->events_num > 0 && !vecs &&
+	    *tail_off != COALESCE_INVALID_OFF &&
+	    conn_info->prev_count == 0 && copy_len == syscall_len &&
+	    syscall_len > 0 && syscall_len <= COALESCE_MAX_SIZE) {
+		__u32 poff = *tail_off;
+		__u32 eff_seq = extra->use_tcp_seq ? extra->tcp_seq :
+		    tcp_seq - syscall_len;
+		if (poff <= sizeof(v_buff->data) - sizeof(*v)) {
+			struct __socket_data *pv =
+			    (struct __socket_data *)(v_buff->data + poff);
+			__u32 add = syscall_len & (sizeof(v->data) - 1);
+			if (pv->socket_id == sk_info.uid &&
+			    pv->direction == conn_info->direction &&
+			    pv->msg_type == conn_info->message_type &&
+			    pv->data_type == submit_data_type &&
+			    pv->data_len == pv->syscall_len &&
+			    pv->data_len + add <= sizeof(pv->data) &&
+			    time_stamp - pv->timestamp <=
+			    COALESCE_MAX_DELAY_NS &&
+			    (conn_info->tuple.l4_protocol != IPPROTO_TCP ||
+			     pv->tcp_seq + pv->syscall_len == eff_seq)) {
+				char *dst = v_buff->data + v_buff->len;
+				/* 使用'add + 1'代替'add'，来规避（Linux 4.14.x）长度检查 */
+				if (bpf_probe_read(dst, add + 1,
+						   args->buf) == 0) {
+					pv->data_len += add;
+					pv->syscall_len += syscall_len;
+					v_buff->len += add;
+					return;
+				}
+			}
+		}
+	}
+
 	v = (struct __socket_data *)(v_buff->data + v_buff->len);
 	if (get_socket_info(v, conn_info->sk, conn_info) == false)
 		return;
@@ -878,10 +1049,7 @@ data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 	v->tuple.l4_protocol = conn_info->tuple.l4_protocol;
 	v->tuple.dport = conn_info->tuple.dport;
 	v->tuple.num = conn_info->tuple.num;
-	v->data_type = conn_info->protocol;
-
-	if (conn_info->protocol == PROTO_HTTP1 && extra->go && extra->tls)
-		v->data_type = PROTO_GO_TLS_HTTP1;
+	v->data_type = submit_data_type;
 
 	v->socket_id = sk_info.uid;
 	v->data_seq = sk_info.seq;
@@ -914,12 +1082,12 @@ data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 	 * the bitwise AND operation will set the range of possible values for
 	 * the UNKNOWN_VALUE register to [0, BUFSIZE)
 	 */
-	__u32 len = syscall_len & (sizeof(v->data) - 1);
+	__u32 len = copy_len & (sizeof(v->data) - 1);
 
 	if (vecs) {
-		len = iovecs_copy(v, v_buff, args, syscall_len, len);
+		len = iovecs_copy(v, v_buff, args, copy_len, len);
 	} else {
-		if (syscall_len >= sizeof(v->data)) {
+		if (copy_len >= sizeof(v->data)) {
 			if (unlikely(bpf_probe_read(v->data, sizeof(v->data), args->buf) != 0))
 				return;
 			len = sizeof(v->data);
@@ -941,6 +1109,7 @@ data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 	}
 
 	v->data_len = len;
+	*tail_off = v_buff->len;	// 记录本事件头偏移，供小读写合并使用
 	v_buff->len += offsetof(typeof(struct __socket_data), data) + v->data_len;
 	v_buff->events_num++;
 
@@ -948,17 +1117,14 @@ data_submit(struct pt_regs *ctx, struct conn_info_t *conn_info,
 		__u32 buf_size = (v_buff->len + offsetof(typeof(struct __socket_data_buffer), data))
 				 & (sizeof(*v_buff) - 1);
 		if (buf_size >= sizeof(*v_buff))
-			bpf_perf_event_output(ctx, &NAME(socket_data),
-					      BPF_F_CURRENT_CPU, v_buff,
-					      sizeof(*v_buff));
+			socket_data_output(ctx, v_buff, sizeof(*v_buff));
 		else
 			/* 使用'buf_size + 1'代替'buf_size'，来规避（Linux 4.14.x）长度检查 */
-			bpf_perf_event_output(ctx, &NAME(socket_data),
-					      BPF_F_CURRENT_CPU, v_buff,
-					      buf_size + 1);
+			socket_data_output(ctx, v_buff, buf_size + 1);
 
 		v_buff->events_num = 0;
 		v_buff->len = 0;
+		*tail_off = COALESCE_INVALID_OFF;
 	}
 }
 
@@ -1464,17 +1630,23 @@ TPPROG(sys_enter_getppid) (struct syscall_comm_enter_ctx *ctx) {
 						  offsetof(typeof(struct __socket_data_buffer), data))
 						 & (sizeof(*v_buff) - 1);
 				if (buf_size >= sizeof(*v_buff))
-					bpf_perf_event_output(ctx, &NAME(socket_data),
-							      BPF_F_CURRENT_CPU, v_buff,
-							      sizeof(*v_buff));
+					socket_data_output(ctx, v_buff,
+							   sizeof(*v_buff));
 				else
 					/* 使用'buf_size + 1'代替'buf_size'，来规避（Linux 4.14.x）长度检查 */
-					bpf_perf_event_output(ctx, &NAME(socket_data),
-							      BPF_F_CURRENT_CPU, v_buff,
-							      buf_size + 1);
+					socket_data_output(ctx, v_buff,
+							   buf_size + 1);
 
 				v_buff->events_num = 0;
-				v_buff->len = 0;				
+				v_buff->len = 0;
+
+				// buffer已清空，小读写合并状态同步失效
+				__u32 *tail_off =
+				    bpf_map_lookup_elem(&NAME
+							(data_tail_offset),
+							&k0);
+				if (tail_off)
+					*tail_off = COALESCE_INVALID_OFF;
 			}
 		}
 	}
@@ -68,6 +68,19 @@ pub const TRACER_RUNNING: u8 = 1;
 #[allow(dead_code)]
 pub const TRACER_STOP: u8 = 2;
 
+//探针能力组（C侧enum socket_trace_caps），running_socket_tracer()的
+//caps参数按位选择，BASE_IO组启动时强制开启
+#[allow(dead_code)]
+pub const TRACE_CAP_BASE_IO: c_uint = 1 << 0;
+#[allow(dead_code)]
+pub const TRACE_CAP_MSG_IO: c_uint = 1 << 1;
+#[allow(dead_code)]
+pub const TRACE_CAP_PROC_EVENTS: c_uint = 1 << 2;
+#[allow(dead_code)]
+pub const TRACE_CAP_GO_UPROBE: c_uint = 1 << 3;
+#[allow(dead_code)]
+pub const TRACE_CAP_ALL: c_uint = 0xf;
+
 //消息类型
 #[allow(dead_code)]
 pub const MSG_REQUEST: u8 = 1;
@@ -303,6 +316,15 @@ extern "C" {
         callback: extern "C" fn(data: *mut PROCESS_EVENT),
     ) -> c_int;
 
+    // 注册burst级socket数据回调：worker把一次出队的整个burst
+    // （最多MAX_PKT_BURST个SK_BPF_DATA指针）一次性交给回调，
+    // FFI开销从每事件一次降到每burst一次。指针仅在回调执行期间有效。
+    // 建议在running_socket_tracer()之前调用。
+    // 返回值：成功返回0，否则返回非0
+    pub fn register_socket_data_burst_handle(
+        callback: extern "C" fn(sds: *mut *mut SK_BPF_DATA, nr: c_int),
+    ) -> c_int;
+
     // 参数说明：
     // callback: 回调接口 rust -> C
     // thread_nr: 工作线程数，是指用户态有多少线程参与数据处理。
@@ -311,6 +333,7 @@ extern "C" {
     // max_socket_entries: 设置用于socket追踪的hash表项最大值，取决于实际场景中并发请求数量。
     // max_trace_entries: 设置用于线程/协程追踪会话的hash表项最大值。
     // socket_map_max_reclaim: socket map表项进行清理的最大阈值，当前map的表项数量超过这个值进行map清理操作。
+    // caps: 探针能力组掩码（TRACE_CAP_*按位或），未选中的组不注册不附着。
     // 返回值：成功返回0，否则返回非0
     pub fn running_socket_tracer(
         callback: extern "C" fn(sd: *mut SK_BPF_DATA),
@@ -320,6 +343,7 @@ extern "C" {
         max_socket_entries: c_uint,
         max_trace_entries: c_uint,
         socket_map_max_reclaim: c_uint,
+        caps: c_uint,
     ) -> c_int;
 
     // 停止tracer运行
@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * 协议推断corpus benchmark（make bench）：
+ *
+ * 把kernel/include/protocol_inference.h按用户态编译（shim见下），
+ * 用一组版本化的真实协议payload前缀驱动推断代码：
+ *
+ *   1. 正确性：每条样本经infer_protocol()必须推断出预期的协议与
+ *      消息类型，噪声样本（TLS握手、SSH banner、随机数据）必须
+ *      保持PROTO_UNKNOWN，失败则退出码非0。
+ *   2. 单matcher开销：各infer_xxx_message()在命中/未命中样本上的
+ *      ns/call。
+ *   3. 跨协议误判矩阵：每个matcher对每条样本的判定结果，对角线
+ *      以外的命中即为误判风险。
+ *   4. 级联开销：infer_protocol()全量级联在混合corpus与纯噪声上
+ *      的ns/call（冷路径与端口命中启发生效后的热路径分别计量）。
+ *   5. BPF指令预算：若../kernel/socket_trace.elf已编译，统计各
+ *      可执行section的指令数（每条BPF指令8字节），推断代码的
+ *      膨胀直接反映在这里。
+ *
+ * 改动推断逻辑时跑一遍，回归用数字说话。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/types.h>
+
+/*
+ * 用户态编译shim：bpf_base.h依赖libbpf的BPF helper声明（固定地址
+ * 的函数指针，用户态调用会崩溃），这里直接关掉它的include guard，
+ * 只提供推断代码实际用到的部分——bpf_probe_read退化成memcpy，
+ * bpf_get_current_comm返回固定进程名，LRU map用平坦数组模拟
+ * （仅支持16bit key，对proto_infer_hint_map够用）。
+ */
+#define __BPF_BASE_H__
+#define SEC(x)
+
+static inline int bpf_probe_read(void *dst, size_t sz, const void *src)
+{
+	memcpy(dst, src, sz);
+	return 0;
+}
+
+static char bench_comm[16] = "bench_infer";
+
+static inline int bpf_get_current_comm(void *buf, int size)
+{
+	memcpy(buf, bench_comm, size < 16 ? size : 16);
+	return 0;
+}
+
+#define BPF_LRU_HASH(name, key_type, leaf_type, size)			\
+static leaf_type __##name[65536];					\
+static bool __##name##_valid[65536];					\
+static inline leaf_type *name##__lookup(key_type *key)			\
+{									\
+	return __##name##_valid[(__u16)*key] ?				\
+		&__##name[(__u16)*key] : NULL;				\
+}									\
+static inline int name##__update(key_type *key, leaf_type *value)	\
+{									\
+	__##name[(__u16)*key] = *value;					\
+	__##name##_valid[(__u16)*key] = true;				\
+	return 0;							\
+}									\
+static inline int name##__delete(key_type *key)				\
+{									\
+	__##name##_valid[(__u16)*key] = false;				\
+	return 0;							\
+}
+
+#include "../kernel/include/utils.h"
+#include "../kernel/include/socket_trace.h"
+
+// 与kernel/socket_trace.c中的定义保持一致
+BPF_LRU_HASH(proto_infer_hint_map, __u16, __u8, 4096)
+
+#include "../kernel/include/protocol_inference.h"
+
+#define BENCH_MATCHER_ITERS	(1024 * 1024ULL)
+#define BENCH_CASCADE_ITERS	(1024 * 1024ULL)
+#define BENCH_SAMPLE_BUF_SZ	64
+#define KERN_ELF_PATH		"../kernel/socket_trace.elf"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * corpus：真实协议payload前缀（抓包截取，buf固定64字节零填充，
+ * count是线上实际的读写长度）。proto == PROTO_UNKNOWN的是噪声
+ * 样本，谁命中谁误判。
+ */
+struct corpus_sample {
+	const char *name;
+	enum traffic_protocol proto;	// 预期推断结果
+	enum message_type type;		// 预期消息类型
+	enum traffic_direction dir;
+	__u16 dport;
+	__u16 sk_type;			// SOCK_STREAM / SOCK_DGRAM
+	bool prev4;			// 模拟4字节预读（MySQL/Kafka读包头再读body）
+	unsigned char prev_buf[4];
+	size_t count;
+	unsigned char buf[BENCH_SAMPLE_BUF_SZ];
+};
+
+static struct corpus_sample corpus[] = {
+	{
+	 .name = "http1-request", .proto = PROTO_HTTP1, .type = MSG_REQUEST,
+	 .dir = T_EGRESS, .dport = 80, .sk_type = SOCK_STREAM, .count = 56,
+	 .buf = "GET /index.html HTTP/1.1\r\nHost: deepflow.yunshan.net\r\n\r\n",
+	 },
+	{
+	 .name = "http1-response", .proto = PROTO_HTTP1, .type = MSG_RESPONSE,
+	 .dir = T_INGRESS, .dport = 80, .sk_type = SOCK_STREAM, .count = 41,
+	 .buf = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok",
+	 },
+	{
+	 // HEADERS帧，flags END_HEADERS，fragment首字节0x82（:method GET）
+	 .name = "http2-headers", .proto = PROTO_HTTP2, .type = MSG_REQUEST,
+	 .dir = T_EGRESS, .dport = 8080, .sk_type = SOCK_STREAM, .count = 15,
+	 .buf = {0x00, 0x00, 0x06, 0x01, 0x04, 0x00, 0x00, 0x00, 0x01,
+		 0x82, 0x86, 0x84, 0x41, 0x8a, 0xa0},
+	 },
+	{
+	 // COM_QUERY "select 1"，整包读取（len=9, seq=0, com=0x03）
+	 .name = "mysql-query", .proto = PROTO_MYSQL, .type = MSG_REQUEST,
+	 .dir = T_EGRESS, .dport = 3306, .sk_type = SOCK_STREAM, .count = 13,
+	 .buf = {0x09, 0x00, 0x00, 0x00, 0x03,
+		 's', 'e', 'l', 'e', 'c', 't', ' ', '1'},
+	 },
+	{
+	 .name = "redis-request", .proto = PROTO_REDIS, .type = MSG_REQUEST,
+	 .dir = T_EGRESS, .dport = 6379, .sk_type = SOCK_STREAM, .count = 31,
+	 .buf = "*3\r\n$3\r\nSET\r\n$3\r\nfoo\r\n$3\r\nbar\r\n",
+	 },
+	{
+	 .name = "redis-response", .proto = PROTO_REDIS, .type = MSG_RESPONSE,
+	 .dir = T_INGRESS, .dport = 6379, .sk_type = SOCK_STREAM, .count = 5,
+	 .buf = "+OK\r\n",
+	 },
+	{
+	 // 标准查询 deepflow.com A IN
+	 .name = "dns-query", .proto = PROTO_DNS, .type = MSG_REQUEST,
+	 .dir = T_EGRESS, .dport = 53, .sk_type = SOCK_DGRAM, .count = 30,
+	 .buf = {0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+		 0x00, 0x00, 0x00, 0x00,
+		 0x08, 'd', 'e', 'e', 'p', 'f', 'l', 'o', 'w',
+		 0x03, 'c', 'o', 'm', 0x00, 0x00, 0x01, 0x00, 0x01},
+	 },
+	{
+	 .name = "dns-response", .proto = PROTO_DNS, .type = MSG_RESPONSE,
+	 .dir = T_INGRESS, .dport = 53, .sk_type = SOCK_DGRAM, .count = 46,
+	 .buf = {0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01,
+		 0x00, 0x00, 0x00, 0x00,
+		 0x08, 'd', 'e', 'e', 'p', 'f', 'l', 'o', 'w',
+		 0x03, 'c', 'o', 'm', 0x00, 0x00, 0x01, 0x00, 0x01,
+		 0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3c,
+		 0x00, 0x04, 0x0a, 0x00, 0x00, 0x01},
+	 },
+	{
+	 // CONNECT，remaining length 16
+	 .name = "mqtt-connect", .proto = PROTO_MQTT, .type = MSG_REQUEST,
+	 .dir = T_EGRESS, .dport = 1883, .sk_type = SOCK_STREAM, .count = 18,
+	 .buf = {0x10, 0x10, 0x00, 0x04, 'M', 'Q', 'T', 'T',
+		 0x04, 0x02, 0x00, 0x3c, 0x00, 0x04, 'b', 'n', 'c', 'h'},
+	 },
+	{
+	 // magic 0xdabb，is_req=1 to_way=1 serial_id=6(fastjson)
+	 .name = "dubbo-request", .proto = PROTO_DUBBO, .type = MSG_REQUEST,
+	 .dir = T_EGRESS, .dport = 20880, .sk_type = SOCK_STREAM, .count = 48,
+	 .buf = {0xda, 0xbb, 0xc6, 0x00,
+		 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+		 0x00, 0x00, 0x00, 0x20,
+		 '"', '2', '.', '0', '.', '2', '"'},
+	 },
+	{
+	 /*
+	  * MetadataRequest v5的body读（kafka客户端先读4字节长度再读
+	  * body，长度经prestore进入prev_buf），首个请求返回MSG_RECONFIRM。
+	  * 注意不能用整包样本：整包的长度前缀恰好能满足DNS的头部启发，
+	  * 会被级联里排在前面的DNS误判——这正是prestore路径存在的原因。
+	  */
+	 .name = "kafka-metadata", .proto = PROTO_KAFKA, .type = MSG_RECONFIRM,
+	 .dir = T_EGRESS, .dport = 9092, .sk_type = SOCK_STREAM,
+	 .prev4 = true, .prev_buf = {0x00, 0x00, 0x00, 0x13}, .count = 19,
+	 .buf = {0x00, 0x03, 0x00, 0x05,
+		 0x00, 0x00, 0x00, 0x07, 0x00, 0x05, 'b', 'e', 'n', 'c', 'h',
+		 0x00, 0x00, 0x00, 0x00},
+	 },
+	{
+	 .name = "noise-tls-hello", .proto = PROTO_UNKNOWN, .type = MSG_UNKNOWN,
+	 .dir = T_EGRESS, .dport = 8443, .sk_type = SOCK_STREAM, .count = 32,
+	 .buf = {0x16, 0x03, 0x01, 0x02, 0x00, 0x01, 0x00, 0x01,
+		 0xfc, 0x03, 0x03, 0x9f, 0x41, 0xd2, 0x7a, 0x33,
+		 0x88, 0x5a, 0x1c, 0xee, 0x07, 0x62, 0xb0, 0x54,
+		 0x1e, 0x29, 0x8c, 0xd1, 0xa4, 0x46, 0xb5, 0x90},
+	 },
+	{
+	 .name = "noise-ssh-banner", .proto = PROTO_UNKNOWN, .type = MSG_UNKNOWN,
+	 .dir = T_INGRESS, .dport = 22, .sk_type = SOCK_STREAM, .count = 23,
+	 .buf = "SSH-2.0-OpenSSH_8.4p1\r\n",
+	 },
+	{
+	 .name = "noise-random", .proto = PROTO_UNKNOWN, .type = MSG_UNKNOWN,
+	 .dir = T_INGRESS, .dport = 33000, .sk_type = SOCK_STREAM, .count = 32,
+	 .buf = {0xb7, 0x5d, 0x92, 0x6e, 0x17, 0xe3, 0x48, 0xa1,
+		 0x0b, 0xce, 0x71, 0x24, 0x9d, 0x58, 0xf2, 0x86,
+		 0x3b, 0x60, 0xc9, 0x15, 0xae, 0x72, 0xd8, 0x4f,
+		 0x91, 0x3c, 0xe7, 0x0a, 0x55, 0xba, 0x28, 0x63},
+	 },
+};
+
+#define CORPUS_NUM ((int)(sizeof(corpus) / sizeof(corpus[0])))
+
+// 只清corpus涉及的端口，避免整个map的memset干扰ns/call的测量
+static void hint_map_clear(void)
+{
+	int i;
+	__u16 num = 54321;
+
+	for (i = 0; i < (int)(sizeof(corpus) / sizeof(corpus[0])); i++)
+		proto_infer_hint_map__delete(&corpus[i].dport);
+	proto_infer_hint_map__delete(&num);
+}
+
+// 每次调用前重建conn_info，推断代码会就地改写它（prev_buf等）
+static void conn_info_fill(struct conn_info_t *ci,
+			   const struct corpus_sample *s)
+{
+	memset(ci, 0, sizeof(*ci));
+	ci->tuple.dport = s->dport;
+	ci->tuple.num = 54321;
+	ci->sk_type = s->sk_type;
+	ci->direction = s->dir;
+	ci->fd = 3;
+	ci->sk = (void *)0x1;
+	if (s->prev4) {
+		memcpy(ci->prev_buf, s->prev_buf, 4);
+		ci->prev_count = 4;
+	}
+}
+
+static const char *proto_name(enum traffic_protocol p)
+{
+	switch (p) {
+	case PROTO_HTTP1:
+		return "HTTP1";
+	case PROTO_HTTP2:
+		return "HTTP2";
+	case PROTO_MYSQL:
+		return "MySQL";
+	case PROTO_REDIS:
+		return "Redis";
+	case PROTO_KAFKA:
+		return "Kafka";
+	case PROTO_MQTT:
+		return "MQTT";
+	case PROTO_DUBBO:
+		return "Dubbo";
+	case PROTO_DNS:
+		return "DNS";
+	case PROTO_UNKNOWN:
+		return "-";
+	default:
+		return "?";
+	}
+}
+
+static const char *type_name(enum message_type t)
+{
+	switch (t) {
+	case MSG_REQUEST:
+		return "request";
+	case MSG_RESPONSE:
+		return "response";
+	case MSG_PRESTORE:
+		return "prestore";
+	case MSG_RECONFIRM:
+		return "reconfirm";
+	case MSG_CLEAR:
+		return "clear";
+	default:
+		return "unknown";
+	}
+}
+
+static int bench_correctness(void)
+{
+	int fails = 0, i;
+	struct conn_info_t ci;
+	struct process_data_extra extra = { 0 };
+
+	printf("=== correctness (full cascade, cold hint map) ===\n");
+	for (i = 0; i < CORPUS_NUM; i++) {
+		struct corpus_sample *s = &corpus[i];
+		hint_map_clear();
+		conn_info_fill(&ci, s);
+		struct protocol_message_t r =
+		    infer_protocol((char *)s->buf, s->count, &ci,
+				   s->sk_type == SOCK_STREAM ?
+				   SOCK_CHECK_TYPE_TCP_ES :
+				   SOCK_CHECK_TYPE_UDP, &extra);
+		bool ok = (r.protocol == s->proto && r.type == s->type);
+		printf("  %-18s -> %-6s %-9s %s\n", s->name,
+		       proto_name(r.protocol), type_name(r.type),
+		       ok ? "" : "FAIL");
+		if (!ok)
+			fails++;
+	}
+
+	return fails;
+}
+
+typedef enum message_type (*matcher_fn_t)(const char *, size_t,
+					  struct conn_info_t *);
+
+struct matcher {
+	const char *name;
+	enum traffic_protocol proto;
+	matcher_fn_t fn;
+};
+
+static enum message_type infer_http2_wrap(const char *buf, size_t count,
+					  struct conn_info_t *ci)
+{
+	return infer_http2_message(buf, count, ci);
+}
+
+static struct matcher matchers[] = {
+	{"infer_http_message", PROTO_HTTP1, infer_http_message},
+	{"infer_http2_message", PROTO_HTTP2, infer_http2_wrap},
+	{"infer_mysql_message", PROTO_MYSQL, infer_mysql_message},
+	{"infer_redis_message", PROTO_REDIS, infer_redis_message},
+	{"infer_dns_message", PROTO_DNS, infer_dns_message},
+	{"infer_mqtt_message", PROTO_MQTT, infer_mqtt_message},
+	{"infer_dubbo_message", PROTO_DUBBO, infer_dubbo_message},
+	{"infer_kafka_message", PROTO_KAFKA, infer_kafka_message},
+};
+
+#define MATCHER_NUM ((int)(sizeof(matchers) / sizeof(matchers[0])))
+
+static volatile int bench_sink;
+
+// conn_info重建本身的开销，从各matcher的测量值里扣除
+static struct conn_info_t bench_ci;
+
+static uint64_t fill_baseline_ns(const struct corpus_sample *s)
+{
+	int i;
+	uint64_t st = now_ns();
+
+	for (i = 0; i < (int)BENCH_MATCHER_ITERS; i++) {
+		conn_info_fill(&bench_ci, s);
+		bench_sink = bench_ci.fd;
+	}
+	return (now_ns() - st) / BENCH_MATCHER_ITERS;
+}
+
+static void bench_matcher_cost(void)
+{
+	int m, i;
+	struct conn_info_t ci;
+
+	printf("\n=== per-matcher cost, %llu iters, conn_info "
+	       "rebuild excluded (hit = own sample, miss = noise) ===\n",
+	       (unsigned long long)BENCH_MATCHER_ITERS);
+	printf("  %-22s %10s %10s\n", "matcher", "hit ns", "miss ns");
+
+	struct corpus_sample *noise = &corpus[CORPUS_NUM - 1];
+	uint64_t base_ns = fill_baseline_ns(noise);
+	for (m = 0; m < MATCHER_NUM; m++) {
+		struct corpus_sample *hit = NULL;
+		for (i = 0; i < CORPUS_NUM; i++) {
+			if (corpus[i].proto == matchers[m].proto) {
+				hit = &corpus[i];
+				break;
+			}
+		}
+
+		uint64_t st = now_ns();
+		for (i = 0; i < (int)BENCH_MATCHER_ITERS; i++) {
+			conn_info_fill(&ci, hit);
+			bench_sink = matchers[m].fn((char *)hit->buf,
+						    hit->count, &ci);
+		}
+		uint64_t hit_ns = (now_ns() - st) / BENCH_MATCHER_ITERS;
+
+		st = now_ns();
+		for (i = 0; i < (int)BENCH_MATCHER_ITERS; i++) {
+			conn_info_fill(&ci, noise);
+			bench_sink = matchers[m].fn((char *)noise->buf,
+						    noise->count, &ci);
+		}
+		uint64_t miss_ns = (now_ns() - st) / BENCH_MATCHER_ITERS;
+
+		hit_ns -= hit_ns > base_ns ? base_ns : hit_ns;
+		miss_ns -= miss_ns > base_ns ? base_ns : miss_ns;
+		printf("  %-22s %10llu %10llu\n", matchers[m].name,
+		       (unsigned long long)hit_ns,
+		       (unsigned long long)miss_ns);
+	}
+}
+
+static int bench_false_positive_matrix(void)
+{
+	int m, i, cross = 0;
+	struct conn_info_t ci;
+
+	printf("\n=== cross-protocol matrix "
+	       "(matcher verdict per sample, '.' = no match) ===\n");
+	printf("  %-18s", "sample");
+	for (m = 0; m < MATCHER_NUM; m++)
+		printf(" %6s", proto_name(matchers[m].proto));
+	printf("\n");
+
+	for (i = 0; i < CORPUS_NUM; i++) {
+		struct corpus_sample *s = &corpus[i];
+		printf("  %-18s", s->name);
+		for (m = 0; m < MATCHER_NUM; m++) {
+			conn_info_fill(&ci, s);
+			enum message_type t =
+			    matchers[m].fn((char *)s->buf, s->count, &ci);
+			if (t == MSG_UNKNOWN) {
+				printf(" %6s", ".");
+			} else {
+				printf(" %6s", type_name(t));
+				if (matchers[m].proto != s->proto)
+					cross++;
+			}
+		}
+		printf("\n");
+	}
+
+	printf("  cross-protocol hits: %d\n", cross);
+	return cross;
+}
+
+static void bench_cascade_cost(void)
+{
+	int i;
+	struct conn_info_t ci;
+	struct process_data_extra extra = { 0 };
+	uint64_t st;
+
+	printf("\n=== full cascade cost, %llu iters ===\n",
+	       (unsigned long long)BENCH_CASCADE_ITERS);
+
+	// 冷路径：无端口命中启发，混合corpus轮转
+	hint_map_clear();
+	st = now_ns();
+	for (i = 0; i < (int)BENCH_CASCADE_ITERS; i++) {
+		struct corpus_sample *s = &corpus[i % CORPUS_NUM];
+		hint_map_clear();
+		conn_info_fill(&ci, s);
+		infer_protocol((char *)s->buf, s->count, &ci,
+			       s->sk_type == SOCK_STREAM ?
+			       SOCK_CHECK_TYPE_TCP_ES :
+			       SOCK_CHECK_TYPE_UDP, &extra);
+	}
+	printf("  mixed corpus, cold hints: %llu ns/call\n",
+	       (unsigned long long)((now_ns() - st) / BENCH_CASCADE_ITERS));
+
+	// 热路径：端口命中启发已填充
+	hint_map_clear();
+	for (i = 0; i < CORPUS_NUM; i++) {
+		struct corpus_sample *s = &corpus[i];
+		conn_info_fill(&ci, s);
+		infer_protocol((char *)s->buf, s->count, &ci,
+			       s->sk_type == SOCK_STREAM ?
+			       SOCK_CHECK_TYPE_TCP_ES :
+			       SOCK_CHECK_TYPE_UDP, &extra);
+	}
+	st = now_ns();
+	for (i = 0; i < (int)BENCH_CASCADE_ITERS; i++) {
+		struct corpus_sample *s = &corpus[i % CORPUS_NUM];
+		conn_info_fill(&ci, s);
+		infer_protocol((char *)s->buf, s->count, &ci,
+			       s->sk_type == SOCK_STREAM ?
+			       SOCK_CHECK_TYPE_TCP_ES :
+			       SOCK_CHECK_TYPE_UDP, &extra);
+	}
+	printf("  mixed corpus, warm hints: %llu ns/call\n",
+	       (unsigned long long)((now_ns() - st) / BENCH_CASCADE_ITERS));
+
+	// 最坏情况：纯噪声走满整个级联
+	struct corpus_sample *noise = &corpus[CORPUS_NUM - 1];
+	hint_map_clear();
+	st = now_ns();
+	for (i = 0; i < (int)BENCH_CASCADE_ITERS; i++) {
+		conn_info_fill(&ci, noise);
+		infer_protocol((char *)noise->buf, noise->count, &ci,
+			       SOCK_CHECK_TYPE_TCP_ES, &extra);
+	}
+	printf("  pure noise (worst case): %llu ns/call\n",
+	       (unsigned long long)((now_ns() - st) / BENCH_CASCADE_ITERS));
+}
+
+/*
+ * 统计已编译BPF对象各可执行section的指令数（BPF指令定长8字节）。
+ * 对象由kernel/下的make产出，未编译时跳过并提示。
+ */
+static void report_insn_count(const char *path)
+{
+	printf("\n=== BPF instruction count (%s) ===\n", path);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("  object not built, run make in kernel/ first\n");
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(Elf64_Ehdr)) {
+		close(fd);
+		printf("  invalid object\n");
+		return;
+	}
+
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		printf("  mmap failed\n");
+		return;
+	}
+
+	Elf64_Ehdr *eh = (Elf64_Ehdr *) base;
+	if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS64) {
+		munmap(base, st.st_size);
+		printf("  not a 64bit ELF object\n");
+		return;
+	}
+
+	Elf64_Shdr *sh = (Elf64_Shdr *) ((char *)base + eh->e_shoff);
+	const char *shstr = (char *)base + sh[eh->e_shstrndx].sh_offset;
+	uint64_t total = 0;
+	int i;
+	for (i = 0; i < eh->e_shnum; i++) {
+		if (!(sh[i].sh_flags & SHF_EXECINSTR) || sh[i].sh_size == 0)
+			continue;
+		uint64_t insns = sh[i].sh_size / 8;
+		printf("  %-48s %8llu insns\n", shstr + sh[i].sh_name,
+		       (unsigned long long)insns);
+		total += insns;
+	}
+	printf("  %-48s %8llu insns\n", "total", (unsigned long long)total);
+
+	munmap(base, st.st_size);
+}
+
+int main(void)
+{
+	int fails = bench_correctness();
+
+	bench_matcher_cost();
+
+	int cross = bench_false_positive_matrix();
+
+	bench_cascade_cost();
+
+	report_insn_count(KERN_ELF_PATH);
+
+	if (fails) {
+		printf("\nbench_inference: %d correctness failure(s)\n", fails);
+		return 1;
+	}
+
+	printf("\nbench_inference: OK (%d samples, %d matchers, "
+	       "%d cross-protocol hits)\n", CORPUS_NUM, MATCHER_NUM, cross);
+	return 0;
+}
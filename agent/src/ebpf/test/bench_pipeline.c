@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * 用户态流水线microbenchmark（make bench）：
+ *
+ *   1. ring入队/出队吞吐（单线程与生产/消费双线程）。
+ *   2. 装配/分发路径：用合成的__socket_data_buffer直接驱动socket
+ *      tracer的raw回调，走block_heap分配、burst入队、worker消费的
+ *      完整路径。
+ *   3. flow分发哈希（tuple_hash）的分布均匀性。
+ *
+ * 带参数运行时为回放模式：把deepflow-ebpfctl socktrace record录制
+ * 的文件灌回同一条装配/分发路径，对着真实流量形态测量吞吐：
+ *
+ *   ./bench_pipeline RECORD_FILE [SPEED]   (SPEED缺省0，全速回放)
+ *
+ * 输出events/s、ns/event和分配回退计数，用数字而不是线上事故来
+ * 发现热路径的回归。
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../user/common.h"
+#include "../user/log.h"
+#include "../user/tracer.h"
+#include "../user/socket.h"
+#include "../user/record.h"
+
+#define BENCH_RING_SIZE		16384
+#define BENCH_RING_EVENTS	(16 * 1024 * 1024ULL)
+#define BENCH_ASSEMBLY_BLOBS	(128 * 1024ULL)
+#define BENCH_PAYLOAD_LEN	256
+#define BENCH_WORKERS		4
+#define BENCH_HASH_SAMPLES	(1024 * 1024ULL)
+#define BENCH_BLOB_VARIANTS	64
+#define BENCH_DRAIN_TIMEOUT_S	10
+
+static volatile uint64_t processed_events;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t rand_seed = 0x9e3779b9;
+static uint32_t rand_u32(void)
+{
+	rand_seed ^= rand_seed << 13;
+	rand_seed ^= rand_seed >> 17;
+	rand_seed ^= rand_seed << 5;
+	return rand_seed;
+}
+
+static void report(const char *name, uint64_t events, uint64_t ns)
+{
+	printf("  %-24s %12" PRIu64 " events %8.2f Mevents/s %8.2f ns/event\n",
+	       name, events, (double)events * 1000.0 / ns,
+	       (double)ns / events);
+}
+
+/* ==========================================================
+ * 1. ring入队/出队
+ * ==========================================================
+ */
+static void bench_ring_single(void)
+{
+	struct ring *r = ring_create("bench-ring-sp", BENCH_RING_SIZE,
+				     SOCKET_ID_ANY,
+				     RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (r == NULL) {
+		printf("  ring_create() failed.\n");
+		return;
+	}
+
+	void *burst[MAX_PKT_BURST];
+	int i;
+	for (i = 0; i < MAX_PKT_BURST; i++)
+		burst[i] = (void *)(uintptr_t) (i + 1);
+
+	uint64_t n, start = now_ns();
+	for (n = 0; n < BENCH_RING_EVENTS; n += MAX_PKT_BURST) {
+		ring_sp_enqueue_burst(r, burst, MAX_PKT_BURST, NULL);
+		ring_sc_dequeue_burst(r, burst, MAX_PKT_BURST, NULL);
+	}
+
+	report("ring sp/sc 1-thread", n, now_ns() - start);
+}
+
+struct ring_bench_ctx {
+	struct ring *r;
+	uint64_t events;
+};
+
+static void *ring_consumer(void *arg)
+{
+	struct ring_bench_ctx *ctx = (struct ring_bench_ctx *)arg;
+	void *burst[MAX_PKT_BURST];
+	uint64_t got = 0;
+
+	while (got < ctx->events)
+		got += ring_sc_dequeue_burst(ctx->r, burst, MAX_PKT_BURST,
+					     NULL);
+	return NULL;
+}
+
+static void *ring_mc_consumer(void *arg)
+{
+	struct ring_bench_ctx *ctx = (struct ring_bench_ctx *)arg;
+	void *burst[MAX_PKT_BURST];
+
+	while (__sync_fetch_and_add(&processed_events, 0) < ctx->events) {
+		unsigned n = ring_mc_dequeue_burst(ctx->r, burst,
+						   MAX_PKT_BURST, NULL);
+		if (n)
+			__sync_fetch_and_add(&processed_events, n);
+	}
+	return NULL;
+}
+
+static void *ring_mp_producer(void *arg)
+{
+	struct ring_bench_ctx *ctx = (struct ring_bench_ctx *)arg;
+	void *burst[MAX_PKT_BURST];
+	uint64_t sent = 0;
+	int i;
+
+	for (i = 0; i < MAX_PKT_BURST; i++)
+		burst[i] = (void *)(uintptr_t) (i + 1);
+
+	while (sent < ctx->events)
+		sent += ring_mp_enqueue_burst(ctx->r, burst, MAX_PKT_BURST,
+					      NULL);
+	return NULL;
+}
+
+static void bench_ring_threaded(void)
+{
+	struct ring *r = ring_create("bench-ring-mt", BENCH_RING_SIZE,
+				     SOCKET_ID_ANY,
+				     RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (r == NULL) {
+		printf("  ring_create() failed.\n");
+		return;
+	}
+
+	struct ring_bench_ctx ctx = {
+		.r = r,
+		.events = BENCH_RING_EVENTS,
+	};
+
+	void *burst[MAX_PKT_BURST];
+	int i;
+	for (i = 0; i < MAX_PKT_BURST; i++)
+		burst[i] = (void *)(uintptr_t) (i + 1);
+
+	pthread_t consumer;
+	pthread_create(&consumer, NULL, ring_consumer, &ctx);
+
+	uint64_t sent = 0, start = now_ns();
+	while (sent < BENCH_RING_EVENTS)
+		sent += ring_sp_enqueue_burst(r, burst, MAX_PKT_BURST, NULL);
+
+	pthread_join(consumer, NULL);
+	report("ring sp/sc 2-thread", sent, now_ns() - start);
+}
+
+/*
+ * MP/MC对照组：dispatch_worker()在每CPU读取或work stealing模式下
+ * 用的就是这条CAS路径，这里给出与sp/sc同负载下的吞吐，用于部署
+ * 时估算需要的队列数。
+ */
+static void bench_ring_mpmc(int producers, int consumers)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "bench-ring-%dp%dc", producers,
+		 consumers);
+	struct ring *r = ring_create(name, BENCH_RING_SIZE, SOCKET_ID_ANY, 0);
+	if (r == NULL) {
+		printf("  ring_create() failed.\n");
+		return;
+	}
+
+	struct ring_bench_ctx prod_ctx = {
+		.r = r,
+		.events = BENCH_RING_EVENTS / producers,
+	};
+	struct ring_bench_ctx cons_ctx = {
+		.r = r,
+		.events = (BENCH_RING_EVENTS / producers) * producers,
+	};
+
+	processed_events = 0;
+	pthread_t prods[BENCH_WORKERS], cons[BENCH_WORKERS];
+	int i;
+	uint64_t start = now_ns();
+	for (i = 0; i < consumers; i++)
+		pthread_create(&cons[i], NULL, ring_mc_consumer, &cons_ctx);
+	for (i = 0; i < producers; i++)
+		pthread_create(&prods[i], NULL, ring_mp_producer, &prod_ctx);
+
+	for (i = 0; i < producers; i++)
+		pthread_join(prods[i], NULL);
+	for (i = 0; i < consumers; i++)
+		pthread_join(cons[i], NULL);
+
+	snprintf(name, sizeof(name), "ring mp/mc %dP/%dC", producers,
+		 consumers);
+	report(name, cons_ctx.events, now_ns() - start);
+	processed_events = 0;
+}
+
+/* ==========================================================
+ * 2. 装配/分发路径
+ * ==========================================================
+ */
+static void bench_process_cb(void *sd)
+{
+	__sync_fetch_and_add(&processed_events, 1);
+}
+
+// 构造一条内核burst发送格式的记录，events_num个事件、每个payload定长
+static int build_blob(void *blob, int events_num, uint64_t socket_id_base)
+{
+	struct __socket_data_buffer *buf = blob;
+	struct __socket_data *sd;
+	int i, start = 0;
+	const int hdr_len = offsetof(typeof(struct __socket_data), data);
+
+	buf->events_num = events_num;
+	for (i = 0; i < events_num; i++) {
+		sd = (struct __socket_data *)&buf->data[start];
+		memset(sd, 0, hdr_len);
+		sd->socket_id = socket_id_base + i;
+		// 每个事件一条独立flow：粘性分发按五元组哈希选队列，
+		// 全零tuple会把所有事件钉在同一个队列上
+		uint64_t flow = socket_id_base + i;
+		memcpy(sd->tuple.daddr, &flow, sizeof(flow));
+		memcpy(sd->tuple.rcv_saddr, &flow, sizeof(flow));
+		sd->tuple.addr_len = 4;
+		sd->tuple.l4_protocol = 6;
+		sd->tuple.dport = 80;
+		sd->tuple.num = (uint16_t) (flow | 1024);
+		sd->data_type = PROTO_HTTP1;
+		sd->data_len = BENCH_PAYLOAD_LEN;
+		memset(sd->data, 'x', BENCH_PAYLOAD_LEN);
+		start += hdr_len + BENCH_PAYLOAD_LEN;
+	}
+
+	buf->len = start;
+	return offsetof(typeof(struct __socket_data_buffer), data) + start;
+}
+
+static void bench_assembly(void)
+{
+	struct bpf_tracer *tracer =
+	    create_bpf_tracer("bench-tracer", "bench-load", NULL, 0, NULL,
+			      BENCH_WORKERS, (void *)bench_process_cb, 0);
+	if (tracer == NULL) {
+		printf("  create_bpf_tracer() failed.\n");
+		return;
+	}
+
+	tracer->raw_cb = (perf_reader_raw_cb) socket_tracer_raw_cb();
+	if (dispatch_worker(tracer, BENCH_RING_SIZE) != ETR_OK) {
+		printf("  dispatch_worker() failed.\n");
+		return;
+	}
+
+	// 预构造一组blob，避免把构造开销算进流水线
+	static uint8_t blobs[BENCH_BLOB_VARIANTS][sizeof(struct __socket_data_buffer)];
+	int blob_size[BENCH_BLOB_VARIANTS];
+	int i;
+	for (i = 0; i < BENCH_BLOB_VARIANTS; i++)
+		blob_size[i] = build_blob(blobs[i], MAX_PKT_BURST,
+					  (uint64_t) rand_u32() << 16);
+
+	uint64_t n, start = now_ns();
+	for (n = 0; n < BENCH_ASSEMBLY_BLOBS; n++) {
+		i = n % BENCH_BLOB_VARIANTS;
+		tracer->raw_cb((void *)tracer, blobs[i], blob_size[i]);
+	}
+
+	// 等worker把队列消费完
+	uint64_t enqueued = 0, lost = 0, heap_fallback = 0;
+	for (i = 0; i < BENCH_WORKERS; i++)
+		enqueued += atomic64_read(&tracer->queues[i].enqueue_nr);
+
+	uint64_t drain_deadline = now_ns() +
+	    (uint64_t) BENCH_DRAIN_TIMEOUT_S * 1000000000ULL;
+	while (processed_events < enqueued && now_ns() < drain_deadline)
+		usleep(1000);
+
+	uint64_t ns = now_ns() - start;
+	for (i = 0; i < BENCH_WORKERS; i++) {
+		lost += atomic64_read(&tracer->queues[i].enqueue_lost);
+		heap_fallback +=
+		    atomic64_read(&tracer->queues[i].heap_get_faild);
+	}
+
+	report("assembly+dispatch", processed_events, ns);
+	printf("  %-24s enqueued %" PRIu64 " lost %" PRIu64
+	       " heap-fallback allocs %" PRIu64 "\n", "", enqueued, lost,
+	       heap_fallback);
+
+	// 粘性flow分发在各队列上的实际摊布
+	printf("  %-24s per-queue:", "");
+	for (i = 0; i < BENCH_WORKERS; i++)
+		printf(" %" PRIu64,
+		       atomic64_read(&tracer->queues[i].enqueue_nr));
+	printf("\n");
+}
+
+/* ==========================================================
+ * 3. flow分发哈希分布
+ * ==========================================================
+ */
+static void bench_dispatch_distribution(int workers_nr)
+{
+	uint64_t counts[MAX_CPU_NR];
+	uint64_t n;
+	struct __tuple_t t;
+
+	memset(counts, 0, sizeof(counts));
+	for (n = 0; n < BENCH_HASH_SAMPLES; n++) {
+		// 随机五元组，用分发路径实际使用的tuple_hash()测首选
+		// 队列的分布（two-choices/粘性映射只会在此之上更均匀）
+		memset(&t, 0, sizeof(t));
+		uint32_t a = rand_u32();
+		memcpy(t.daddr, &a, sizeof(a));
+		a = rand_u32();
+		memcpy(t.rcv_saddr, &a, sizeof(a));
+		t.addr_len = 4;
+		t.l4_protocol = 6;
+		t.dport = (uint16_t) rand_u32();
+		t.num = (uint16_t) rand_u32();
+		counts[socket_tracer_tuple_hash(&t) % workers_nr]++;
+	}
+
+	uint64_t min = counts[0], max = counts[0];
+	int i;
+	for (i = 1; i < workers_nr; i++) {
+		if (counts[i] < min)
+			min = counts[i];
+		if (counts[i] > max)
+			max = counts[i];
+	}
+
+	double avg = (double)BENCH_HASH_SAMPLES / workers_nr;
+	printf("  tuple_hash %2d queues: min %.2f%% max %.2f%% of avg\n",
+	       workers_nr, (double)min * 100.0 / avg,
+	       (double)max * 100.0 / avg);
+}
+
+/* ==========================================================
+ * 4. 录制回放：record_start()落盘的真实流量灌回装配/分发路径
+ * ==========================================================
+ */
+static void replay_frame_cb(void *ctx, void *raw, int raw_size)
+{
+	struct bpf_tracer *tracer = ctx;
+	tracer->raw_cb((void *)tracer, raw, raw_size);
+}
+
+static int bench_replay(const char *path, double speed)
+{
+	struct bpf_tracer *tracer =
+	    create_bpf_tracer("bench-tracer", "bench-load", NULL, 0, NULL,
+			      BENCH_WORKERS, (void *)bench_process_cb, 0);
+	if (tracer == NULL) {
+		printf("  create_bpf_tracer() failed.\n");
+		return -1;
+	}
+
+	tracer->raw_cb = (perf_reader_raw_cb) socket_tracer_raw_cb();
+	if (dispatch_worker(tracer, BENCH_RING_SIZE) != ETR_OK) {
+		printf("  dispatch_worker() failed.\n");
+		return -1;
+	}
+
+	uint64_t start = now_ns();
+	int64_t frames = record_replay(path, speed, replay_frame_cb, tracer);
+	if (frames < 0) {
+		printf("  record_replay() %s failed, err %" PRId64 "\n",
+		       path, frames);
+		return -1;
+	}
+
+	// 等worker把队列消费完
+	uint64_t enqueued = 0, lost = 0, heap_fallback = 0;
+	int i;
+	for (i = 0; i < BENCH_WORKERS; i++)
+		enqueued += atomic64_read(&tracer->queues[i].enqueue_nr);
+
+	uint64_t drain_deadline = now_ns() +
+	    (uint64_t) BENCH_DRAIN_TIMEOUT_S * 1000000000ULL;
+	while (processed_events < enqueued && now_ns() < drain_deadline)
+		usleep(1000);
+
+	uint64_t ns = now_ns() - start;
+	for (i = 0; i < BENCH_WORKERS; i++) {
+		lost += atomic64_read(&tracer->queues[i].enqueue_lost);
+		heap_fallback +=
+		    atomic64_read(&tracer->queues[i].heap_get_faild);
+	}
+
+	printf("  %-24s %12" PRId64 " frames\n", "replay", frames);
+	report("replay events", processed_events, ns);
+	printf("  %-24s enqueued %" PRIu64 " lost %" PRIu64
+	       " heap-fallback allocs %" PRIu64 "\n", "", enqueued, lost,
+	       heap_fallback);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1) {
+		double speed = argc > 2 ? atof(argv[2]) : 0;
+		printf("== replay %s ==\n", argv[1]);
+		return bench_replay(argv[1], speed) == 0 ? 0 : 1;
+	}
+
+	printf("== ring ==\n");
+	bench_ring_single();
+	bench_ring_threaded();
+	bench_ring_mpmc(2, 2);
+	bench_ring_mpmc(4, 4);
+
+	printf("== dispatch distribution ==\n");
+	bench_dispatch_distribution(4);
+	bench_dispatch_distribution(8);
+	bench_dispatch_distribution(16);
+
+	printf("== assembly pipeline ==\n");
+	bench_assembly();
+
+	return 0;
+}
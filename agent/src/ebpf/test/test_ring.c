@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ring MP/MC路径压力测试：
+ *
+ * dispatch_worker()会按perf reader模式和work stealing开关选择
+ * multi-producer/multi-consumer方式创建ring，这里对CAS head更新
+ * 的并发路径做正确性验证——N个生产者各自入队带标记的token，M个
+ * 消费者并发出队，最后核对总条数和按生产者分组的序号和，丢失、
+ * 重复或乱序覆盖都会导致校验失败。
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../user/common.h"
+#include "../user/log.h"
+#include "../user/tracer.h"
+
+#define TEST_RING_SIZE		4096
+#define TEST_EVENTS_PER_PROD	(1024 * 1024ULL)
+#define TEST_PRODUCERS		4
+#define TEST_CONSUMERS		4
+
+// token编码：高8位生产者id，低56位该生产者内的序号（从1开始，避开NULL）
+#define TOKEN(p, seq)		(((uint64_t)(p) << 56) | ((seq) + 1))
+#define TOKEN_PROD(t)		((int)((t) >> 56))
+#define TOKEN_SEQ(t)		(((t) & 0x00ffffffffffffffULL) - 1)
+
+static struct ring *test_r;
+static volatile uint64_t consumed_total;
+static uint64_t consumed_seq_sum[TEST_PRODUCERS];
+static uint64_t consumed_nr[TEST_PRODUCERS];
+static pthread_mutex_t sum_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *producer_fn(void *arg)
+{
+	int id = (int)(uintptr_t) arg;
+	void *burst[MAX_PKT_BURST];
+	uint64_t seq = 0;
+
+	while (seq < TEST_EVENTS_PER_PROD) {
+		int i, n = MAX_PKT_BURST;
+		if (seq + n > TEST_EVENTS_PER_PROD)
+			n = TEST_EVENTS_PER_PROD - seq;
+		for (i = 0; i < n; i++)
+			burst[i] = (void *)(uintptr_t) TOKEN(id, seq + i);
+		seq += ring_mp_enqueue_burst(test_r, burst, n, NULL);
+	}
+
+	return NULL;
+}
+
+static void *consumer_fn(void *arg)
+{
+	void *burst[MAX_PKT_BURST];
+	uint64_t local_sum[TEST_PRODUCERS] = {};
+	uint64_t local_nr[TEST_PRODUCERS] = {};
+	uint64_t expect = TEST_EVENTS_PER_PROD * TEST_PRODUCERS;
+
+	while (__sync_fetch_and_add(&consumed_total, 0) < expect) {
+		int i, n = ring_mc_dequeue_burst(test_r, burst, MAX_PKT_BURST,
+						 NULL);
+		if (n == 0)
+			continue;
+
+		for (i = 0; i < n; i++) {
+			uint64_t t = (uint64_t) (uintptr_t) burst[i];
+			int p = TOKEN_PROD(t);
+			if (p < 0 || p >= TEST_PRODUCERS) {
+				printf("bad token %" PRIu64 "\n", t);
+				exit(1);
+			}
+			local_sum[p] += TOKEN_SEQ(t);
+			local_nr[p]++;
+		}
+		__sync_fetch_and_add(&consumed_total, n);
+	}
+
+	pthread_mutex_lock(&sum_lock);
+	int p;
+	for (p = 0; p < TEST_PRODUCERS; p++) {
+		consumed_seq_sum[p] += local_sum[p];
+		consumed_nr[p] += local_nr[p];
+	}
+	pthread_mutex_unlock(&sum_lock);
+	return NULL;
+}
+
+static int test_mpmc_stress(void)
+{
+	test_r = ring_create("test-ring-mpmc", TEST_RING_SIZE, SOCKET_ID_ANY,
+			     0 /* MP enqueue, MC dequeue */);
+	if (test_r == NULL) {
+		printf("ring_create() failed.\n");
+		return 1;
+	}
+
+	pthread_t prods[TEST_PRODUCERS], cons[TEST_CONSUMERS];
+	int i;
+	for (i = 0; i < TEST_CONSUMERS; i++)
+		pthread_create(&cons[i], NULL, consumer_fn, NULL);
+	for (i = 0; i < TEST_PRODUCERS; i++)
+		pthread_create(&prods[i], NULL, producer_fn,
+			       (void *)(uintptr_t) i);
+
+	for (i = 0; i < TEST_PRODUCERS; i++)
+		pthread_join(prods[i], NULL);
+	for (i = 0; i < TEST_CONSUMERS; i++)
+		pthread_join(cons[i], NULL);
+
+	// 每个生产者的序号和应为 0+1+...+(N-1)
+	uint64_t expect_sum =
+	    TEST_EVENTS_PER_PROD * (TEST_EVENTS_PER_PROD - 1) / 2;
+	int fail = 0;
+	for (i = 0; i < TEST_PRODUCERS; i++) {
+		if (consumed_nr[i] != TEST_EVENTS_PER_PROD ||
+		    consumed_seq_sum[i] != expect_sum) {
+			printf("producer %d: got %" PRIu64 " events (expect %"
+			       PRIu64 "), seq sum %" PRIu64 " (expect %"
+			       PRIu64 ")\n", i, consumed_nr[i],
+			       TEST_EVENTS_PER_PROD, consumed_seq_sum[i],
+			       expect_sum);
+			fail = 1;
+		}
+	}
+
+	if (!ring_empty(test_r)) {
+		printf("ring not empty after drain, count %u\n",
+		       ring_count(test_r));
+		fail = 1;
+	}
+
+	printf("mp/mc stress: %dP/%dC x %" PRIu64 " events ... %s\n",
+	       TEST_PRODUCERS, TEST_CONSUMERS, TEST_EVENTS_PER_PROD,
+	       fail ? "FAILED" : "ok");
+	return fail;
+}
+
+int main(void)
+{
+	return test_mpmc_stress();
+}
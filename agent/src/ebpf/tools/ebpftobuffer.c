@@ -15,6 +15,15 @@
 #include <fcntl.h>
 #include <string.h>
 #include <malloc.h>
+#include <zlib.h>
+
+/*
+ * 输出的buffer为zlib压缩格式，头部为4字节魔数"EBPZ" + 4字节原始
+ * 长度（小端）。多个内核版本的字节码只有一份会被加载，压缩存放，
+ * 加载时由tracer_bpf_load()解压被选中的那份。
+ */
+#define EBPF_BUFFER_MAGIC "EBPZ"
+#define EBPF_BUFFER_HDR_LEN 8
 
 static unsigned char *read_bin_file(char *name, int *len)
 {
@@ -70,6 +79,31 @@ int main(int argc, char *argv[])
 
 	}
 
+	uLongf comp_len = compressBound(len);
+	unsigned char *comp = malloc(comp_len + EBPF_BUFFER_HDR_LEN);
+	if (comp == NULL) {
+		fprintf(stderr, "Memory error!");
+		free(data);
+		return -1;
+	}
+
+	memcpy(comp, EBPF_BUFFER_MAGIC, 4);
+	comp[4] = len & 0xff;
+	comp[5] = (len >> 8) & 0xff;
+	comp[6] = (len >> 16) & 0xff;
+	comp[7] = (len >> 24) & 0xff;
+	if (compress2(comp + EBPF_BUFFER_HDR_LEN, &comp_len, data, len,
+		      Z_BEST_COMPRESSION) != Z_OK) {
+		fprintf(stderr, "compress2() faild.\n");
+		free(comp);
+		free(data);
+		return -1;
+	}
+
+	free(data);
+	data = comp;
+	len = comp_len + EBPF_BUFFER_HDR_LEN;
+
 	char data_buf[1024];
 	remove(target_file);
 	int target_fd = open(target_file, O_RDWR | O_CREAT | O_APPEND, 0777);
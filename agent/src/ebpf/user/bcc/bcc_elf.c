@@ -41,7 +41,15 @@ int openelf_fd(int fd, Elf ** elf_out)
 	if (elf_version(EV_CURRENT) == EV_NONE)
 		return -1;
 
-	*elf_out = elf_begin(fd, ELF_C_READ, 0);
+	/*
+	 * ELF_C_READ_MMAP（elfutils扩展，本项目已依赖elfutils的libelf）：
+	 * 文件整体mmap(MAP_PRIVATE)后原地解析，elf_getdata()直接返回映射
+	 * 内的指针，symtab/strtab不再按节读入堆。对GB级unstripped Go二进
+	 * 制，注册一个进程的瞬时内存峰值从数百MB降为页缓存占用。映射在
+	 * elf_end()时随之释放。
+	 */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	*elf_out = elf_begin(fd, ELF_C_READ_MMAP, 0);
 	if (*elf_out == NULL)
 		return -1;
 
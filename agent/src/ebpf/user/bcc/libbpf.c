@@ -548,6 +548,26 @@ int bpf_obj_get_info(int prog_map_fd, void *info, uint32_t * info_len)
 	return bpf_obj_get_info_by_fd(prog_map_fd, info, info_len);
 }
 
+/*
+ * Enable kernel-side BPF runtime statistics accounting (run_cnt /
+ * run_time_ns in struct bpf_prog_info). Stats stay enabled for as long
+ * as the returned fd is held open. BPF_ENABLE_STATS (cmd 32) exists
+ * since Linux 5.8; the attr layout is spelled out locally so the build
+ * does not depend on a uapi header new enough to define it.
+ */
+int bpf_enable_stats_fd(void)
+{
+	struct {		// union bpf_attr的enable_stats成员布局
+		uint32_t type;
+	} attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = 0;		// BPF_STATS_RUN_TIME
+
+	return syscall(__NR_bpf, 32 /* BPF_ENABLE_STATS */, &attr,
+		       sizeof(attr));
+}
+
 int bpf_prog_compute_tag(const struct bpf_insn *insns, int prog_len,
 			 unsigned long long *ptag)
 {
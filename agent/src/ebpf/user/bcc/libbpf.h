@@ -148,6 +148,8 @@ int bpf_consume_ringbuf(struct ring_buffer *rb);
 int bpf_obj_pin(int fd, const char *pathname);
 int bpf_obj_get(const char *pathname);
 int bpf_obj_get_info(int prog_map_fd, void *info, uint32_t *info_len);
+/* BPF_ENABLE_STATS(BPF_STATS_RUN_TIME)，统计随返回的fd存活（Linux >= 5.8） */
+int bpf_enable_stats_fd(void);
 int bpf_prog_compute_tag(const struct bpf_insn *insns, int prog_len,
                          unsigned long long *tag);
 int bpf_prog_get_tag(int fd, unsigned long long *tag);
@@ -16,6 +16,8 @@
 
 #include <inttypes.h>
 #include <poll.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -30,6 +32,7 @@
 
 #include "libbpf.h"
 #include "perf_reader.h"
+#include "../profiler.h"
 
 struct perf_reader *perf_reader_new(perf_reader_raw_cb raw_cb,
 				    perf_reader_lost_cb lost_cb,
@@ -65,6 +68,7 @@ void perf_reader_free(void *ptr)
 			ioctl(reader->fd, PERF_EVENT_IOC_DISABLE, 0);
 			close(reader->fd);
 		}
+		free(reader->slots);
 		free(reader->buf);
 		free(ptr);
 	}
@@ -102,6 +106,118 @@ struct perf_sample_trace_kprobe {
 	uint64_t ip;
 };
 
+static uint64_t read_data_head(volatile struct perf_event_mmap_page
+			       *perf_header)
+{
+	uint64_t data_head = perf_header->data_head;
+	asm volatile ("":::"memory");
+	return data_head;
+}
+
+static void write_data_tail(volatile struct perf_event_mmap_page *perf_header,
+			    uint64_t data_tail)
+{
+	asm volatile ("":::"memory");
+	perf_header->data_tail = data_tail;
+}
+
+/*
+ * The record the raw callback is currently being invoked for, when it is a
+ * zero-copy view into the mmap'ed ring. One reader is drained by exactly one
+ * thread at a time (rb_use_state CAS) and the callback runs synchronously,
+ * so thread local storage is sufficient to pass the handle down.
+ */
+static __thread struct perf_reader *zc_cur_reader;
+static __thread uint32_t zc_cur_slot;
+static __thread int zc_cur_valid;
+static __thread int zc_cur_claimed;
+
+/*
+ * Switch the reader to zero-copy mode. Must be called after
+ * perf_reader_mmap() and before the first perf_reader_event_read().
+ * The slot ring is sized so that it can never fill up: an in-flight
+ * record occupies at least sizeof(perf_event_header) + 8 ring bytes.
+ */
+int perf_reader_set_zero_copy(struct perf_reader *reader)
+{
+	if (reader->base == NULL)
+		return -1;
+
+	volatile struct perf_event_mmap_page *perf_header = reader->base;
+	uint64_t buffer_size = (uint64_t) reader->page_size * reader->page_cnt;
+
+	reader->slots_size =
+	    buffer_size / (sizeof(struct perf_event_header) + 8);
+	reader->slots =
+	    calloc(reader->slots_size, sizeof(struct perf_record_slot));
+	if (reader->slots == NULL)
+		return -1;
+
+	pthread_mutex_init(&reader->slots_lock, NULL);
+	reader->slot_head = reader->slot_tail = 0;
+	reader->zc_cursor = perf_header->data_tail;
+	reader->zero_copy = 1;
+	return 0;
+}
+
+// 登记一条在途记录，返回槽位号；槽位环已满返回-1（见perf_reader_record_put()）
+static int zc_slot_push(struct perf_reader *reader, uint64_t end, uint32_t *slot)
+{
+	int ret = -1;
+	pthread_mutex_lock(&reader->slots_lock);
+	if (reader->slot_tail - reader->slot_head < reader->slots_size) {
+		*slot = reader->slot_tail;
+		reader->slots[reader->slot_tail % reader->slots_size] =
+		    (struct perf_record_slot) { .end = end, .released = 0 };
+		reader->slot_tail++;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&reader->slots_lock);
+	return ret;
+}
+
+/*
+ * Claim the record currently being delivered to the raw callback as a
+ * zero-copy view. Returns 0 and fills reader/slot when the view outlives
+ * the callback (the caller must perf_reader_record_put() it later), -1
+ * when not in zero-copy mode or the record wrapped around the ring (in
+ * which case the data must be copied before the callback returns).
+ */
+int perf_reader_record_claim(struct perf_reader **reader, uint32_t *slot)
+{
+	if (!zc_cur_valid)
+		return -1;
+	*reader = zc_cur_reader;
+	*slot = zc_cur_slot;
+	zc_cur_claimed = 1;
+	return 0;
+}
+
+/*
+ * Release an in-flight record. data_tail only advances over the contiguous
+ * prefix of released records, so records may be released in any order
+ * (records are scattered over the dispatch queues and finish out of order).
+ */
+void perf_reader_record_put(struct perf_reader *reader, uint32_t slot)
+{
+	volatile struct perf_event_mmap_page *perf_header = reader->base;
+	uint64_t new_tail = 0;
+	int advanced = 0;
+
+	pthread_mutex_lock(&reader->slots_lock);
+	reader->slots[slot % reader->slots_size].released = 1;
+	while (reader->slot_head != reader->slot_tail &&
+	       reader->slots[reader->slot_head % reader->slots_size].released) {
+		new_tail = reader->slots[reader->slot_head %
+					 reader->slots_size].end;
+		reader->slot_head++;
+		advanced = 1;
+	}
+	if (advanced)
+		write_data_tail(perf_header, new_tail);
+	pthread_mutex_unlock(&reader->slots_lock);
+}
+
 static void parse_sw(struct perf_reader *reader, void *data, int size)
 {
 	uint8_t *ptr = data;
@@ -135,22 +251,7 @@ static void parse_sw(struct perf_reader *reader, void *data, int size)
 		reader->raw_cb(reader->cb_cookie, raw->data, raw->size);
 }
 
-static uint64_t read_data_head(volatile struct perf_event_mmap_page
-			       *perf_header)
-{
-	uint64_t data_head = perf_header->data_head;
-	asm volatile ("":::"memory");
-	return data_head;
-}
-
-static void write_data_tail(volatile struct perf_event_mmap_page *perf_header,
-			    uint64_t data_tail)
-{
-	asm volatile ("":::"memory");
-	perf_header->data_tail = data_tail;
-}
-
-void perf_reader_event_read(struct perf_reader *reader)
+int perf_reader_event_read(struct perf_reader *reader)
 {
 	volatile struct perf_event_mmap_page *perf_header = reader->base;
 	uint64_t buffer_size = (uint64_t) reader->page_size * reader->page_cnt;
@@ -159,34 +260,82 @@ void perf_reader_event_read(struct perf_reader *reader)
 	uint8_t *sentinel =
 	    (uint8_t *) reader->base + buffer_size + reader->page_size;
 	uint8_t *begin, *end;
+	int nr_events = 0;
+
+	// resize两个尺寸的mmap都失败后base为NULL（见perf_reader_resize()），
+	// 跳过本次唤醒，周期线程的下一次resize会重建映射
+	if (reader->base == NULL)
+		return 0;
 
 	reader->rb_read_tid = syscall(__NR_gettid);
 	if (!__sync_bool_compare_and_swap
 	    (&reader->rb_use_state, RB_NOT_USED, RB_USED_IN_READ))
-		return;
+		return 0;
+
+	PROF_START(PROF_STAGE_READER_READ);
 
 	// Consume all the events on this ring, calling the cb function for each one.
 	// The message may fall on the ring boundary, in which case copy the message
 	// into a malloced buffer.
+	// In zero-copy mode a private cursor walks the ring instead of data_tail;
+	// each record is registered as an in-flight slot and data_tail only moves
+	// once the slots are released (perf_reader_record_put()).
+	uint64_t cursor = reader->zero_copy ? reader->zc_cursor
+					    : perf_header->data_tail;
+	uint64_t start_cursor = cursor;
 	for (data_head = read_data_head(perf_header);
-	     perf_header->data_tail != data_head;
-	     data_head = read_data_head(perf_header)) {
-		uint64_t data_tail = perf_header->data_tail;
+	     cursor != data_head; data_head = read_data_head(perf_header)) {
 		uint8_t *ptr;
+		uint32_t slot = 0;
+		int slot_ok = -1;
+		bool wrapped = false;
 
-		begin = base + data_tail % buffer_size;
+		begin = base + cursor % buffer_size;
 		// event header is u64, won't wrap
 		struct perf_event_header *e = (void *)begin;
 		ptr = begin;
-		end = base + (data_tail + e->size) % buffer_size;
+		end = base + (cursor + e->size) % buffer_size;
 		if (end < begin) {
-			// perf event wraps around the ring, make a contiguous copy
-			reader->buf = realloc(reader->buf, e->size);
+			/*
+			 * perf event wraps around the ring, make a contiguous
+			 * copy. The scratch buffer persists across events and
+			 * only grows; with 64-page rings boundary events fire
+			 * thousands of times per second per CPU and per-event
+			 * malloc/free showed up in profiles.
+			 */
+			if (e->size > reader->buf_size) {
+				void *nbuf = realloc(reader->buf, e->size);
+				if (nbuf == NULL) {
+					// drop the record, tail still advances
+					cursor += e->size;
+					if (reader->zero_copy)
+						reader->zc_cursor = cursor;
+					continue;
+				}
+				reader->buf = nbuf;
+				reader->buf_size = e->size;
+			}
 			size_t len = sentinel - begin;
 			memcpy(reader->buf, begin, len);
 			memcpy((void *)((unsigned long)reader->buf + len), base,
 			       e->size - len);
 			ptr = reader->buf;
+			wrapped = true;
+		}
+
+		if (reader->zero_copy) {
+			/*
+			 * 槽位环按最小记录长度确定容量，push不会失败；万一失败
+			 * 该记录的区间由后续槽位的累积end值覆盖，不影响正确性。
+			 */
+			slot_ok = zc_slot_push(reader, cursor + e->size, &slot);
+			if (slot_ok == 0 && !wrapped &&
+			    e->type == PERF_RECORD_SAMPLE) {
+				zc_cur_reader = reader;
+				zc_cur_slot = slot;
+				zc_cur_valid = 1;
+				zc_cur_claimed = 0;
+			}
 		}
 
 		if (e->type == PERF_RECORD_LOST) {
@@ -200,6 +349,7 @@ void perf_reader_event_read(struct perf_reader *reader)
 			 */
 			uint64_t lost =
 			    *(uint64_t *) (ptr + sizeof(*e) + sizeof(uint64_t));
+			reader->lost_nr += lost;
 			if (reader->lost_cb) {
 				reader->lost_cb(reader->cb_cookie, lost);
 			} else {
@@ -214,11 +364,98 @@ void perf_reader_event_read(struct perf_reader *reader)
 				__FUNCTION__, e->type);
 		}
 
-		write_data_tail(perf_header, perf_header->data_tail + e->size);
+		cursor += e->size;
+		if (reader->zero_copy) {
+			reader->zc_cursor = cursor;
+			if (slot_ok == 0 && !(zc_cur_valid && zc_cur_claimed))
+				perf_reader_record_put(reader, slot);
+			zc_cur_valid = 0;
+		}
+		nr_events++;
 	}
+	/*
+	 * Publish data_tail once per drain instead of per event: every store
+	 * dirties the control page shared with the producing CPU, and the
+	 * kernel only needs the final value to reclaim the drained space.
+	 */
+	if (!reader->zero_copy && cursor != start_cursor)
+		write_data_tail(perf_header, cursor);
+	PROF_END(PROF_STAGE_READER_READ);
+	reader->rd_events += nr_events;
 	reader->rb_use_state = RB_NOT_USED;
 	__sync_synchronize();
 	reader->rb_read_tid = 0;
+
+	return nr_events;
+}
+
+/*
+ * Resize the ring by re-creating the mmap with a new page count. The perf
+ * event fd is unchanged (no BPF map update needed); the kernel frees the
+ * old buffer on munmap and allocates a fresh one on mmap. Events delivered
+ * in between are dropped, which is acceptable: rings are only grown when
+ * they are already losing events and only shrunk when idle. Must be called
+ * between two event reads; in zero-copy mode all in-flight records must
+ * have been released (returns -1 to retry later otherwise).
+ */
+int perf_reader_resize(struct perf_reader *reader, int page_cnt)
+{
+	// base为NULL表示上次resize的两个mmap都失败了，此时放行以便
+	// 在原fd上重建映射，而不是让reader永久失效
+	if (reader->fd < 0 || page_cnt <= 0 ||
+	    (reader->base != NULL && page_cnt == reader->page_cnt))
+		return -1;
+
+	if (reader->zero_copy) {
+		int busy;
+		pthread_mutex_lock(&reader->slots_lock);
+		busy = reader->slot_head != reader->slot_tail;
+		pthread_mutex_unlock(&reader->slots_lock);
+		if (busy)
+			return -1;
+	}
+
+	if (!__sync_bool_compare_and_swap
+	    (&reader->rb_use_state, RB_NOT_USED, RB_USED_IN_READ))
+		return -1;
+
+	int old_cnt = reader->page_cnt;
+	int was_dead = (reader->base == NULL);
+	if (reader->base)
+		munmap(reader->base, reader->page_size * (old_cnt + 1));
+	reader->base =
+	    mmap(NULL, reader->page_size * (page_cnt + 1),
+		 PROT_READ | PROT_WRITE, MAP_SHARED, reader->fd, 0);
+	if (reader->base == MAP_FAILED) {
+		// fall back to the original size
+		reader->base =
+		    mmap(NULL, reader->page_size * (old_cnt + 1),
+			 PROT_READ | PROT_WRITE, MAP_SHARED, reader->fd, 0);
+		if (reader->base == MAP_FAILED) {
+			/*
+			 * 两个尺寸都失败（内存压力）。置NULL让
+			 * perf_reader_event_read()跳过该reader，fd保持
+			 * 注册，等下一次resize在原fd上重建映射后恢复。
+			 */
+			reader->base = NULL;
+			reader->rb_use_state = RB_NOT_USED;
+			return -1;
+		}
+		page_cnt = old_cnt;
+	}
+
+	reader->page_cnt = page_cnt;
+	if (reader->zero_copy) {
+		// the new mapping starts with a fresh head/tail, rebuild slots
+		free(reader->slots);
+		reader->slots = NULL;
+		reader->zero_copy = 0;
+		perf_reader_set_zero_copy(reader);
+	}
+
+	reader->rb_use_state = RB_NOT_USED;
+	// 重建缺失的映射即使尺寸未变也算成功
+	return (page_cnt == old_cnt && !was_dead) ? -1 : 0;
 }
 
 int perf_reader_poll(int num_readers, struct perf_reader **readers, int timeout)
@@ -242,11 +479,47 @@ int perf_reader_poll(int num_readers, struct perf_reader **readers, int timeout)
 
 int perf_reader_consume(int num_readers, struct perf_reader **readers)
 {
-	int i;
+	int i, nr = 0;
 	for (i = 0; i < num_readers; ++i) {
-		perf_reader_event_read(readers[i]);
+		nr += perf_reader_event_read(readers[i]);
 	}
-	return 0;
+	return nr;
+}
+
+/* Create an epoll instance watching the fds of all readers. Returns the
+ * epoll fd, or a negative number on failure. */
+int perf_reader_epoll_new(int num_readers, struct perf_reader **readers)
+{
+	int i, epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+		return epoll_fd;
+
+	for (i = 0; i < num_readers; ++i) {
+		struct epoll_event ev = {
+			.events = EPOLLIN,
+			.data.ptr = readers[i],
+		};
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, readers[i]->fd, &ev) < 0) {
+			close(epoll_fd);
+			return -1;
+		}
+	}
+
+	return epoll_fd;
+}
+
+/* Wait on an epoll fd created by perf_reader_epoll_new() and drain the
+ * readers that became readable. Returns the number of events consumed. */
+int perf_reader_epoll_wait(int epoll_fd, int max_readers, int timeout)
+{
+	struct epoll_event events[max_readers];
+	int i, nr = 0;
+	int n = epoll_wait(epoll_fd, events, max_readers, timeout);
+
+	for (i = 0; i < n; ++i)
+		nr += perf_reader_event_read((struct perf_reader *)
+					     events[i].data.ptr);
+	return nr;
 }
 
 void perf_reader_set_fd(struct perf_reader *reader, int fd)
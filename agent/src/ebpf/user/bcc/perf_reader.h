@@ -17,6 +17,7 @@
 #ifndef PERF_READER_H
 #define PERF_READER_H
 
+#include <pthread.h>
 #include "libbpf.h"
 
 #ifdef __cplusplus
@@ -28,6 +29,18 @@ enum {
 	RB_USED_IN_READ = 2,	// used in read
 };
 
+/*
+ * In zero-copy mode raw samples are handed to the callback as views into
+ * the mmap'ed ring. data_tail is only advanced once the in-flight records
+ * are released (perf_reader_record_put()), so the kernel cannot overwrite
+ * them while consumers still hold views. Slot 'end' values are absolute
+ * ring positions; tail advances over the contiguous released prefix.
+ */
+struct perf_record_slot {
+	uint64_t end;		// data_tail value once this record is consumed
+	int released;
+};
+
 struct perf_reader {
 	perf_reader_raw_cb raw_cb;
 	perf_reader_lost_cb lost_cb;
@@ -40,6 +53,19 @@ struct perf_reader {
 	int page_size;
 	int page_cnt;
 	int fd;
+
+	// feedback counters driving adaptive buffer sizing
+	uint64_t lost_nr;	// events reported lost by PERF_RECORD_LOST
+	uint64_t rd_events;	// records consumed from this ring
+
+	// zero-copy mode (see perf_reader_set_zero_copy())
+	int zero_copy;
+	uint64_t zc_cursor;	// read cursor, replaces data_tail while reading
+	struct perf_record_slot *slots;	// ring of in-flight records
+	uint32_t slots_size;
+	uint32_t slot_head;	// absolute indices, [head, tail) in flight
+	uint32_t slot_tail;
+	pthread_mutex_t slots_lock;
 };
 
 struct perf_reader;
@@ -49,12 +75,19 @@ struct perf_reader *perf_reader_new(perf_reader_raw_cb raw_cb,
 				    void *cb_cookie, int page_cnt);
 void perf_reader_free(void *ptr);
 int perf_reader_mmap(struct perf_reader *reader);
-void perf_reader_event_read(struct perf_reader *reader);
+int perf_reader_event_read(struct perf_reader *reader);
 int perf_reader_poll(int num_readers, struct perf_reader **readers,
 		     int timeout);
 int perf_reader_consume(int num_readers, struct perf_reader **readers);
+int perf_reader_epoll_new(int num_readers, struct perf_reader **readers);
+int perf_reader_epoll_wait(int epoll_fd, int max_readers, int timeout);
 int perf_reader_fd(struct perf_reader *reader);
 void perf_reader_set_fd(struct perf_reader *reader, int fd);
+int perf_reader_resize(struct perf_reader *reader, int page_cnt);
+
+int perf_reader_set_zero_copy(struct perf_reader *reader);
+int perf_reader_record_claim(struct perf_reader **reader, uint32_t *slot);
+void perf_reader_record_put(struct perf_reader *reader, uint32_t slot);
 
 #ifdef __cplusplus
 }
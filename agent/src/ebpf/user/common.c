@@ -37,6 +37,135 @@
 #include "log.h"
 #include "../libbpf/src/libbpf_internal.h"
 
+/* ==========================================================
+ * memcpy_fast: 对内存拷贝进行硬件优化。
+ *
+ * 启动时根据CPU能力（cpuid）一次性选择拷贝实现：
+ * x86_64上优先AVX-512，其次AVX2，否则回退到glibc memcpy。
+ * 针对捕获载荷的典型大小（64B ~ 4KB）做了展开优化。
+ * ==========================================================
+ */
+typedef void *(*memcpy_fn_t) (void *dst, const void *src, size_t n);
+
+static void *memcpy_std(void *dst, const void *src, size_t n)
+{
+	return memcpy(dst, src, n);
+}
+
+#ifdef __x86_64__
+#include <immintrin.h>
+
+__attribute__ ((target("avx2")))
+static void *memcpy_avx2(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *) dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	if (n < 32)
+		return memcpy(dst, src, n);
+
+	while (n >= 128) {
+		_mm256_storeu_si256((__m256i *) d,
+				    _mm256_loadu_si256((const __m256i *)s));
+		_mm256_storeu_si256((__m256i *) (d + 32),
+				    _mm256_loadu_si256((const __m256i *)(s + 32)));
+		_mm256_storeu_si256((__m256i *) (d + 64),
+				    _mm256_loadu_si256((const __m256i *)(s + 64)));
+		_mm256_storeu_si256((__m256i *) (d + 96),
+				    _mm256_loadu_si256((const __m256i *)(s + 96)));
+		d += 128;
+		s += 128;
+		n -= 128;
+	}
+
+	while (n >= 32) {
+		_mm256_storeu_si256((__m256i *) d,
+				    _mm256_loadu_si256((const __m256i *)s));
+		d += 32;
+		s += 32;
+		n -= 32;
+	}
+
+	if (n > 0) {
+		// 用重叠的最后32字节覆盖尾部
+		_mm256_storeu_si256((__m256i *) (d + n - 32),
+				    _mm256_loadu_si256((const __m256i *)
+						       (s + n - 32)));
+	}
+
+	return dst;
+}
+
+__attribute__ ((target("avx512f")))
+static void *memcpy_avx512(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *) dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	if (n < 64)
+		return memcpy(dst, src, n);
+
+	while (n >= 256) {
+		_mm512_storeu_si512((void *)d,
+				    _mm512_loadu_si512((const void *)s));
+		_mm512_storeu_si512((void *)(d + 64),
+				    _mm512_loadu_si512((const void *)(s + 64)));
+		_mm512_storeu_si512((void *)(d + 128),
+				    _mm512_loadu_si512((const void *)(s + 128)));
+		_mm512_storeu_si512((void *)(d + 192),
+				    _mm512_loadu_si512((const void *)(s + 192)));
+		d += 256;
+		s += 256;
+		n -= 256;
+	}
+
+	while (n >= 64) {
+		_mm512_storeu_si512((void *)d,
+				    _mm512_loadu_si512((const void *)s));
+		d += 64;
+		s += 64;
+		n -= 64;
+	}
+
+	if (n > 0) {
+		// 用重叠的最后64字节覆盖尾部
+		_mm512_storeu_si512((void *)(d + n - 64),
+				    _mm512_loadu_si512((const void *)
+						       (s + n - 64)));
+	}
+
+	return dst;
+}
+#endif /* __x86_64__ */
+
+static memcpy_fn_t memcpy_fast_fn = memcpy_std;
+
+void memcpy_fast_init(void)
+{
+#ifdef __x86_64__
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		memcpy_fast_fn = memcpy_avx512;
+		ebpf_info("memcpy_fast use AVX-512.\n");
+	} else if (__builtin_cpu_supports("avx2")) {
+		memcpy_fast_fn = memcpy_avx2;
+		ebpf_info("memcpy_fast use AVX2.\n");
+	} else {
+		ebpf_info("memcpy_fast use memcpy.\n");
+	}
+#else
+	/*
+	 * aarch64上glibc的memcpy已经是NEON实现，直接使用。
+	 */
+	ebpf_info("memcpy_fast use memcpy.\n");
+#endif
+}
+
+void *memcpy_fast(void *dst, const void *src, size_t n)
+{
+	return memcpy_fast_fn(dst, src, n);
+}
+
 bool is_core_kernel(void)
 {
 	return (access("/sys/kernel/btf/vmlinux", F_OK) == 0);
@@ -58,6 +187,43 @@ int get_cpus_count(bool ** mask)
 	return n;
 }
 
+// 系统的NUMA节点数，sysfs不可读时按单节点处理
+int get_numa_nodes_count(void)
+{
+	int node = 0;
+	char path[PATH_MAX];
+
+	for (;;) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d", node);
+		if (access(path, F_OK) != 0)
+			break;
+		node++;
+	}
+
+	return node > 0 ? node : 1;
+}
+
+// CPU所属的NUMA节点，查询失败返回0
+int get_numa_node_of_cpu(int cpu)
+{
+	int node;
+	char path[PATH_MAX];
+
+	for (node = 0;; node++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d", node);
+		if (access(path, F_OK) != 0)
+			break;
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpu%d", node, cpu);
+		if (access(path, F_OK) == 0)
+			return node;
+	}
+
+	return 0;
+}
+
 // 系统启动到现在的时间（以秒为单位）
 uint32_t get_sys_uptime(void)
 {
@@ -293,8 +293,14 @@ is_power_of_2(uint32_t n)
 	return n && !(n & (n - 1));
 }
 
+// 运行时按CPU能力选择的内存拷贝实现，memcpy_fast_init()完成选择
+void memcpy_fast_init(void);
+void *memcpy_fast(void *dst, const void *src, size_t n);
 bool is_core_kernel(void);
 int get_cpus_count(bool **mask);
+// NUMA节点数量和CPU所属节点（读取sysfs，失败按单节点/节点0处理）
+int get_numa_nodes_count(void);
+int get_numa_node_of_cpu(int cpu);
 void clear_residual_probes();
 int max_locked_memory_set_unlimited(void);
 int sysfs_write(char *file_name, char *v);
@@ -18,8 +18,14 @@
 #include <string.h>
 #include <netinet/in.h>
 #include <getopt.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
 #include "tracer.h"
 #include "socket.h"
+#include "record.h"
+#include "shm_stats.h"
+#include "profiler.h"
 #include "../libbpf/src/libbpf_internal.h"
 
 #define MFBPF_NAME           "deepflow-ebpfctl"
@@ -31,8 +37,11 @@ typedef enum mfbpf_cmd_e {
 	MFBPF_CMD_DEL,
 	MFBPF_CMD_SET,
 	MFBPF_CMD_SHOW,
+	MFBPF_CMD_PERF,
+	MFBPF_CMD_PROF,
 	MFBPF_CMD_REPLACE,
 	MFBPF_CMD_FLUSH,
+	MFBPF_CMD_RECORD,
 	MFBPF_CMD_HELP,
 } mfbpf_cmd_t;
 
@@ -42,6 +51,7 @@ struct mfbpf_conf {
 	int stats;
 	int interval;
 	int count;
+	bool json;
 	bool color;
 	char *obj;
 	mfbpf_cmd_t cmd;
@@ -65,12 +75,23 @@ struct mfbpf_obj {
 
 static void tracer_help(void)
 {
-	fprintf(stderr, "Usage:\n" "    %s tracer show\n", MFBPF_NAME);
+	fprintf(stderr, "Usage:\n"
+		"    %s tracer show\n"
+		"    %s tracer prof   (agent built with 'make PROF=1')\n"
+		"    %s [-i SEC] [-n COUNT] [-j] tracer perf\n"
+		"        -i SEC    sampling interval (default 1)\n"
+		"        -n COUNT  stop after COUNT samples (default endless)\n"
+		"        -j        one-shot machine-readable (JSON) output\n",
+		MFBPF_NAME, MFBPF_NAME, MFBPF_NAME);
 }
 
 static void socktrace_help(void)
 {
-	fprintf(stderr, "Usage:\n" "    %s tracer show\n", MFBPF_NAME);
+	fprintf(stderr, "Usage:\n"
+		"    %s socktrace show\n"
+		"    %s socktrace record on FILE [MAX_MB]   (default 256)\n"
+		"    %s socktrace record off\n",
+		MFBPF_NAME, MFBPF_NAME, MFBPF_NAME);
 }
 
 static inline char *get_proto_name(uint16_t proto_id)
@@ -117,28 +138,37 @@ static void tracer_dump(struct bpf_tracer_param *param)
 	printf("\n-------------------- Queue ---------------------------\n");
 	int j;
 	uint64_t enqueue_nr, enqueue_lost, burst_count, heap_get_faild,
-	    dequeue_nr;
+	    dequeue_nr, wakeup_nr, wakeup_avoid_nr;
 	enqueue_nr = enqueue_lost = burst_count = heap_get_faild = dequeue_nr =
-	    0;
+	    wakeup_nr = wakeup_avoid_nr = 0;
 	for (j = 0; j < btp->dispatch_workers_nr; j++) {
 		rx_q = &btp->rx_queues[j];
 		printf
 		    ("worker %d for queue, de %" PRIu64 " en %" PRIu64 " lost %"
 		     PRIu64 " alloc faild %" PRIu64 " burst %" PRIu64
-		     " queue size %u cap %u\n", j, rx_q->dequeue_nr,
+		     " wakeup %" PRIu64 " wakeup avoid %" PRIu64
+		     " queue size %u cap %u hwm %u full streak %u stalls %"
+		     PRIu64 "\n", j, rx_q->dequeue_nr,
 		     rx_q->enqueue_nr, rx_q->enqueue_lost, rx_q->heap_get_faild,
-		     rx_q->burst_count, rx_q->queue_size, rx_q->ring_capacity);
+		     rx_q->burst_count, rx_q->wakeup_nr, rx_q->wakeup_avoid_nr,
+		     rx_q->queue_size, rx_q->ring_capacity,
+		     rx_q->occupancy_hwm, rx_q->full_streak_max,
+		     rx_q->stall_nr);
 		heap_get_faild += rx_q->heap_get_faild;
 		dequeue_nr += rx_q->dequeue_nr;
 		enqueue_nr += rx_q->enqueue_nr;
 		enqueue_lost += rx_q->enqueue_lost;
 		burst_count += rx_q->burst_count;
+		wakeup_nr += rx_q->wakeup_nr;
+		wakeup_avoid_nr += rx_q->wakeup_avoid_nr;
 	}
 
 	printf
 	    ("\nSUM dequeue %" PRIu64 " enqueue %" PRIu64 " lost %" PRIu64
-	     " alloc faild %" PRIu64 " burst count %" PRIu64 "\n", dequeue_nr,
-	     enqueue_nr, enqueue_lost, heap_get_faild, burst_count);
+	     " alloc faild %" PRIu64 " burst count %" PRIu64 " wakeup %" PRIu64
+	     " wakeup avoid %" PRIu64 "\n", dequeue_nr, enqueue_nr,
+	     enqueue_lost, heap_get_faild, burst_count, wakeup_nr,
+	     wakeup_avoid_nr);
 
 	fflush(stdout);
 
@@ -345,6 +375,59 @@ int mfbpf_getsockopt(sockoptid_t cmd, const void *in, size_t in_len,
 	return 0;
 }
 
+int mfbpf_setsockopt(sockoptid_t cmd, const void *in, size_t in_len)
+{
+	struct tracer_sock_msg *msg;
+	struct tracer_sock_msg_reply reply_hdr;
+	struct sockaddr_un clt_addr;
+	int clt_fd;
+	int res;
+
+	memset(&clt_addr, 0, sizeof(struct sockaddr_un));
+	clt_addr.sun_family = AF_UNIX;
+	strncpy(clt_addr.sun_path, UNIX_DOMAIN_DEF,
+		sizeof(clt_addr.sun_path) - 1);
+
+	msg = malloc(sizeof(struct tracer_sock_msg));
+	if (NULL == msg) {
+		fprintf(stderr, "[%s] no memory\n", __func__);
+		return -1;
+	}
+
+	clt_fd = socket(PF_UNIX, SOCK_STREAM, 0);
+	res = connect(clt_fd, (struct sockaddr *)&clt_addr, sizeof(clt_addr));
+	if (-1 == res) {
+		fprintf(stderr, "[%s] scoket msg connection error: %s\n",
+			__func__, strerror(errno));
+		free(msg);
+		return -1;
+	}
+
+	memset(msg, 0, sizeof(*msg));
+	msg->version = SOCKOPT_VERSION;
+	msg->id = cmd;
+	msg->type = SOCKOPT_SET;
+	msg->len = in_len;
+	res = msg_send(clt_fd, msg, in, in_len);
+
+	free(msg);
+	msg = NULL;
+
+	if (res) {
+		close(clt_fd);
+		return res;
+	}
+
+	res = msg_recv(clt_fd, &reply_hdr, NULL, NULL);
+	if (res) {
+		close(clt_fd);
+		return res;
+	}
+
+	close(clt_fd);
+	return 0;
+}
+
 static inline void mfbpf_sockopt_msg_free(void *msg)
 {
 	free(msg);
@@ -361,6 +444,26 @@ static inline void fetch_kernel_version(char *buf)
 	snprintf(buf, LINUX_VER_LEN, "Linux %d.%d.%d\n", major, minor, patch);
 }
 
+static void latency_hist_dump(const char *name,
+			      struct stage_latency_stats *s)
+{
+	int i;
+	if (s->count == 0) {
+		printf("  %-16s no samples\n", name);
+		return;
+	}
+
+	printf("  %-16s samples %" PRIu64 " avg %.1f us\n", name, s->count,
+	       (double)s->sum_ns / s->count / 1000.0);
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+		if (s->buckets[i] == 0)
+			continue;
+		printf("    %10.1f - %10.1f us : %" PRIu64 "\n",
+		       (double)(1ULL << i) / 1000.0,
+		       (double)(1ULL << (i + 1)) / 1000.0, s->buckets[i]);
+	}
+}
+
 static int socktrace_do_cmd(struct mfbpf_obj *obj, mfbpf_cmd_t cmd,
 			    struct mfbpf_conf *conf)
 {
@@ -406,6 +509,60 @@ static int socktrace_do_cmd(struct mfbpf_obj *obj, mfbpf_cmd_t cmd,
 		    ("tracer_state:\t%u [ 0 (TRACER_INIT), 1 (TRACER_RUNNING), "
 		     "2 (TRACER_STOP) ]\n\n", sk_trace_params->tracer_state);
 
+		printf("stage latency (sampled 1/%d):\n",
+		       LATENCY_SAMPLE_MASK + 1);
+		latency_hist_dump("kernel->user:",
+				  &sk_trace_params->latency_stats
+				  [LAT_STAGE_KERN_TO_USER]);
+		latency_hist_dump("queue wait:",
+				  &sk_trace_params->latency_stats
+				  [LAT_STAGE_QUEUE_WAIT]);
+		latency_hist_dump("process:",
+				  &sk_trace_params->latency_stats
+				  [LAT_STAGE_PROCESS]);
+		printf("\n");
+
+		// 每个BPF程序的内核侧运行开销，avg为上个采样周期的均值
+		if (sk_trace_params->prog_stats_nr > 0) {
+			printf("bpf prog runtime:\n");
+			for (i = 0; i < sk_trace_params->prog_stats_nr; i++) {
+				struct bpf_prog_rt_stat *ps =
+				    &sk_trace_params->prog_stats[i];
+				printf("  %-40s runs %-12" PRIu64
+				       " total %10.1f ms  avg %6u ns/run\n",
+				       ps->name, ps->run_cnt,
+				       (double)ps->run_time_ns / 1e6,
+				       ps->period_avg_ns);
+			}
+			printf("\n");
+		} else {
+			printf("bpf prog runtime: not supported "
+			       "(kernel < 5.8 without bpf_stats_enabled)\n\n");
+		}
+
+		// 热点计数器从共享内存统计段读取，不经过sockopt往返
+		struct shm_stats_segment *seg = shm_stats_attach();
+		if (seg != NULL) {
+			struct shm_tracer_stats ts;
+			struct shm_queue_stats qs;
+			shm_stats_read_tracer(seg, &ts);
+			printf("shm stats (%s):\n  kern_lost:\t%" PRIu64 "\n",
+			       SHM_STATS_PATH, ts.lost);
+			for (i = 0; i < seg->queues_nr; i++) {
+				shm_stats_read_queue(seg, i, &qs);
+				printf("  queue-%zu enqueue %" PRIu64
+				       " lost %" PRIu64 " dequeue %" PRIu64
+				       " stolen %" PRIu64 " reconfirm %"
+				       PRIu64 "/%" PRIu64 "\n", i,
+				       qs.enqueue_nr, qs.enqueue_lost,
+				       qs.dequeue_nr, qs.stolen_nr,
+				       qs.reconfirm_rewrite_nr,
+				       qs.reconfirm_nr);
+			}
+			munmap(seg, sizeof(*seg));
+			printf("\n");
+		}
+
 		for (i = 0; i < array->count; i++) {
 			if (array->offsets[i].ready != 1)
 				offset_dump(i, &array->offsets[i]);
@@ -417,11 +574,244 @@ static int socktrace_do_cmd(struct mfbpf_obj *obj, mfbpf_cmd_t cmd,
 
 		mfbpf_sockopt_msg_free(sk_trace_params);
 		return ETR_OK;
+	case MFBPF_CMD_RECORD: {
+		struct record_conf_t rc;
+		memset(&rc, 0, sizeof(rc));
+		if (conf->argc >= 1 && strcmp(conf->argv[0], "off") == 0) {
+			rc.on = false;
+		} else if (conf->argc >= 2 &&
+			   strcmp(conf->argv[0], "on") == 0) {
+			rc.on = true;
+			snprintf(rc.path, sizeof(rc.path), "%s",
+				 conf->argv[1]);
+			uint64_t max_mb = 256;
+			if (conf->argc >= 3)
+				max_mb = strtoull(conf->argv[2], NULL, 10);
+			rc.max_bytes = max_mb << 20;
+		} else {
+			socktrace_help();
+			return ETR_INVAL;
+		}
+
+		err = mfbpf_setsockopt(SOCKOPT_SET_SOCKTRACE_RECORD, &rc,
+				       sizeof(rc));
+		if (err == ETR_OK)
+			printf("record %s\n", rc.on ? "started" : "stopped");
+		return err;
+	}
 	default:
 		return ETR_NOTSUPP;
 	}
 }
 
+/*
+ * tracer perf：按间隔重复采样SOCKOPT_GET_TRACER_SHOW做差分，渲染
+ * 每队列的事件速率与ring占用、丢失速率和各协议吞吐，事故现场不再
+ * 需要shell循环加肉眼diff计数器。-j输出单行JSON便于脚本采集。
+ */
+static int tracer_params_fetch(struct bpf_tracer_param_array **out)
+{
+	struct bpf_tracer_param_array *array = NULL;
+	size_t size;
+	int err = mfbpf_getsockopt(SOCKOPT_GET_TRACER_SHOW, NULL, 0,
+				   (void **)&array, &size);
+	if (err != 0)
+		return err;
+
+	if (array == NULL)
+		return ETR_INVAL;
+
+	if (size < sizeof(*array) || size != sizeof(*array) +
+	    array->count * sizeof(struct bpf_tracer_param)) {
+		fprintf(stderr, "corrupted response.\n");
+		mfbpf_sockopt_msg_free(array);
+		return ETR_INVAL;
+	}
+
+	*out = array;
+	return ETR_OK;
+}
+
+static void tracer_perf_render(struct bpf_tracer_param *prev,
+			       struct bpf_tracer_param *cur,
+			       int interval, bool json)
+{
+	struct rx_queue_info *rx, *px;
+	uint64_t lost_ps = (cur->lost - prev->lost) / interval;
+	uint64_t d;
+	bool first = true;
+	int j;
+
+	if (json) {
+		printf("{\"tracer\":\"%s\",\"interval\":%d,"
+		       "\"kern_lost_ps\":%" PRIu64 ",\"queues\":[",
+		       cur->name, interval, lost_ps);
+		for (j = 0; j < cur->dispatch_workers_nr; j++) {
+			rx = &cur->rx_queues[j];
+			px = &prev->rx_queues[j];
+			printf("%s{\"id\":%d,\"dequeue_ps\":%" PRIu64
+			       ",\"enqueue_ps\":%" PRIu64 ",\"lost_ps\":%"
+			       PRIu64 ",\"ring_used\":%u,\"ring_cap\":%u"
+			       ",\"ring_hwm\":%u,\"full_streak\":%u"
+			       ",\"stalls\":%" PRIu64 "}",
+			       j > 0 ? "," : "", j,
+			       (rx->dequeue_nr - px->dequeue_nr) / interval,
+			       (rx->enqueue_nr - px->enqueue_nr) / interval,
+			       (rx->enqueue_lost - px->enqueue_lost) / interval,
+			       rx->queue_size, rx->ring_capacity,
+			       rx->occupancy_hwm, rx->full_streak_max,
+			       rx->stall_nr);
+		}
+		printf("],\"protocols\":{");
+		for (j = 0; j < PROTO_NUM; j++) {
+			d = cur->proto_status[j] - prev->proto_status[j];
+			if (d == 0)
+				continue;
+			printf("%s\"%s\":%" PRIu64, first ? "" : ",",
+			       get_proto_name((uint16_t) j), d / interval);
+			first = false;
+		}
+		printf("}}\n");
+		fflush(stdout);
+		return;
+	}
+
+	char tbuf[32];
+	time_t now = time(NULL);
+	strftime(tbuf, sizeof(tbuf), "%H:%M:%S", localtime(&now));
+	printf("[%s] %s  kern lost/s %" PRIu64 "\n", tbuf, cur->name, lost_ps);
+	printf("%5s %12s %12s %10s %18s %8s %8s %8s\n", "queue", "events/s",
+	       "enqueue/s", "lost/s", "occupancy", "hwm%", "streak", "stalls");
+	for (j = 0; j < cur->dispatch_workers_nr; j++) {
+		rx = &cur->rx_queues[j];
+		px = &prev->rx_queues[j];
+		printf("%5d %12" PRIu64 " %12" PRIu64 " %10" PRIu64
+		       " %8u/%-8u %4.1f%% %7.1f%% %8u %8" PRIu64 "\n", j,
+		       (rx->dequeue_nr - px->dequeue_nr) / interval,
+		       (rx->enqueue_nr - px->enqueue_nr) / interval,
+		       (rx->enqueue_lost - px->enqueue_lost) / interval,
+		       rx->queue_size, rx->ring_capacity,
+		       rx->ring_capacity > 0 ?
+		       100.0 * rx->queue_size / rx->ring_capacity : 0.0,
+		       rx->ring_capacity > 0 ?
+		       100.0 * rx->occupancy_hwm / rx->ring_capacity : 0.0,
+		       rx->full_streak_max, rx->stall_nr);
+	}
+
+	for (j = 0; j < PROTO_NUM; j++) {
+		d = cur->proto_status[j] - prev->proto_status[j];
+		if (d == 0)
+			continue;
+		if (first) {
+			printf("proto:");
+			first = false;
+		}
+		printf("  %s %" PRIu64 "/s", get_proto_name((uint16_t) j),
+		       d / interval);
+	}
+	if (!first)
+		printf("\n");
+	printf("\n");
+	fflush(stdout);
+}
+
+/*
+ * tracer prof：拉取PROF构建（make PROF=1）下累积的各阶段cycle打点。
+ * 默认构建的agent未注册该sockopt，会得到服务端错误提示。
+ */
+static int tracer_prof(void)
+{
+	static const char *stage_names[PROF_STAGE_NUM] = {
+		"reader_read", "raw_cb", "enqueue", "process",
+	};
+	struct prof_params *params = NULL;
+	struct prof_thread_slot *slot;
+	struct prof_stage_stats totals[PROF_STAGE_NUM];
+	size_t size;
+	uint32_t i;
+	int j, err;
+
+	err = mfbpf_getsockopt(SOCKOPT_GET_PROFILER_SHOW, NULL, 0,
+			       (void **)&params, &size);
+	if (err != 0)
+		return err;
+
+	if (params == NULL || size < sizeof(*params) ||
+	    size != sizeof(*params) +
+	    params->threads_nr * sizeof(struct prof_thread_slot)) {
+		fprintf(stderr, "corrupted response.\n");
+		mfbpf_sockopt_msg_free(params);
+		return ETR_INVAL;
+	}
+
+	memset(totals, 0, sizeof(totals));
+	printf("%8s %-12s %16s %12s %12s\n", "tid", "stage", "cycles",
+	       "calls", "cyc/call");
+	for (i = 0; i < params->threads_nr; i++) {
+		slot = &params->threads[i];
+		for (j = 0; j < PROF_STAGE_NUM; j++) {
+			if (slot->stages[j].calls == 0)
+				continue;
+			printf("%8d %-12s %16" PRIu64 " %12" PRIu64 " %12"
+			       PRIu64 "\n", slot->tid, stage_names[j],
+			       slot->stages[j].cycles, slot->stages[j].calls,
+			       slot->stages[j].cycles / slot->stages[j].calls);
+			totals[j].cycles += slot->stages[j].cycles;
+			totals[j].calls += slot->stages[j].calls;
+		}
+	}
+
+	printf("\n");
+	for (j = 0; j < PROF_STAGE_NUM; j++) {
+		if (totals[j].calls == 0)
+			continue;
+		printf("%8s %-12s %16" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+		       "SUM", stage_names[j], totals[j].cycles, totals[j].calls,
+		       totals[j].cycles / totals[j].calls);
+	}
+
+	mfbpf_sockopt_msg_free(params);
+	return ETR_OK;
+}
+
+static int tracer_perf(struct mfbpf_conf *conf)
+{
+	struct bpf_tracer_param_array *prev = NULL, *cur = NULL;
+	int interval = conf->interval > 0 ? conf->interval : 1;
+	int rounds = conf->count;
+	int err, r;
+	size_t i;
+
+	// 机器可读模式默认采样一个间隔后输出一次
+	if (conf->json && rounds == 0)
+		rounds = 1;
+
+	err = tracer_params_fetch(&prev);
+	if (err != ETR_OK)
+		return err;
+
+	for (r = 0; rounds == 0 || r < rounds; r++) {
+		sleep(interval);
+		err = tracer_params_fetch(&cur);
+		if (err != ETR_OK) {
+			mfbpf_sockopt_msg_free(prev);
+			return err;
+		}
+
+		for (i = 0; i < cur->count && i < prev->count; i++)
+			tracer_perf_render(&prev->tracers[i],
+					   &cur->tracers[i], interval,
+					   conf->json);
+
+		mfbpf_sockopt_msg_free(prev);
+		prev = cur;
+		cur = NULL;
+	}
+
+	mfbpf_sockopt_msg_free(prev);
+	return ETR_OK;
+}
+
 static int tracer_do_cmd(struct mfbpf_obj *obj, mfbpf_cmd_t cmd,
 			 struct mfbpf_conf *conf)
 {
@@ -450,6 +840,10 @@ static int tracer_do_cmd(struct mfbpf_obj *obj, mfbpf_cmd_t cmd,
 
 		mfbpf_sockopt_msg_free(array);
 		return ETR_OK;
+	case MFBPF_CMD_PERF:
+		return tracer_perf(conf);
+	case MFBPF_CMD_PROF:
+		return tracer_prof();
 	default:
 		return ETR_NOTSUPP;
 	}
@@ -474,10 +868,13 @@ static void usage(void)
 		"    " MFBPF_NAME " [OPTIONS] OBJECT { COMMAND | help }\n"
 		"Parameters:\n"
 		"    OBJECT  := { tracer socktrace }\n"
-		"    COMMAND := { show list }\n"
+		"    COMMAND := { show list perf prof }\n"
 		"Options:\n"
 		"    -v, --verbose\n"
-		"    -h, --help\n" "    -V, --version\n" "    -C, --color\n");
+		"    -h, --help\n" "    -V, --version\n" "    -C, --color\n"
+		"    -i, --interval SEC   perf sampling interval (default 1)\n"
+		"    -n, --count COUNT    perf sample count (default endless)\n"
+		"    -j, --json           perf one-shot machine-readable output\n");
 }
 
 static struct mfbpf_obj *mfbpf_obj_get(const char *name)
@@ -500,6 +897,9 @@ static int parse_args(int argc, char *argv[], struct mfbpf_conf *conf)
 		{"help", no_argument, NULL, 'h'},
 		{"version", no_argument, NULL, 'V'},
 		{"color", no_argument, NULL, 'C'},
+		{"interval", required_argument, NULL, 'i'},
+		{"count", required_argument, NULL, 'n'},
+		{"json", no_argument, NULL, 'j'},
 		{NULL, 0, NULL, 0},
 	};
 
@@ -511,7 +911,7 @@ static int parse_args(int argc, char *argv[], struct mfbpf_conf *conf)
 		exit(0);
 	}
 
-	while ((opt = getopt_long(argc, argv, "vhVC", opts, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "vhVCi:n:j", opts, NULL)) != -1) {
 		switch (opt) {
 		case 'v':
 			conf->verbose = 1;
@@ -525,6 +925,15 @@ static int parse_args(int argc, char *argv[], struct mfbpf_conf *conf)
 		case 'C':
 			conf->color = true;
 			break;
+		case 'i':
+			conf->interval = atoi(optarg);
+			break;
+		case 'n':
+			conf->count = atoi(optarg);
+			break;
+		case 'j':
+			conf->json = true;
+			break;
 		case '?':
 		default:
 			fprintf(stderr, "Invalid option: %s\n", argv[optind]);
@@ -554,6 +963,15 @@ static int parse_args(int argc, char *argv[], struct mfbpf_conf *conf)
 	if (strcmp(argv[1], "show") == 0 || strcmp(argv[1], "list") == 0) {
 		conf->cmd = MFBPF_CMD_SHOW;
 		goto show_exit;
+	} else if (strcmp(argv[1], "perf") == 0) {
+		conf->cmd = MFBPF_CMD_PERF;
+		goto show_exit;
+	} else if (strcmp(argv[1], "prof") == 0) {
+		conf->cmd = MFBPF_CMD_PROF;
+		goto show_exit;
+	} else if (strcmp(argv[1], "record") == 0) {
+		conf->cmd = MFBPF_CMD_RECORD;
+		goto show_exit;
 	} else if (strcmp(argv[1], "help") == 0) {
 		conf->cmd = MFBPF_CMD_HELP;
 		goto show_exit;
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "common.h"
+#include "log.h"
+#include "flow_ctx.h"
+
+int flow_ctx_init(struct flow_ctx_table *t)
+{
+	memset(t, 0, sizeof(*t));
+	t->slots = calloc(FLOW_CTX_SLOTS, sizeof(struct flow_ctx_entry));
+	if (t->slots == NULL) {
+		ebpf_warning("calloc() failed, no memory.\n");
+		return ETR_NOMEM;
+	}
+
+	// 代从空闲上限之后起步，全零条目（gen为0）初始即视为过期
+	t->gen = FLOW_CTX_IDLE_GENS + 1;
+	return ETR_OK;
+}
+
+// 周期线程每EVENT_PERIOD_TIME（1秒）推进一次
+void flow_ctx_advance_gen(struct flow_ctx_table *t)
+{
+	if (t->slots != NULL)
+		t->gen++;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USER_FLOW_CTX_H_
+#define _USER_FLOW_CTX_H_
+#include <stdint.h>
+#include <string.h>
+// xxhash.h以__u64声明接口，显式引入类型定义，不依赖包含方的引入顺序
+#include "../libbpf/include/linux/types.h"
+#include "../kernel/include/xxhash.h"
+
+/*
+ * per-worker的flow上下文表。
+ *
+ * flow分发把同一socket_id的事件钉在同一个worker上，协议解析状态因此
+ * 可以跨事件留在worker本地：开放寻址、线性探测，单写方（访问发生在
+ * 队列consume_lock之下，work stealing时偷取方同样持锁）无需加锁。
+ *
+ * 回收基于代计数：周期线程每秒推进表的gen，条目在访问时盖上当前代，
+ * 落后超过FLOW_CTX_IDLE_GENS（与socket map的回收超时对齐）的条目视
+ * 为过期，被新flow就地复用，无独立的清扫过程。
+ */
+
+#define FLOW_CTX_SLOTS		8192	// 每worker槽数，2的次幂
+#define FLOW_CTX_PROBE_MAX	8	// 线性探测窗口
+#define FLOW_CTX_STATE_SZ	24	// 解析器私有状态区大小
+#define FLOW_CTX_KAFKA_CORR_NR	4	// Kafka未应答correlation-id环大小
+
+// 空闲代数上限，对应SOCKET_RECLAIM_TIMEOUT_DEF（秒）
+#define FLOW_CTX_IDLE_GENS	10
+
+struct flow_ctx_entry {
+	uint64_t socket_id;	// 0表示空槽
+	uint32_t gen;		// 最近一次访问所在的代
+	uint16_t l7_proto;	// 该连接已确认的协议，PROTO_UNKNOWN为未确认
+	uint8_t mysql_seq;	// MySQL报文序号，用于连续性校验
+	uint8_t kafka_corr_nr;	// correlation环中的有效表项数
+	uint32_t kafka_corr[FLOW_CTX_KAFKA_CORR_NR];	// 未应答请求的correlation-id
+	// 其他解析器的私有状态（HTTP/2 HPACK动态表摘要等）
+	uint8_t state[FLOW_CTX_STATE_SZ];
+};
+
+struct flow_ctx_table {
+	struct flow_ctx_entry *slots;	// FLOW_CTX_SLOTS个
+	volatile uint32_t gen;	// 当前代，周期线程推进
+	uint64_t hit;
+	uint64_t miss;
+	uint64_t evict;		// 过期槽位被新flow复用的次数
+};
+
+int flow_ctx_init(struct flow_ctx_table *t);
+void flow_ctx_advance_gen(struct flow_ctx_table *t);
+
+/*
+ * 查找socket_id的上下文。未命中时在探测窗口内复用空槽或过期槽新建
+ * （返回的条目l7_proto为0即新建），窗口内无可用槽返回NULL，调用方
+ * 退回无状态路径。
+ */
+static inline struct flow_ctx_entry *
+flow_ctx_lookup(struct flow_ctx_table *t, uint64_t socket_id)
+{
+	if (t->slots == NULL || socket_id == 0)
+		return NULL;
+
+	uint32_t idx = (uint32_t) xxhash(socket_id) & (FLOW_CTX_SLOTS - 1);
+	struct flow_ctx_entry *e, *victim = NULL;
+	uint32_t i, gen = t->gen;
+
+	for (i = 0; i < FLOW_CTX_PROBE_MAX; i++) {
+		e = &t->slots[(idx + i) & (FLOW_CTX_SLOTS - 1)];
+		if (e->socket_id == socket_id) {
+			e->gen = gen;
+			t->hit++;
+			return e;
+		}
+
+		if (victim == NULL &&
+		    (e->socket_id == 0 ||
+		     gen - e->gen > FLOW_CTX_IDLE_GENS))
+			victim = e;
+	}
+
+	t->miss++;
+	if (victim == NULL)
+		return NULL;
+
+	if (victim->socket_id != 0)
+		t->evict++;
+
+	memset(victim, 0, sizeof(*victim));
+	victim->socket_id = socket_id;
+	victim->gen = gen;
+	return victim;
+}
+
+#endif /* _USER_FLOW_CTX_H_ */
@@ -53,11 +53,38 @@ static uint64_t procfs_check_count;
 
 static char build_info_magic[] = "\xff Go buildinf:";
 
-struct list_head proc_offsets_head;	// For pid-offsets correspondence lists.
+/*
+ * 静态初始化而不是在collect_uprobe_syms_from_procfs()里初始化：
+ * 该函数只在TRACE_CAP_GO_UPROBE选中时执行，而exec/exit事件处理在
+ * PROC_EVENTS组下就会访问这些链表；且运行期通过update_caps重新开启
+ * GO_UPROBE时不能对带活跃表项的链表/可能被持有的锁重复初始化。
+ */
+struct list_head proc_offsets_head =	// For pid-offsets correspondence lists.
+    LIST_HEAD_INIT(proc_offsets_head);
+
+// proc_offsets的pid哈希索引，链表保持遍历顺序，2的幂个桶
+#define GO_OFFSETS_HASH_BUCKETS 512
+static struct hlist_head proc_offsets_hash[GO_OFFSETS_HASH_BUCKETS];
+
+static inline uint32_t go_offsets_bucket(int pid)
+{
+	return (uint32_t) xxhash((uint64_t) pid) &
+	    (GO_OFFSETS_HASH_BUCKETS - 1);
+}
 
-struct list_head proc_events_head;     // For process execute/exit events list.
+struct list_head proc_events_head =    // For process execute/exit events list.
+    LIST_HEAD_INIT(proc_events_head);
 #define PROC_EVENT_DELAY_HANDLE_DEF	120 // execute/exit events delayed processing time, unit: second
-pthread_mutex_t mutex_proc_events_lock;
+pthread_mutex_t mutex_proc_events_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * 启动时procfs扫描由worker线程池并行执行，uprobe_syms_head和
+ * proc_offsets_head两个链表的修改用该锁保护（ELF解析不持锁）。
+ */
+static pthread_mutex_t go_probes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// procfs并行扫描的worker线程数上限
+#define GO_PROC_SCAN_WORKERS_MAX	8
 
 /* *INDENT-OFF* */
 /* ------------- offsets info -------------- */
@@ -252,7 +279,9 @@ exit:
 static struct proc_offsets *find_offset_by_pid(int pid)
 {
 	struct proc_offsets *p_off;
-	list_for_each_entry(p_off, &proc_offsets_head, list) {
+	struct hlist_node *pos;
+	hlist_for_each_entry(p_off, pos,
+			     &proc_offsets_hash[go_offsets_bucket(pid)], hash) {
 		if (p_off->pid == pid)
 			return p_off;
 	}
@@ -297,6 +326,7 @@ static int resolve_bin_file(const char *path, int pid,
 
 		probe_sym->ver = *go_ver;
 
+		pthread_mutex_lock(&go_probes_lock);
 		if (probe_sym->isret) {
 			size_t addr;
 			int j;
@@ -308,6 +338,7 @@ static int resolve_bin_file(const char *path, int pid,
 				if (sub_probe_sym == NULL) {
 					ebpf_warning("malloc() error.\n");
 					ret = ETR_NOMEM;
+					pthread_mutex_unlock(&go_probes_lock);
 					goto faild;
 				}
 
@@ -316,6 +347,7 @@ static int resolve_bin_file(const char *path, int pid,
 							sub_probe_sym))
 				    != ETR_OK) {
 					free((void *)sub_probe_sym);
+					pthread_mutex_unlock(&go_probes_lock);
 					goto faild;
 				}
 
@@ -336,6 +368,7 @@ static int resolve_bin_file(const char *path, int pid,
 
 		if (probe_sym->isret)
 			free_uprobe_symbol(probe_sym, conf);
+		pthread_mutex_unlock(&go_probes_lock);
 
 		syms_count++;
 	}
@@ -344,11 +377,29 @@ static int resolve_bin_file(const char *path, int pid,
 	struct proc_offsets *p_offs = NULL;
 	if (binary_path) {
 		bool is_new_offset = false;
+
+		// 偏移推断是昂贵的ELF解析，先算好结果再持锁更新链表
+		int off_data[NELEMS(offsets)];
+		for (int k = 0; k < NELEMS(offsets); k++) {
+			off = &offsets[k];
+			int offset =
+			    struct_member_offset_analyze(binary_path,
+							 off->structure,
+							 off->field_name);
+			if (offset == ETR_INVAL)
+				offset = off->default_offset;
+
+			off_data[k] = offset;
+		}
+
+		pthread_mutex_lock(&go_probes_lock);
 		p_offs = find_offset_by_pid(pid);
 		if (p_offs == NULL) {
 			p_offs = alloc_offset_by_pid();
-			if (p_offs == NULL)
+			if (p_offs == NULL) {
+				pthread_mutex_unlock(&go_probes_lock);
 				goto offset_faild;
+			}
 			is_new_offset = true;
 		}
 
@@ -362,25 +413,22 @@ static int resolve_bin_file(const char *path, int pid,
 		}
 		p_offs->path = strdup(binary_path);
 		if (p_offs->path == NULL) {
+			pthread_mutex_unlock(&go_probes_lock);
 			goto offset_faild;
 		}
-		// resolve all offsets.
-		for (int k = 0; k < NELEMS(offsets); k++) {
-			off = &offsets[k];
-			int offset =
-			    struct_member_offset_analyze(binary_path,
-							 off->structure,
-							 off->field_name);
-			if (offset == ETR_INVAL)
-				offset = off->default_offset;
 
-			p_offs->offs.data[off->idx] = offset;
-		}
+		for (int k = 0; k < NELEMS(offsets); k++)
+			p_offs->offs.data[offsets[k].idx] = off_data[k];
 
 		p_offs->has_updated = false;
 
-		if (is_new_offset)
+		if (is_new_offset) {
 			list_add_tail(&p_offs->list, &proc_offsets_head);
+			hlist_add_head(&p_offs->hash,
+				       &proc_offsets_hash[go_offsets_bucket
+							  (pid)]);
+		}
+		pthread_mutex_unlock(&go_probes_lock);
 
 		free(binary_path);
 	}
@@ -420,7 +468,7 @@ offset_faild:
 static int proc_parse_and_register(int pid, struct tracer_probes_conf *conf)
 {
 	int syms_count = 0;
-	char *path = get_elf_path_by_pid(pid);
+	char *path = proc_meta_get_elf_path(pid);
 	if (path == NULL)
 		return syms_count;
 
@@ -443,7 +491,7 @@ static int proc_parse_and_register(int pid, struct tracer_probes_conf *conf)
 bool is_go_process(int pid)
 {
 	bool ret = false;
-	char *path = get_elf_path_by_pid(pid);
+	char *path = proc_meta_get_elf_path(pid);
 	if (path == NULL)
 		return false;
 	struct version_info go_version;
@@ -454,43 +502,45 @@ bool is_go_process(int pid)
 	return ret;
 }
 
-// pid is process or thread ?
+// pid is process or thread ? （status解析走pid元数据缓存）
 static bool is_process(int pid)
 {
-	char file[PATH_MAX], buff[4096];
-	int fd;
-	int read_tgid = -1, read_pid = -1;
-
-	snprintf(file, sizeof(file), "/proc/%d/status", pid);
-	if (access(file, F_OK))
-		return false;
-
-	fd = open(file, O_RDONLY);
-	if (fd < 0)
-		return false;
-
-	read(fd, buff, sizeof(buff));
-	close(fd);
+	return proc_meta_is_process(pid);
+}
 
-	char *p = strstr(buff, "Tgid:");
-	sscanf(p, "Tgid:\t%d", &read_tgid);
+// 并行procfs扫描的共享上下文，worker用原子自增领取pid
+struct proc_scan_ctx {
+	struct tracer_probes_conf *conf;
+	int *pids;
+	int pids_nr;
+	volatile int next_idx;
+};
 
-	p = strstr(buff, "Pid:");
-	sscanf(p, "Pid:\t%d", &read_pid);
+static void *proc_scan_worker(void *arg)
+{
+	struct proc_scan_ctx *ctx = (struct proc_scan_ctx *)arg;
+	int idx, pid;
 
-	if (read_tgid == -1 || read_pid == -1)
-		return false;
+	for (;;) {
+		idx = __sync_fetch_and_add(&ctx->next_idx, 1);
+		if (idx >= ctx->pids_nr)
+			break;
 
-	if (read_tgid != -1 && read_pid != -1 && read_tgid == read_pid)
-		return true;
+		pid = ctx->pids[idx];
+		if (is_process(pid))
+			proc_parse_and_register(pid, ctx->conf);
+	}
 
-	return false;
+	return NULL;
 }
 
 /**
  * collect_uprobe_syms_from_procfs -- Find all golang binary executables from Procfs,
  * 				      parse and register uprobe symbols.
  *
+ * 候选pid先收集到数组，再由worker线程池并行完成ELF解析和注册，
+ * 启动阶段的探测发现随CPU核数扩展而不是随进程数线性变慢。
+ *
  * @tps Where probe was registered.
  * @return ETR_OK if ok, else an error
  */
@@ -499,52 +549,83 @@ int collect_uprobe_syms_from_procfs(struct tracer_probes_conf *conf)
 	struct dirent *entry = NULL;
 	DIR *fddir = NULL;
 
-	INIT_LIST_HEAD(&proc_events_head);
-	INIT_LIST_HEAD(&proc_offsets_head);
-	pthread_mutex_init(&mutex_proc_events_lock, NULL);
-
 	fddir = opendir("/proc/");
 	if (fddir == NULL) {
 		ebpf_warning("Failed to open %s.\n");
 		return ETR_PROC_FAIL;
 	}
 
-	int pid;
+	int pid, pids_cap = 1024, pids_nr = 0;
+	int *pids = malloc(pids_cap * sizeof(int));
+	if (pids == NULL) {
+		ebpf_warning("malloc() pids array failed.\n");
+		closedir(fddir);
+		return ETR_NOMEM;
+	}
+
 	while ((entry = readdir(fddir)) != NULL) {
 		pid = atoi(entry->d_name);
-		if (entry->d_type == DT_DIR && pid > 1 && is_process(pid))
-			proc_parse_and_register(pid, conf);
+		if (entry->d_type == DT_DIR && pid > 1) {
+			if (pids_nr >= pids_cap) {
+				pids_cap <<= 1;
+				int *new_pids =
+				    realloc(pids, pids_cap * sizeof(int));
+				if (new_pids == NULL) {
+					ebpf_warning("realloc() failed.\n");
+					break;
+				}
+				pids = new_pids;
+			}
+			pids[pids_nr++] = pid;
+		}
 	}
 
 	closedir(fddir);
+
+	struct proc_scan_ctx ctx = {
+		.conf = conf,
+		.pids = pids,
+		.pids_nr = pids_nr,
+		.next_idx = 0,
+	};
+
+	int workers_nr = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers_nr > GO_PROC_SCAN_WORKERS_MAX)
+		workers_nr = GO_PROC_SCAN_WORKERS_MAX;
+	if (workers_nr < 1)
+		workers_nr = 1;
+
+	// 当前线程也参与扫描，额外创建workers_nr - 1个线程
+	pthread_t threads[GO_PROC_SCAN_WORKERS_MAX];
+	int i, threads_nr = 0;
+	for (i = 0; i < workers_nr - 1; i++) {
+		if (pthread_create(&threads[threads_nr], NULL,
+				   proc_scan_worker, &ctx) != 0) {
+			ebpf_warning
+			    ("proc scan worker pthread_create() failed, %s\n",
+			     strerror(errno));
+			break;
+		}
+		threads_nr++;
+	}
+
+	proc_scan_worker(&ctx);
+
+	for (i = 0; i < threads_nr; i++)
+		pthread_join(threads[i], NULL);
+
+	free(pids);
 	return ETR_OK;
 }
 
 static bool pid_exist_in_procfs(int pid, unsigned long long starttime)
 {
-	struct dirent *entry = NULL;
-	DIR *fddir = NULL;
-	fddir = opendir("/proc/");
-	if (fddir == NULL) {
-		ebpf_warning("Failed to open %s.\n");
-		return false;
-	}
-
-	int read_pid;
-	unsigned long long stime;
-	while ((entry = readdir(fddir)) != NULL) {
-		read_pid = atoi(entry->d_name);
-		if (entry->d_type == DT_DIR && pid > 1) {
-			stime = get_process_starttime(pid);
-			if (stime > 0 && starttime == stime && read_pid == pid) {
-				closedir(fddir);
-				return true;
-			}
-		}
-	}
-
-	closedir(fddir);
-	return false;
+	/*
+	 * 存活性检查不走缓存：直接读目标pid的starttime即可，pid被
+	 * 复用时starttime必然不同，无需遍历整个/proc。
+	 */
+	unsigned long long stime = get_process_starttime(pid);
+	return stime > 0 && stime == starttime;
 }
 
 static bool probe_exist_in_procfs(struct probe *p)
@@ -554,14 +635,16 @@ static bool probe_exist_in_procfs(struct probe *p)
 	return pid_exist_in_procfs(sym_uprobe->pid, sym_uprobe->starttime);
 }
 
+// pid哈希索引里只有带pid的uprobe，无需再过滤probe类型
 static bool pid_exist_in_probes(struct bpf_tracer *tracer, int pid,
 				unsigned long long starttime)
 {
 	struct probe *p;
+	struct hlist_node *pos;
 	struct symbol_uprobe *sym;
-	list_for_each_entry(p, &tracer->probes_head, list) {
-		if (!(p->type == UPROBE && p->private_data != NULL))
-			continue;
+	hlist_for_each_entry(p, pos,
+			     &tracer->probes_pid_hash[probe_pid_bucket(pid)],
+			     pid_hash) {
 		sym = p->private_data;
 		if (sym->pid == pid && sym->starttime == starttime)
 			return true;
@@ -575,10 +658,11 @@ static bool __attribute__ ((unused)) pid_exist_in_probes_without_stime(struct bp
 								       int pid)
 {
 	struct probe *p;
+	struct hlist_node *pos;
 	struct symbol_uprobe *sym;
-	list_for_each_entry(p, &tracer->probes_head, list) {
-		if (!(p->type == UPROBE && p->private_data != NULL))
-			continue;
+	hlist_for_each_entry(p, pos,
+			     &tracer->probes_pid_hash[probe_pid_bucket(pid)],
+			     pid_hash) {
 		sym = p->private_data;
 		if (sym->pid == pid)
 			return true;
@@ -590,7 +674,9 @@ static bool __attribute__ ((unused)) pid_exist_in_probes_without_stime(struct bp
 static struct proc_offsets *find_go_offsets(int pid)
 {
 	struct proc_offsets *p_off = NULL;
-	list_for_each_entry(p_off, &proc_offsets_head, list) {
+	struct hlist_node *pos;
+	hlist_for_each_entry(p_off, pos,
+			     &proc_offsets_hash[go_offsets_bucket(pid)], hash) {
 		if (p_off->pid == pid)
 			return p_off;
 	}
@@ -606,34 +692,35 @@ static void clear_probes_by_pid(struct bpf_tracer *tracer, int pid,
 {
 	bool info_print = false;
 	struct probe *probe;
-	struct list_head *p, *n;
+	struct hlist_node *pos, *next;
 	struct symbol_uprobe *sym_uprobe;
 
 	struct proc_offsets *p_off = find_go_offsets(pid);
 	if (p_off) {
+		hlist_del_init(&p_off->hash);
 		list_head_del(&p_off->list);
 		free(p_off);
 	}
 
-	list_for_each_safe(p, n, &tracer->probes_head) {
-		probe = container_of(p, struct probe, list);
-		if (!(probe->type == UPROBE && probe->private_data != NULL))
-			continue;
+	hlist_for_each_entry_safe(probe, pos, next,
+				  &tracer->probes_pid_hash[probe_pid_bucket
+							   (pid)], pid_hash) {
 		sym_uprobe = probe->private_data;
-		if (sym_uprobe->pid == pid) {
-			if (probe_detach(probe) != 0) {
-				ebpf_warning
-				    ("path:%s, symbol name:%s probe_detach() faild.\n",
-				     sym_uprobe->binary_path, sym_uprobe->name);
-			}
+		if (sym_uprobe->pid != pid)
+			continue;
 
-			if (!info_print) {
-				ebpf_info("Clear process PID %d\n", pid);
-				info_print = true;
-			}
-				
-			free_probe_from_tracer(probe);
+		if (probe_detach(probe) != 0) {
+			ebpf_warning
+			    ("path:%s, symbol name:%s probe_detach() faild.\n",
+			     sym_uprobe->binary_path, sym_uprobe->name);
+		}
+
+		if (!info_print) {
+			ebpf_info("Clear process PID %d\n", pid);
+			info_print = true;
 		}
+
+		free_probe_from_tracer(probe);
 	}
 }
 
@@ -732,13 +819,49 @@ void update_go_offsets_to_map(struct bpf_tracer *tracer)
 	char buff[4096];
 	struct member_offsets *offs;
 	int len, i;
+	uint32_t pending = 0;
+	bool batch_done = false;
+
+	list_for_each_entry(p_off, &proc_offsets_head, list) {
+		if (!p_off->has_updated)
+			pending++;
+	}
+
+	if (pending == 0)
+		return;
+
+	/*
+	 * 优先通过批量syscall（内核5.6+）一次更新所有待写入的offsets，
+	 * 不支持时回退到逐条bpf_table_set_value()。
+	 */
+	uint32_t *keys = malloc(sizeof(uint32_t) * pending);
+	struct member_offsets *values = malloc(sizeof(*values) * pending);
+	if (keys != NULL && values != NULL) {
+		uint32_t nr = 0;
+		list_for_each_entry(p_off, &proc_offsets_head, list) {
+			if (p_off->has_updated)
+				continue;
+			keys[nr] = p_off->pid;
+			values[nr] = p_off->offs;
+			nr++;
+		}
+
+		uint32_t count = nr;
+		if (bpf_table_update_batch(tracer, MAP_GO_OFFSETS_MAP_NAME,
+					   (void *)keys, (void *)values,
+					   &count) == ETR_OK && count == nr)
+			batch_done = true;
+	}
+
+	free(keys);
+	free(values);
 
 	list_for_each_entry(p_off, &proc_offsets_head, list) {
 		if (p_off->has_updated)
 			continue;
 		offs = &p_off->offs;
 		int pid = p_off->pid;
-		if (!bpf_table_set_value
+		if (!batch_done && !bpf_table_set_value
 		    (tracer, MAP_GO_OFFSETS_MAP_NAME, pid, (void *)offs))
 			continue;
 		len =
@@ -757,46 +880,47 @@ void update_go_offsets_to_map(struct bpf_tracer *tracer)
 	}
 }
 
-static void process_execute_handle(int pid, struct bpf_tracer *tracer)
+static void process_exit_handle(int pid, struct bpf_tracer *tracer)
 {
 	/*
 	 * Probes attach/detach in multithreading
 	 * e.g.: In start/stop tracer need process probes in different threads.
-	 * Protect the probes operation in multiple threads by use mutex_probes_lock. 
+	 * Protect the probes operation in multiple threads by use mutex_probes_lock.
 	 */
 	pthread_mutex_lock(&tracer->mutex_probes_lock);
 	struct tracer_probes_conf *conf = tracer->tps;
-	// Clear all probe process id == pid
-	clear_probes_by_pid(tracer, pid, conf);
-	// Resolve symbols and register uprobe symbols  
-	if (proc_parse_and_register(pid, conf) > 0) {
-		// Add new probes by symbols 
-		tracer_uprobes_update(tracer);
-		// Attach probes
-		int count = 0;
-		if (tracer_hooks_process(tracer, HOOK_ATTACH, &count) == ETR_OK) {
-			if (count > 0)
-				// Update offsets map
-				update_go_offsets_to_map(tracer);
-		}
-	}
-	pthread_mutex_unlock(&tracer->mutex_probes_lock);
-}
-
-static void process_exit_handle(int pid, struct bpf_tracer *tracer)
-{
-	// Protect the probes operation in multiple threads, similar to process_execute_handle()
-	pthread_mutex_lock(&tracer->mutex_probes_lock);
-	struct tracer_probes_conf *conf = tracer->tps;
 	clear_probes_by_pid(tracer, pid, conf);
 	pthread_mutex_unlock(&tracer->mutex_probes_lock);
 }
 
 static void add_event_to_proc_header(struct bpf_tracer *tracer, int pid, uint8_t type)
 {
-	char *path = get_elf_path_by_pid(pid);
+	char *path = proc_meta_get_elf_path(pid);
 	if (path == NULL)
 		return;
+
+	/*
+	 * 防抖：同一pid的重复exec（如容器内的多级exec链）只保留最新
+	 * 事件并顺延到期时间，避免到期后对同一进程做多次attach。移到
+	 * 链表尾部保持按到期时间有序。
+	 */
+	struct process_event *e;
+	pthread_mutex_lock(&mutex_proc_events_lock);
+	list_for_each_entry(e, &proc_events_head, list) {
+		if (e->pid == pid && e->type == type) {
+			free(e->path);
+			e->path = path;
+			e->tracer = tracer;
+			e->expire_time = get_sys_uptime() +
+			    PROC_EVENT_DELAY_HANDLE_DEF;
+			list_head_del(&e->list);
+			list_add_tail(&e->list, &proc_events_head);
+			pthread_mutex_unlock(&mutex_proc_events_lock);
+			return;
+		}
+	}
+	pthread_mutex_unlock(&mutex_proc_events_lock);
+
 	struct process_event *pe = calloc(1, sizeof(struct process_event));
 	if (pe == NULL) {
 		free(path);
@@ -821,6 +945,9 @@ static void add_event_to_proc_header(struct bpf_tracer *tracer, int pid, uint8_t
  */
 void go_process_exec(int pid)
 {
+	// exec改变了exe链接与starttime，先失效该pid的procfs元数据缓存
+	proc_meta_evict(pid);
+
 	struct bpf_tracer *tracer = find_bpf_tracer(SK_TRACER_NAME);
 	if (tracer == NULL)
 		return;
@@ -843,6 +970,8 @@ void go_process_exec(int pid)
  */
 void go_process_exit(int pid)
 {
+	proc_meta_evict(pid);
+
 	struct bpf_tracer *tracer = find_bpf_tracer(SK_TRACER_NAME);
 	if (tracer == NULL)
 		return;
@@ -850,48 +979,100 @@ void go_process_exit(int pid)
 	if (tracer->state != TRACER_RUNNING)
 		return;
 
+	/*
+	 * 先丢弃该pid尚未到期的exec事件：CI场景下大量短命Go进程在防抖
+	 * 窗口内就退出了，它们不应再消耗符号解析和probe attach的开销。
+	 */
+	struct process_event *pe, *next;
+	pthread_mutex_lock(&mutex_proc_events_lock);
+	list_for_each_entry_safe(pe, next, &proc_events_head, list) {
+		if (pe->pid == pid) {
+			list_head_del(&pe->list);
+			free(pe->path);
+			free(pe);
+		}
+	}
+	pthread_mutex_unlock(&mutex_proc_events_lock);
+
 	process_exit_handle(pid, tracer);
 }
 
+/*
+ * 批量处理同一轮唤醒中到期的exec事件：逐进程做符号解析和probe登记，
+ * uprobes更新、attach和offsets map下发对整批只做一次，probe锁也只
+ * 进出一次。单个事件时动作与原先的逐事件处理完全相同。
+ */
+static void process_execute_batch(struct list_head *events)
+{
+	struct process_event *pe, *next;
+	struct bpf_tracer *tracer;
+	int registered;
+
+	while (!list_empty(events)) {
+		pe = list_first_entry(events, struct process_event, list);
+		tracer = pe->tracer;
+		registered = 0;
+
+		pthread_mutex_lock(&tracer->mutex_probes_lock);
+		struct tracer_probes_conf *conf = tracer->tps;
+		list_for_each_entry_safe(pe, next, events, list) {
+			if (pe->tracer != tracer)
+				continue;
+			list_head_del(&pe->list);
+			clear_probes_by_pid(tracer, pe->pid, conf);
+			if (access(pe->path, F_OK) == 0 &&
+			    proc_parse_and_register(pe->pid, conf) > 0)
+				registered++;
+			free(pe->path);
+			free(pe);
+		}
+
+		if (registered > 0) {
+			tracer_uprobes_update(tracer);
+			int count = 0;
+			if (tracer_hooks_process(tracer, HOOK_ATTACH,
+						 &count) == ETR_OK && count > 0)
+				update_go_offsets_to_map(tracer);
+		}
+		pthread_mutex_unlock(&tracer->mutex_probes_lock);
+	}
+}
+
 /**
  * go_process_events_handle - process exec/exit events handle for thread entry.
  */
 void go_process_events_handle(void)
 {
 	struct process_event *pe;
+	struct list_head expired;
 
 	for(;;) {
-		do {
-			// Multithreaded safe fetch 'struct process_event'
-			pthread_mutex_lock(&mutex_proc_events_lock);
-			if (!list_empty(&proc_events_head)) {
-				pe = list_first_entry(&proc_events_head,
-						      struct process_event, list);
-			} else {
-				pe = NULL;
-			}
-			pthread_mutex_unlock(&mutex_proc_events_lock);
-
-			if (pe == NULL)
+		/*
+		 * 摘下所有已到期的事件后统一处理，churn的开销是
+		 * O(存活进程数)而不是O(事件数)：防抖窗口内退出的进程
+		 * 已被go_process_exit()从链表里删掉了。
+		 */
+		INIT_LIST_HEAD(&expired);
+		uint32_t now = get_sys_uptime();
+
+		pthread_mutex_lock(&mutex_proc_events_lock);
+		while (!list_empty(&proc_events_head)) {
+			pe = list_first_entry(&proc_events_head,
+					      struct process_event, list);
+			if (now < pe->expire_time)
 				break;
-
-			if (get_sys_uptime() >= pe->expire_time) {
-				pthread_mutex_lock(&mutex_proc_events_lock);
-				list_head_del(&pe->list);
-				pthread_mutex_unlock(&mutex_proc_events_lock);
-
-				if (pe->type == EVENT_TYPE_PROC_EXEC) {
-					if (access(pe->path, F_OK) == 0) {
-						process_execute_handle(pe->pid, pe->tracer);
-					}
-				}
-
+			list_head_del(&pe->list);
+			if (pe->type == EVENT_TYPE_PROC_EXEC) {
+				list_add_tail(&pe->list, &expired);
+			} else {
 				free(pe->path);
 				free(pe);
-			} else {
-				break;
 			}
-		} while(true);
+		}
+		pthread_mutex_unlock(&mutex_proc_events_lock);
+
+		if (!list_empty(&expired))
+			process_execute_batch(&expired);
 
 		usleep(LOOP_DELAY_US);
 	}
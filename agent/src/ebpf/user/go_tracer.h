@@ -31,6 +31,7 @@ struct data_members {
 // Pid correspond to offsets.
 struct proc_offsets {
 	struct list_head list;
+	struct hlist_node hash;	// pid哈希索引挂接点，list保持遍历顺序
 	int pid;
 	char *path;
 	unsigned long long starttime;	// The time the process started after system boot.
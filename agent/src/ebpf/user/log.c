@@ -17,15 +17,44 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <sys/uio.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include "ring.h"
 #include "log.h"
 
 FILE *log_stream;
 bool log_to_stdout;
 
+/*
+ * 异步日志。生产者把格式化好的消息入无锁ring，后台线程负责真正的
+ * write()，数据路径上的ebpf_info()/ebpf_warning()不再被同步IO放大
+ * （journald一次格式化写入实测20µs+，恰恰在过载场景触发最频繁）。
+ * log_async_init()之前（启动阶段）以及FATAL/ABORT路径保持同步输出。
+ */
+#define LOG_RING_SIZE		1024
+#define LOG_DRAIN_BURST		64
+#define LOG_IDLE_SLEEP_US	50000	// 空闲时后台线程的睡眠间隔
+
+// 每调用点限速：稳定10条/秒，突发20条
+#define LOG_RL_TOKEN_NS		100000000ULL	// 1条日志的令牌价
+#define LOG_RL_BURST_NS		(20 * LOG_RL_TOKEN_NS)
+
+struct log_msg {
+	uint16_t len;
+	char data[0];
+};
+
+static struct ring *log_ring;
+static pthread_t log_pthread;
+static volatile bool log_async;
+static volatile uint64_t log_dropped;	// ring满丢弃的消息数
+
 void os_panic(void) __attribute__ ((weak));
 
 void os_panic(void)
@@ -83,13 +112,132 @@ static char *dispatch_message(char *msg, uint16_t len)
 	return msg;
 }
 
-void _ebpf_error(int how_to_die,
+/*
+ * 消息出口。异步模式下入ring交给后台线程写，ring满直接丢弃并计数
+ * （丢弃数由后台线程汇总输出），绝不在生产者侧阻塞。
+ */
+static void log_output(char *msg, uint16_t len)
+{
+	if (!log_async) {
+		dispatch_message(msg, len);
+		return;
+	}
+
+	struct log_msg *m = malloc(sizeof(*m) + len);
+	if (m != NULL) {
+		m->len = len;
+		memcpy(m->data, msg, len);
+		if (ring_mp_enqueue_burst(log_ring, (void **)&m, 1, NULL) == 1)
+			return;
+		free(m);
+	}
+	__sync_fetch_and_add(&log_dropped, 1);
+}
+
+static uint64_t log_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * 每调用点令牌桶。精确性要求不高（统计近似即可），tokens的读改写
+ * 不加锁，suppressed用原子操作保证计数不丢。
+ */
+static bool log_rate_limit_pass(struct log_rate_limit *rl,
+				uint64_t * suppressed)
+{
+	*suppressed = 0;
+	if (rl == NULL)
+		return true;
+
+	uint64_t now = log_now_ns();
+	uint64_t tokens = rl->tokens_ns;
+	if (rl->last_ns == 0)
+		tokens = LOG_RL_BURST_NS;
+	else
+		tokens += now - rl->last_ns;
+	if (tokens > LOG_RL_BURST_NS)
+		tokens = LOG_RL_BURST_NS;
+	rl->last_ns = now;
+
+	if (tokens < LOG_RL_TOKEN_NS) {
+		rl->tokens_ns = tokens;
+		__sync_fetch_and_add(&rl->suppressed, 1);
+		return false;
+	}
+
+	rl->tokens_ns = tokens - LOG_RL_TOKEN_NS;
+	*suppressed = __sync_lock_test_and_set(&rl->suppressed, 0);
+	return true;
+}
+
+static void log_writer(void *arg)
+{
+	prctl(PR_SET_NAME, "log-writer");
+	void *msgs[LOG_DRAIN_BURST];
+	struct log_msg *m;
+	uint64_t dropped_seen = 0;
+	int nr, i;
+
+	for (;;) {
+		nr = ring_sc_dequeue_burst(log_ring, msgs, LOG_DRAIN_BURST,
+					   NULL);
+		if (nr == 0) {
+			if (log_dropped > dropped_seen) {
+				char buf[MSG_SZ];
+				int len = snprintf(buf, sizeof(buf),
+						   "[eBPF] INFO log ring full, "
+						   "%" PRIu64
+						   " messages dropped\n",
+						   log_dropped - dropped_seen);
+				dropped_seen = log_dropped;
+				dispatch_message(buf, len);
+			}
+			usleep(LOG_IDLE_SLEEP_US);
+			continue;
+		}
+
+		for (i = 0; i < nr; i++) {
+			m = (struct log_msg *)msgs[i];
+			dispatch_message(m->data, m->len);
+			free(m);
+		}
+	}
+}
+
+int log_async_init(void)
+{
+	if (log_async)
+		return 0;
+
+	log_ring = ring_create("log-ring", LOG_RING_SIZE, -1 /* SOCKET_ID_ANY */,
+			       RING_F_SC_DEQ);
+	if (log_ring == NULL)
+		return -1;
+
+	if (pthread_create(&log_pthread, NULL, (void *)log_writer, NULL) != 0)
+		return -1;
+
+	log_async = true;
+	return 0;
+}
+
+void _ebpf_error(struct log_rate_limit *rl, int how_to_die,
 		 char *function_name, uint32_t line_number, char *fmt, ...)
 {
 	char msg[MSG_SZ];
 	uint16_t len = 0;
 	uint16_t max = MSG_SZ;
+	uint64_t suppressed = 0;
 	va_list va;
+
+	// FATAL/ABORT必须同步落盘，不经过ring也不限速
+	if (!(how_to_die & (ERROR_FATAL | ERROR_ABORT)) &&
+	    !(how_to_die & ERROR_NO_RATE_LIMIT) &&
+	    !log_rate_limit_pass(rl, &suppressed))
+		return;
 	time_t timep;
 	struct tm *p;
 	time(&timep);
@@ -117,25 +265,40 @@ void _ebpf_error(int how_to_die,
 	len += vsnprintf(msg + len, max - len, fmt, va);
 	va_end(va);
 
-	len += snprintf(msg + len, max - len, "\033[0m");
-	dispatch_message(msg, len);
-	if (how_to_die & ERROR_ABORT)
-		debugger();
+	if (suppressed > 0) {
+		if (len > 0 && msg[len - 1] == '\n')
+			len--;
+		len += snprintf(msg + len, max - len,
+				" (%" PRIu64 " similar suppressed)\n",
+				suppressed);
+	}
 
-	if (how_to_die & ERROR_FATAL)
+	len += snprintf(msg + len, max - len, "\033[0m");
+	if (how_to_die & (ERROR_FATAL | ERROR_ABORT)) {
+		dispatch_message(msg, len);
+		if (how_to_die & ERROR_ABORT)
+			debugger();
 		error_exit(1);
+	}
+
+	log_output(msg, len);
 }
 
-void _ebpf_info(char *fmt, ...)
+void _ebpf_info(struct log_rate_limit *rl, char *fmt, ...)
 {
 	char msg[MSG_SZ];
 	uint16_t len = 0;
 	uint16_t max = MSG_SZ;
+	uint64_t suppressed = 0;
 	time_t timep;
 	struct tm *p;
+	va_list va;
+
+	if (!log_rate_limit_pass(rl, &suppressed))
+		return;
+
 	time(&timep);
 	p = localtime(&timep);
-	va_list va;
 
 	len += snprintf(msg + len, max - len, "%d-%02d-%02d %d:%d:%d [eBPF] INFO ",
 			(1900 + p->tm_year), (1 + p->tm_mon), p->tm_mday,
@@ -144,6 +307,15 @@ void _ebpf_info(char *fmt, ...)
 	va_start(va, fmt);
 	len += vsnprintf(msg + len, max - len, fmt, va);
 	va_end(va);
+
+	if (suppressed > 0) {
+		if (len > 0 && msg[len - 1] == '\n')
+			len--;
+		len += snprintf(msg + len, max - len,
+				" (%" PRIu64 " similar suppressed)",
+				suppressed);
+	}
+
 	if (msg[len - 1] != '\n') {
 		if (len < max)
 			msg[len++] = '\n';
@@ -151,5 +323,5 @@ void _ebpf_info(char *fmt, ...)
 			msg[len - 1] = '\n';
 	}
 
-	dispatch_message(msg, len);
+	log_output(msg, len);
 }
@@ -20,6 +20,7 @@
 #include <linux/errno.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #ifndef HAVE_ERRNO
@@ -45,15 +46,33 @@ enum
 /* Current function name.  Need (char *) cast to silence gcc4 pointer signedness warning. */
 #define ebpf_error_function ((char *) __FUNCTION__)
 
-#define ebpf_info(format,args...) \
-	_ebpf_info (format, ## args)
+/*
+ * 每个调用点的令牌桶限速状态，由宏展开出的static变量提供。
+ * 热路径上反复触发的同一条日志被折叠成带计数的摘要。
+ */
+struct log_rate_limit {
+	uint64_t tokens_ns;	// 令牌余额，1条日志 = LOG_RL_TOKEN_NS
+	uint64_t last_ns;
+	uint64_t suppressed;	// 被抑制的条数，放行时随消息输出
+};
+
+#define ebpf_info(format,args...) do {				\
+	static struct log_rate_limit __log_rl;			\
+	_ebpf_info (&__log_rl, format, ## args);		\
+} while (0)
 
-#define ebpf_warning(format,args...) \
-	_ebpf_error (ERROR_WARNING, ebpf_error_function, __LINE__, format, ## args)
+#define ebpf_warning(format,args...) do {			\
+	static struct log_rate_limit __log_rl;			\
+	_ebpf_error (&__log_rl, ERROR_WARNING, ebpf_error_function, \
+		     __LINE__, format, ## args);		\
+} while (0)
 
-void _ebpf_error(int how_to_die,
+void _ebpf_error(struct log_rate_limit *rl,
+                 int how_to_die,
                  char *function_name,
                  uint32_t line_number,
                  char *fmt, ...);
-void _ebpf_info(char *fmt, ...);
+void _ebpf_info(struct log_rate_limit *rl, char *fmt, ...);
+// 启动异步日志（后台写线程），之前的日志同步输出
+int log_async_init(void);
 #endif
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "mem.h"
+#include "log.h"
+
+// 直接走syscall做内存NUMA绑定，避免引入libnuma依赖
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#ifndef SOCKET_ID_ANY
+#define SOCKET_ID_ANY -1
+#endif
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+static bool huge_pages_enabled;
+
+void mem_set_hugepages(bool enabled)
+{
+	huge_pages_enabled = enabled;
+}
+
+bool mem_hugepages_enabled(void)
+{
+	return huge_pages_enabled;
+}
+
+/*
+ * 申请大页后备的匿名内存，mmap返回的内存已清零。成功时*real_size
+ * 回填实际映射长度（mem_free_pages()释放时需要，MAP_HUGETLB映射的
+ * munmap长度必须按大页对齐）。未开启、size过小或映射失败返回NULL，
+ * 调用方自行回退。
+ */
+void *mem_alloc_pages(size_t size, size_t * real_size)
+{
+	void *p;
+	size_t len;
+
+	if (!huge_pages_enabled || size < MEM_HUGE_PAGE_SIZE)
+		return NULL;
+
+	// 预留的2MB大页，不经由THP，立即生效
+	len = ALIGN(size, MEM_HUGE_PAGE_SIZE);
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p != MAP_FAILED) {
+		*real_size = len;
+		return p;
+	}
+
+	/*
+	 * 大页池为空或内核不支持时退回普通匿名映射，madvise交给THP
+	 * 按2MB粒度透明合并（尽力而为，失败不影响映射可用性）。
+	 */
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+
+#ifdef MADV_HUGEPAGE
+	madvise(p, len, MADV_HUGEPAGE);
+#endif
+	*real_size = len;
+	return p;
+}
+
+/*
+ * 带NUMA节点倾向的页分配：优先mem_alloc_pages()（大页），未启用
+ * 大页或长度不足时退回普通匿名映射保证页对齐（mbind的要求），再
+ * 对映射区域mbind(MPOL_PREFERRED)。node为SOCKET_ID_ANY时不绑定，
+ * 小于大页门限时也不走大页。绑定是尽力而为，失败不影响内存可用。
+ */
+void *mem_alloc_pages_node(size_t size, size_t * real_size, int node)
+{
+	void *p;
+	size_t len;
+
+	p = mem_alloc_pages(size, real_size);
+	if (p == NULL) {
+		if (node == SOCKET_ID_ANY)
+			return NULL;
+		len = ALIGN(size, 4096);
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			return NULL;
+		*real_size = len;
+	}
+
+	if (node != SOCKET_ID_ANY) {
+		unsigned long nodemask = 1UL << node;
+		if (syscall(__NR_mbind, p, *real_size, MPOL_PREFERRED,
+			    &nodemask, sizeof(nodemask) * 8, 0))
+			ebpf_info("mbind to numa node %d failed: %s\n",
+				  node, strerror(errno));
+	}
+
+	return p;
+}
+
+void mem_free_pages(void *addr, size_t real_size)
+{
+	if (addr == NULL || real_size == 0)
+		return;
+	munmap(addr, real_size);
+}
+
+/*
+ * 各级别块的用户可用大小和预分配数量。
+ * 最大级别要能容纳一次burst的最大数据量
+ * (sizeof(struct __socket_data_buffer)加上用户态提交头的开销)。
+ */
+static const uint32_t class_sizes[HEAP_CLASS_NR] = { 4096, 16384, 40960 };
+static const uint32_t class_block_nr[HEAP_CLASS_NR] = { 1024, 256, 64 };
+
+int block_heap_init(struct block_heap *h, const char *name)
+{
+	int i, j;
+	struct heap_class *c;
+	struct heap_block *b;
+	char ring_name[RING_NAMESIZE];
+
+	memset(h, 0, sizeof(*h));
+	for (i = 0; i < HEAP_CLASS_NR; i++) {
+		c = &h->classes[i];
+		c->block_size =
+		    CACHE_LINE_ROUNDUP(class_sizes[i] +
+				       sizeof(struct heap_block));
+		c->block_nr = class_block_nr[i];
+		atomic64_init(&c->alloc_nr);
+		atomic64_init(&c->free_nr);
+
+		snprintf(ring_name, sizeof(ring_name), "%s-h-%d", name, i);
+		c->free_ring = ring_create(ring_name, c->block_nr,
+					   SOCKET_ID_ANY, RING_F_EXACT_SZ);
+		if (c->free_ring == NULL) {
+			ebpf_warning("<%s> ring_create fail. err:%s\n",
+				     __func__, strerror(errno));
+			goto failed;
+		}
+
+		// 块数组是常驻的多MB连续内存，优先用大页后备降低dTLB压力
+		c->blocks_mz_len = 0;
+		c->blocks = mem_alloc_pages((uint64_t) c->block_size *
+					    c->block_nr, &c->blocks_mz_len);
+		if (c->blocks == NULL)
+			c->blocks =
+			    malloc((uint64_t) c->block_size * c->block_nr);
+		if (c->blocks == NULL) {
+			ebpf_warning("block heap malloc() error, no memory.\n");
+			goto failed;
+		}
+
+		for (j = 0; j < c->block_nr; j++) {
+			b = (struct heap_block *)((uint8_t *) c->blocks +
+						  (uint64_t) j *
+						  c->block_size);
+			b->cls = c;
+			ring_enqueue_burst(c->free_ring, (void **)&b, 1, NULL);
+		}
+	}
+
+	return ETR_OK;
+
+failed:
+	block_heap_destroy(h);
+	return ETR_NOMEM;
+}
+
+void block_heap_destroy(struct block_heap *h)
+{
+	int i;
+	struct heap_class *c;
+	for (i = 0; i < HEAP_CLASS_NR; i++) {
+		c = &h->classes[i];
+		if (c->free_ring) {
+			ring_free(c->free_ring);
+			c->free_ring = NULL;
+		}
+
+		if (c->blocks) {
+			if (c->blocks_mz_len)
+				mem_free_pages(c->blocks, c->blocks_mz_len);
+			else
+				free(c->blocks);
+			c->blocks = NULL;
+			c->blocks_mz_len = 0;
+		}
+	}
+}
+
+/*
+ * 从heap上获取一个能容纳size字节的内存块，返回用户可用地址。
+ * 级别空闲块耗尽或size超过最大级别时回退到malloc()。
+ * 返回NULL表示malloc()也失败了。
+ */
+void *block_heap_get(struct block_heap *h, int size)
+{
+	int i;
+	struct heap_class *c;
+	struct heap_block *b = NULL;
+	uint32_t need = size + sizeof(struct heap_block);
+
+	for (i = 0; i < HEAP_CLASS_NR; i++) {
+		c = &h->classes[i];
+		if (need > c->block_size)
+			continue;
+
+		if (ring_dequeue_burst(c->free_ring, (void **)&b, 1, NULL) == 1) {
+			atomic64_inc(&c->alloc_nr);
+			return b + 1;
+		}
+	}
+
+	b = malloc(need);
+	if (b == NULL)
+		return NULL;
+
+	b->cls = NULL;
+	return b + 1;
+}
+
+/*
+ * 释放block_heap_get()获取的内存块，预分配块回收到所属级别，
+ * malloc()回退分配的块直接free()。
+ */
+void block_heap_put(void *addr)
+{
+	struct heap_block *b = (struct heap_block *)addr - 1;
+	struct heap_class *c = b->cls;
+	if (c == NULL) {
+		free(b);
+		return;
+	}
+
+	ring_enqueue_burst(c->free_ring, (void **)&b, 1, NULL);
+	atomic64_inc(&c->free_nr);
+}
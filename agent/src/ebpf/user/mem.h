@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USER_MEM_H_
+#define _USER_MEM_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "ring.h"
+#include "atomic.h"
+
+/*
+ * 每队列的内存块分配器（slab）。
+ *
+ * reader_raw_cb()为每次perf buffer回调申请一块内存，在高事件速率
+ * 下malloc()成为热点。这里预先分配固定大小（按CACHE_LINE_ROUNDUP
+ * 对齐）的不同级别的内存块，块释放（is_last）时回收到所属级别的
+ * free ring（多生产者/多消费者无锁队列），热路径不再进入malloc()。
+ * 空闲块耗尽时回退到malloc()，块头部cls为NULL标识回退分配。
+ */
+#define HEAP_CLASS_NR   3
+
+struct heap_class {
+	uint32_t block_size;	// 本级别的块大小（含块头，cache line对齐）
+	uint32_t block_nr;	// 本级别预分配的块数量
+	void *blocks;		// 预分配内存的基地址
+	size_t blocks_mz_len;	// 大页映射长度，0表示malloc()分配
+	struct ring *free_ring;	// 空闲块回收队列
+	atomic64_t alloc_nr;	// 从本级别分配成功的次数统计
+	atomic64_t free_nr;	// 回收到本级别的次数统计
+};
+
+struct block_heap {
+	struct heap_class classes[HEAP_CLASS_NR];
+};
+
+/*
+ * 每个内存块的头部，block_heap_put()依据它找到所属级别。
+ */
+struct heap_block {
+	struct heap_class *cls;	// NULL表示malloc()回退分配
+};
+
+/*
+ * 判断地址是否来自预分配的heap（非malloc回退）。
+ */
+static inline bool block_from_heap(void *addr)
+{
+	return ((struct heap_block *)addr - 1)->cls != NULL;
+}
+
+int block_heap_init(struct block_heap *h, const char *name);
+void block_heap_destroy(struct block_heap *h);
+void *block_heap_get(struct block_heap *h, int size);
+void block_heap_put(void *addr);
+
+/*
+ * 大页后备的匿名内存。
+ *
+ * 队列ring与heap块数组是常驻的大块内存，4KB页映射下高事件速率的
+ * 指针遍历在dTLB miss上损失3~4%的cycles。开启后mem_alloc_pages()
+ * 优先尝试MAP_HUGETLB(2MB)，预留大页不足时退回普通匿名映射并
+ * madvise(MADV_HUGEPAGE)交给THP，仍失败返回NULL由调用方回退到
+ * malloc()/calloc()。释放必须带上分配时回填的real_size。
+ */
+#define MEM_HUGE_PAGE_SIZE (2UL << 20)
+
+void mem_set_hugepages(bool enabled);
+bool mem_hugepages_enabled(void);
+void *mem_alloc_pages(size_t size, size_t * real_size);
+// 带NUMA节点倾向的页分配，node为SOCKET_ID_ANY(-1)时不绑定
+void *mem_alloc_pages_node(size_t size, size_t * real_size, int node);
+void mem_free_pages(void *addr, size_t real_size);
+#endif /* _USER_MEM_H_ */
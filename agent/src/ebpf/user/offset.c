@@ -24,13 +24,99 @@
 #include <libdwarf-0/dwarf.h>
 #include <libdwarf-0/libdwarf.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include "bcc/bcc_elf.h"
+#include "log.h"
 
 static const int FOUND_TARGET = 12;
 static const int LEVEL_MAX = 3;
 
+/* ==========================================================
+ * DWARF偏移结果的磁盘缓存
+ *
+ * DWARF DIE遍历对大的调试二进制要花数秒，而成员偏移只取决于
+ * 二进制本身，跨agent重启不变。结果按ELF build-id落盘（没有GNU
+ * build-id的二进制回退到dev/ino/mtime指纹），再次启动时先查缓存，
+ * 命中则完全跳过libdwarf。文件按行存储：
+ *     <id> <structure> <member> <offset>
+ * 解析失败的-1同样缓存，避免每次重启都对无DWARF的二进制重试。
+ * ==========================================================
+ */
+#define OFFSET_CACHE_PATH "/var/run/deepflow_bpf_offsets"
+#define OFFSET_ID_LEN 160
+
+static pthread_mutex_t offset_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int binary_identity(const char *bin, char *id, size_t len)
+{
+	struct stat sb;
+
+	// find_buildid()的十六进制输出，128字节足够
+	if (len >= 128 && bcc_elf_get_buildid(bin, id) == 0)
+		return 0;
+
+	if (stat(bin, &sb) != 0)
+		return -1;
+
+	snprintf(id, len, "dev%lx-ino%lx-mt%lx", (unsigned long)sb.st_dev,
+		 (unsigned long)sb.st_ino, (unsigned long)sb.st_mtime);
+	return 0;
+}
+
+static bool offset_cache_lookup(const char *id, const char *structure,
+				const char *member, int *offset)
+{
+	char line[512], f_id[OFFSET_ID_LEN], f_struct[128], f_member[128];
+	int f_off;
+	bool found = false;
+
+	pthread_mutex_lock(&offset_cache_lock);
+	FILE *fp = fopen(OFFSET_CACHE_PATH, "r");
+	if (fp == NULL) {
+		pthread_mutex_unlock(&offset_cache_lock);
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%159s %127s %127s %d",
+			   f_id, f_struct, f_member, &f_off) != 4)
+			continue;
+
+		if (strcmp(f_id, id) == 0 &&
+		    strcmp(f_struct, structure) == 0 &&
+		    strcmp(f_member, member) == 0) {
+			*offset = f_off;
+			found = true;
+			break;
+		}
+	}
+
+	fclose(fp);
+	pthread_mutex_unlock(&offset_cache_lock);
+	return found;
+}
+
+static void offset_cache_save(const char *id, const char *structure,
+			      const char *member, int offset)
+{
+	pthread_mutex_lock(&offset_cache_lock);
+	FILE *fp = fopen(OFFSET_CACHE_PATH, "a");
+	if (fp == NULL) {
+		ebpf_warning("fopen() %s failed.\n", OFFSET_CACHE_PATH);
+		pthread_mutex_unlock(&offset_cache_lock);
+		return;
+	}
+
+	fprintf(fp, "%s %s %s %d\n", id, structure, member, offset);
+	fclose(fp);
+	pthread_mutex_unlock(&offset_cache_lock);
+}
+
 struct target_data_s {
 	const char *structure;
 	const char *member;
@@ -215,18 +301,27 @@ int struct_member_offset_analyze(const char *bin, const char *structure,
 		.offset = -1,
 	};
 
+	char id[OFFSET_ID_LEN] = { 0 };
+	int cached_offset;
+	bool id_usable = (binary_identity(bin, id, sizeof(id)) == 0);
+	if (id_usable &&
+	    offset_cache_lookup(id, structure, member, &cached_offset))
+		return cached_offset;
+
 	fd = open(bin, O_RDONLY, 0);
 	if (fd < 0)
 		goto out;
 
 	rc = dwarf_init_b(fd, DW_GROUPNUMBER_ANY, NULL, NULL, &dbg, &err);
-	if (rc != DW_DLV_OK)
-		goto out_file;
+	if (rc == DW_DLV_OK) {
+		look_for_our_target(dbg, &td, &err);
+		dwarf_finish(dbg);
+	}
 
-	look_for_our_target(dbg, &td, &err);
+	// 没有DWARF信息同样记录（-1），重启后不再重试
+	if (id_usable)
+		offset_cache_save(id, structure, member, (int)td.offset);
 
-	dwarf_finish(dbg);
-out_file:
 	close(fd);
 out:
 	return (int)td.offset;
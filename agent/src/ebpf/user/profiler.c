@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * 热路径cycle剖析器的累积与导出，仅在make PROF=1构建时编入，
+ * 见profiler.h的说明。
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <syscall.h>
+#include <unistd.h>
+#include "profiler.h"
+#include "ctrl.h"
+#include "log.h"
+
+static struct prof_thread_slot prof_slots[PROF_MAX_THREADS];
+
+// 线程首次打点时认领一个槽位；槽位耗尽后放弃打点不再重试
+static __thread struct prof_thread_slot *prof_self;
+static __thread bool prof_claim_failed;
+
+static struct prof_thread_slot *prof_slot_claim(void)
+{
+	int i;
+	for (i = 0; i < PROF_MAX_THREADS; i++) {
+		if (prof_slots[i].used == 0 &&
+		    __sync_bool_compare_and_swap(&prof_slots[i].used, 0, 1)) {
+			prof_slots[i].tid = syscall(__NR_gettid);
+			return &prof_slots[i];
+		}
+	}
+
+	return NULL;
+}
+
+void prof_record(enum prof_stage stage, uint64_t cycles)
+{
+	if (prof_self == NULL) {
+		if (prof_claim_failed)
+			return;
+		prof_self = prof_slot_claim();
+		if (prof_self == NULL) {
+			prof_claim_failed = true;
+			return;
+		}
+	}
+
+	prof_self->stages[stage].cycles += cycles;
+	prof_self->stages[stage].calls++;
+}
+
+static int profiler_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
+{
+	int i;
+	if (opt != SOCKOPT_SET_PROFILER_CLEAR)
+		return ETR_NOTSUPP;
+
+	// 打点线程无锁累加，清零期间的少量竞态丢失可以接受
+	for (i = 0; i < PROF_MAX_THREADS; i++) {
+		if (prof_slots[i].used)
+			memset(prof_slots[i].stages, 0,
+			       sizeof(prof_slots[i].stages));
+	}
+
+	return ETR_OK;
+}
+
+static int profiler_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+				void **out, size_t * outlen)
+{
+	struct prof_params *params;
+	int i, nr = 0;
+
+	if (opt != SOCKOPT_GET_PROFILER_SHOW)
+		return ETR_NOTSUPP;
+
+	for (i = 0; i < PROF_MAX_THREADS; i++) {
+		if (prof_slots[i].used)
+			nr++;
+	}
+
+	*outlen = sizeof(*params) + nr * sizeof(struct prof_thread_slot);
+	params = calloc(1, *outlen);
+	if (params == NULL) {
+		ebpf_warning("calloc, error:%s\n", strerror(errno));
+		return ETR_NOMEM;
+	}
+
+	params->threads_nr = 0;
+	for (i = 0; i < PROF_MAX_THREADS; i++) {
+		if (!prof_slots[i].used)
+			continue;
+		params->threads[params->threads_nr++] = prof_slots[i];
+	}
+
+	*out = params;
+	return ETR_OK;
+}
+
+static struct tracer_sockopts profiler_sockopts = {
+	.version = SOCKOPT_VERSION,
+	.set_opt_min = SOCKOPT_SET_PROFILER_CLEAR,
+	.set_opt_max = SOCKOPT_SET_PROFILER_CLEAR,
+	.set = profiler_sockopt_set,
+	.get_opt_min = SOCKOPT_GET_PROFILER_SHOW,
+	.get_opt_max = SOCKOPT_GET_PROFILER_SHOW,
+	.get = profiler_sockopt_get,
+};
+
+int profiler_init(void)
+{
+	int err = sockopt_register(&profiler_sockopts);
+	if (err != ETR_OK)
+		return err;
+
+	ebpf_info("hot-path cycle profiler enabled (PROF build)\n");
+	return ETR_OK;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USER_PROFILER_H_
+#define _USER_PROFILER_H_
+#include <stdint.h>
+
+/*
+ * 编译期开关的热路径cycle剖析器。
+ *
+ * 整进程的perf采样对生产环境太重，这里只在流水线的阶段边界打点：
+ * perf ring读取、burst装配回调、ring入队、worker批处理。make PROF=1
+ * 时Makefile追加-DEBPF_PROF并编入user/profiler.o，打点用
+ * rdtsc/cntvct_el0取cycle差按线程累积，经SOCKOPT_GET_PROFILER_SHOW
+ * 导出（deepflow-ebpfctl tracer prof查看），SOCKOPT_SET_PROFILER_CLEAR
+ * 清零以便framing观测窗口。默认构建下PROF_*宏展开为空语句，
+ * 不产生任何代码。
+ */
+
+enum prof_stage {
+	PROF_STAGE_READER_READ,	// perf_reader_event_read()整体
+	PROF_STAGE_RAW_CB,	// reader_raw_cb()装配+分发
+	PROF_STAGE_ENQUEUE,	// ring入队
+	PROF_STAGE_PROCESS,	// prefetch_and_process_datas()批处理
+	PROF_STAGE_NUM,
+};
+
+struct prof_stage_stats {
+	uint64_t cycles;	// 累计cycle数
+	uint64_t calls;		// 打点次数
+};
+
+#define PROF_MAX_THREADS 128
+
+struct prof_thread_slot {
+	struct prof_stage_stats stages[PROF_STAGE_NUM];
+	int tid;
+	volatile int used;
+};
+
+// SOCKOPT_GET_PROFILER_SHOW的响应布局
+struct prof_params {
+	uint32_t threads_nr;
+	struct prof_thread_slot threads[0];
+};
+
+enum {
+	/* set */
+	SOCKOPT_SET_PROFILER_CLEAR = 600,
+
+	/* get */
+	SOCKOPT_GET_PROFILER_SHOW,
+};
+
+#ifdef EBPF_PROF
+
+static inline uint64_t prof_cycles(void)
+{
+#if defined(__x86_64__)
+	uint32_t lo, hi;
+	asm volatile ("rdtsc":"=a" (lo), "=d"(hi));
+	return ((uint64_t) hi << 32) | lo;
+#elif defined(__aarch64__)
+	uint64_t v;
+	asm volatile ("mrs %0, cntvct_el0":"=r" (v));
+	return v;
+#else
+	return 0;
+#endif
+}
+
+void prof_record(enum prof_stage stage, uint64_t cycles);
+int profiler_init(void);
+
+#define PROF_START(stage) uint64_t __prof_ts_##stage = prof_cycles()
+#define PROF_END(stage) prof_record(stage, prof_cycles() - __prof_ts_##stage)
+
+#else /* !EBPF_PROF */
+
+#define PROF_START(stage) do {} while (0)
+#define PROF_END(stage) do {} while (0)
+
+static inline int profiler_init(void)
+{
+	return 0;
+}
+
+#endif /* EBPF_PROF */
+#endif /* _USER_PROFILER_H_ */
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * 批量协议再确认。
+ *
+ * 内核侧基于长度头的推断（MySQL/Kafka）对任意二进制流有一定误判率，
+ * 这类事件在装配时标记need_reconfirm，worker出队后在这里对整个burst
+ * 做一次再确认：payload前16字节load进XMM寄存器，与协议签名表逐条
+ * cmpeq+movemask核对（与kernel/include/protocol_inference.h使用的
+ * 签名一致：HTTP方法/版本行、Redis RESP帧首字符类、MySQL小端3字节
+ * 长度头、Kafka大端4字节长度头）。命中其他协议则改写
+ * l7_protocal_hint，下发到上层时need_reconfirm恒为false，上层逻辑
+ * 不变。逐事件的分支扫描合并成对连续前缀的向量比较，检查从热路径
+ * 的process_fn里挪到了burst级的一次扫描。
+ *
+ * 配合per-worker的flow上下文表（flow_ctx.h）：连接首个事件冷匹配后
+ * 把结论记在上下文里，同一socket_id的后续事件直接复用；Kafka响应报
+ * 文无签名可查，用上下文中记录的未应答correlation-id核对。
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "common.h"
+#include "log.h"
+#include "tracer.h"
+#include "socket.h"
+#include "proto_reconfirm.h"
+
+/*
+ * 16字节文本签名。mask的低n位为1表示payload前n个字节须与pattern
+ * 相等，cmpeq结果的movemask按位与即可判定。
+ */
+struct proto_signature {
+	uint8_t pattern[16];
+	uint16_t mask;
+	uint16_t proto;
+};
+
+/* *INDENT-OFF* */
+static const struct proto_signature text_sigs[] = {
+	{ "GET ",     0x000f, PROTO_HTTP1 },
+	{ "POST ",    0x001f, PROTO_HTTP1 },
+	{ "PUT ",     0x000f, PROTO_HTTP1 },
+	{ "DELETE ",  0x007f, PROTO_HTTP1 },
+	{ "HEAD ",    0x001f, PROTO_HTTP1 },
+	{ "OPTIONS ", 0x00ff, PROTO_HTTP1 },
+	{ "PATCH ",   0x003f, PROTO_HTTP1 },
+	{ "HTTP/1.",  0x007f, PROTO_HTTP1 },
+};
+/* *INDENT-ON* */
+
+// Kafka api key的当前上限，超过视为非Kafka
+#define KAFKA_API_KEY_MAX 67
+
+static inline uint16_t classify_prefix(const uint8_t * p, uint32_t cap_len,
+				       uint64_t total_len)
+{
+	if (cap_len < 4)
+		return PROTO_UNKNOWN;
+
+	/*
+	 * 不足16字节时拷入零填充的栈上buffer再load，避免越过
+	 * payload末尾读内存。
+	 */
+	__m128i v;
+	uint8_t tmp[16];
+	if (cap_len >= 16) {
+		v = _mm_loadu_si128((const __m128i *)p);
+	} else {
+		memset(tmp, 0, sizeof(tmp));
+		memcpy(tmp, p, cap_len);
+		v = _mm_loadu_si128((const __m128i *)tmp);
+	}
+
+	uint32_t i;
+	for (i = 0; i < sizeof(text_sigs) / sizeof(text_sigs[0]); i++) {
+		__m128i s =
+		    _mm_loadu_si128((const __m128i *)text_sigs[i].pattern);
+		uint32_t eq =
+		    (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, s));
+		if ((eq & text_sigs[i].mask) == text_sigs[i].mask)
+			return text_sigs[i].proto;
+	}
+
+	// Redis RESP帧首字符类：* $ + - :
+	const __m128i resp_class = _mm_setr_epi8('*', '$', '+', '-', ':',
+						 0, 0, 0, 0, 0, 0, 0, 0, 0,
+						 0, 0);
+	__m128i first = _mm_set1_epi8((char)p[0]);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(first, resp_class)) & 0x1f)
+		return PROTO_REDIS;
+
+	// MySQL：3字节小端包长度 + 1字节序号，长度与本次syscall长度吻合
+	uint32_t mysql_len = (uint32_t) p[0] | (uint32_t) p[1] << 8 |
+	    (uint32_t) p[2] << 16;
+	if (mysql_len > 0 && p[3] < 3 &&
+	    (uint64_t) mysql_len + 4 == total_len)
+		return PROTO_MYSQL;
+
+	// Kafka：4字节大端帧长度吻合，且api key在已分配范围内
+	uint32_t kafka_len = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+	    (uint32_t) p[2] << 8 | (uint32_t) p[3];
+	if (kafka_len > 0 && (uint64_t) kafka_len + 4 == total_len &&
+	    cap_len >= 6 &&
+	    ((uint16_t) p[4] << 8 | p[5]) <= KAFKA_API_KEY_MAX)
+		return PROTO_KAFKA;
+
+	return PROTO_UNKNOWN;
+}
+
+void socket_burst_reconfirm(struct queue *q, void **burst, int nr)
+{
+	int i;
+	struct socket_bpf_data *sd;
+	struct mem_block_head *bh;
+	uint64_t checked = 0, rewritten = 0;
+
+	// 先把待查payload的前缀预取进cache，再做批量比较
+	for (i = 0; i < nr; i++) {
+		sd = (struct socket_bpf_data *)burst[i];
+		bh = (struct mem_block_head *)sd - 1;
+		if (bh->fn != NULL)	// 注册事件，无payload
+			continue;
+		if (sd->need_reconfirm && sd->cap_len >= 4)
+			prefetch0(sd->cap_data);
+	}
+
+	for (i = 0; i < nr; i++) {
+		sd = (struct socket_bpf_data *)burst[i];
+		bh = (struct mem_block_head *)sd - 1;
+		if (bh->fn != NULL || !sd->need_reconfirm)
+			continue;
+
+		checked++;
+		const uint8_t *p = (uint8_t *) sd->cap_data;
+
+		/*
+		 * flow分发把同一socket_id钉在本worker上，已确认过的连
+		 * 接直接复用上下文里的结论，免去每事件的冷匹配。
+		 */
+		struct flow_ctx_entry *fe =
+		    flow_ctx_lookup(&q->flow_ctx, sd->socket_id);
+		if (fe != NULL && fe->l7_proto != PROTO_UNKNOWN) {
+			if (fe->l7_proto != sd->l7_protocal_hint) {
+				sd->l7_protocal_hint = fe->l7_proto;
+				rewritten++;
+			}
+			if (fe->l7_proto == PROTO_MYSQL && sd->cap_len >= 4)
+				fe->mysql_seq = p[3] + 1;
+			sd->need_reconfirm = false;
+			continue;
+		}
+
+		uint16_t proto = classify_prefix(p, sd->cap_len,
+						 sd->syscall_len);
+
+		/*
+		 * 长度头+api key的签名只覆盖Kafka请求；响应用上下文里
+		 * 记录的未应答correlation-id确认。
+		 */
+		if (proto == PROTO_UNKNOWN && fe != NULL &&
+		    fe->kafka_corr_nr > 0 && sd->cap_len >= 8) {
+			uint32_t corr = (uint32_t) p[4] << 24 |
+			    (uint32_t) p[5] << 16 |
+			    (uint32_t) p[6] << 8 | (uint32_t) p[7];
+			uint8_t k;
+			for (k = 0; k < FLOW_CTX_KAFKA_CORR_NR; k++) {
+				if (fe->kafka_corr[k] == corr) {
+					proto = PROTO_KAFKA;
+					break;
+				}
+			}
+		}
+
+		if (proto != PROTO_UNKNOWN) {
+			if (proto != sd->l7_protocal_hint) {
+				sd->l7_protocal_hint = proto;
+				rewritten++;
+			}
+
+			if (fe != NULL) {
+				fe->l7_proto = proto;
+				if (proto == PROTO_MYSQL && sd->cap_len >= 4)
+					fe->mysql_seq = p[3] + 1;
+				// 确认的Kafka请求记下correlation-id待响应核对
+				if (proto == PROTO_KAFKA && sd->cap_len >= 12) {
+					fe->kafka_corr[fe->kafka_corr_nr %
+						       FLOW_CTX_KAFKA_CORR_NR] =
+					    (uint32_t) p[8] << 24 |
+					    (uint32_t) p[9] << 16 |
+					    (uint32_t) p[10] << 8 |
+					    (uint32_t) p[11];
+					fe->kafka_corr_nr++;
+				}
+			}
+		}
+
+		// 未命中签名时保留内核的推断结果，不再要求上层确认
+		sd->need_reconfirm = false;
+	}
+
+	if (checked)
+		atomic64_add(&q->reconfirm_nr, checked);
+	if (rewritten)
+		atomic64_add(&q->reconfirm_rewrite_nr, rewritten);
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USER_PROTO_RECONFIRM_H_
+#define _USER_PROTO_RECONFIRM_H_
+
+struct queue;
+
+// 批量协议再确认阶段，挂到bpf_tracer->burst_reconfirm_fn
+void socket_burst_reconfirm(struct queue *q, void **burst, int nr);
+
+#endif /* _USER_PROTO_RECONFIRM_H_ */
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "common.h"
+#include "log.h"
+#include "record.h"
+
+volatile bool record_active;
+
+/*
+ * 录制状态。offset用原子方式预留空间，percpu读取模式下多个读取
+ * 线程可能同时append。文件预先ftruncate到max_bytes并整体mmap，
+ * 写满即停止接收（丢帧计数告警），record_stop()时裁剪到实际长度。
+ */
+static struct {
+	uint8_t *base;
+	uint64_t cap;
+	volatile uint64_t offset;
+	volatile uint64_t frames;
+	volatile uint64_t dropped;
+	int fd;
+} record_st;
+
+// 帧长度8字节对齐，保证frame header的对齐访问
+#define RECORD_ALIGN(x) (((x) + 7) & ~7ULL)
+
+int record_start(const char *path, uint64_t max_bytes)
+{
+	if (record_active)
+		return ETR_BUSY;
+
+	if (path == NULL || max_bytes <= sizeof(struct record_file_header))
+		return ETR_INVAL;
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		ebpf_warning("[%s] open() %s failed, %s\n", __func__, path,
+			     strerror(errno));
+		return ETR_SYSCALL;
+	}
+
+	if (ftruncate(fd, max_bytes) != 0) {
+		ebpf_warning("[%s] ftruncate() failed, %s\n", __func__,
+			     strerror(errno));
+		close(fd);
+		return ETR_SYSCALL;
+	}
+
+	uint8_t *base = mmap(NULL, max_bytes, PROT_READ | PROT_WRITE,
+			     MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		ebpf_warning("[%s] mmap() failed, %s\n", __func__,
+			     strerror(errno));
+		close(fd);
+		return ETR_SYSCALL;
+	}
+
+	struct record_file_header *hdr = (struct record_file_header *)base;
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = RECORD_FILE_MAGIC;
+	hdr->version = RECORD_FILE_VERSION;
+
+	record_st.base = base;
+	record_st.cap = max_bytes;
+	record_st.offset = sizeof(*hdr);
+	record_st.frames = 0;
+	record_st.dropped = 0;
+	record_st.fd = fd;
+
+	__sync_synchronize();
+	record_active = true;
+
+	ebpf_info("record started, file:%s max_bytes:%" PRIu64 "\n",
+		  path, max_bytes);
+	return ETR_OK;
+}
+
+void record_append(void *raw, int raw_size)
+{
+	if (!record_active || raw_size <= 0)
+		return;
+
+	uint64_t need =
+	    RECORD_ALIGN(sizeof(struct record_frame_header) + raw_size);
+	uint64_t off = __sync_fetch_and_add(&record_st.offset, need);
+	if (off + need > record_st.cap) {
+		// 文件写满，回退预留并丢帧
+		__sync_fetch_and_sub(&record_st.offset, need);
+		__sync_fetch_and_add(&record_st.dropped, 1);
+		return;
+	}
+
+	struct record_frame_header *fh =
+	    (struct record_frame_header *)(record_st.base + off);
+	fh->ts_ns = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+	fh->size = raw_size;
+	fh->__pad = 0;
+	memcpy(fh + 1, raw, raw_size);
+
+	__sync_fetch_and_add(&record_st.frames, 1);
+}
+
+int record_stop(void)
+{
+	if (!record_active)
+		return ETR_IDLE;
+
+	record_active = false;
+	__sync_synchronize();
+
+	struct record_file_header *hdr =
+	    (struct record_file_header *)record_st.base;
+	hdr->frames = record_st.frames;
+
+	uint64_t used = record_st.offset;
+	msync(record_st.base, used, MS_SYNC);
+	munmap(record_st.base, record_st.cap);
+	if (ftruncate(record_st.fd, used) != 0)
+		ebpf_warning("[%s] ftruncate() failed, %s\n", __func__,
+			     strerror(errno));
+	close(record_st.fd);
+
+	ebpf_info("record stopped, frames:%" PRIu64 " bytes:%" PRIu64
+		  " dropped:%" PRIu64 "\n", record_st.frames, used,
+		  record_st.dropped);
+
+	memset((void *)&record_st, 0, sizeof(record_st));
+	return ETR_OK;
+}
+
+int64_t record_replay(const char *path, double speed,
+		      record_replay_cb cb, void *ctx)
+{
+	if (path == NULL || cb == NULL)
+		return ETR_INVAL;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		ebpf_warning("[%s] open() %s failed, %s\n", __func__, path,
+			     strerror(errno));
+		return ETR_SYSCALL;
+	}
+
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 ||
+	    sb.st_size < sizeof(struct record_file_header)) {
+		close(fd);
+		return ETR_INVAL;
+	}
+
+	uint8_t *base = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		ebpf_warning("[%s] mmap() failed, %s\n", __func__,
+			     strerror(errno));
+		close(fd);
+		return ETR_SYSCALL;
+	}
+
+	struct record_file_header *hdr = (struct record_file_header *)base;
+	if (hdr->magic != RECORD_FILE_MAGIC ||
+	    hdr->version != RECORD_FILE_VERSION) {
+		ebpf_warning("[%s] %s is not a record file.\n", __func__,
+			     path);
+		munmap(base, sb.st_size);
+		close(fd);
+		return ETR_INVAL;
+	}
+
+	uint64_t off = sizeof(*hdr);
+	uint64_t first_ts = 0, replay_base = 0;
+	int64_t replayed = 0;
+
+	while (off + sizeof(struct record_frame_header) <= (uint64_t) sb.st_size) {
+		struct record_frame_header *fh =
+		    (struct record_frame_header *)(base + off);
+		if (fh->size == 0 ||
+		    off + sizeof(*fh) + fh->size > (uint64_t) sb.st_size)
+			break;
+
+		if (speed > 0) {
+			// 按录制的帧间隔pacing，speed为加速倍数
+			if (replayed == 0) {
+				first_ts = fh->ts_ns;
+				replay_base =
+				    gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+			} else {
+				uint64_t due = replay_base +
+				    (uint64_t) ((fh->ts_ns - first_ts) / speed);
+				uint64_t now =
+				    gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+				if (due > now)
+					usleep((due - now) / 1000);
+			}
+		}
+
+		cb(ctx, fh + 1, fh->size);
+		replayed++;
+		off += RECORD_ALIGN(sizeof(*fh) + fh->size);
+	}
+
+	munmap(base, sb.st_size);
+	close(fd);
+
+	ebpf_info("replay done, file:%s frames:%" PRId64 " speed:%.2f\n",
+		  path, replayed, speed);
+	return replayed;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USER_RECORD_H_
+#define _USER_RECORD_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * perf记录的录制与回放。
+ *
+ * 录制把交给reader_raw_cb()的原始字节流按帧追加到mmap的文件里，
+ * 回放把文件按录制时刻（或加速）重新灌回同样的回调，让dispatch/
+ * 分配器/协议路径的改动可以离线对着真实流量形态做benchmark，也
+ * 便于复现客户现场的吞吐问题。
+ *
+ * 文件格式：record_file_header后跟若干帧，每帧为
+ * record_frame_header + payload，8字节对齐。
+ */
+
+#define RECORD_FILE_MAGIC	0x44524f4345524644ULL	/* "DFRECORD" */
+#define RECORD_FILE_VERSION	1
+
+struct record_file_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t __pad;
+	uint64_t frames;	// 总帧数，record_stop()时回填
+} __attribute__ ((packed));
+
+struct record_frame_header {
+	uint64_t ts_ns;		// 捕获时刻（CLOCK_MONOTONIC）
+	uint32_t size;		// payload字节数
+	uint32_t __pad;
+} __attribute__ ((packed));
+
+// SOCKOPT_SET_SOCKTRACE_RECORD的参数（deepflow-ebpfctl socktrace record）
+struct record_conf_t {
+	bool on;		// true开始录制，false停止
+	uint64_t max_bytes;	// 录制文件大小上限（含文件头）
+	char path[256];
+};
+
+// 热路径开关，为true时reader_raw_cb()调用record_append()
+extern volatile bool record_active;
+
+int record_start(const char *path, uint64_t max_bytes);
+int record_stop(void);
+void record_append(void *raw, int raw_size);
+
+typedef void (*record_replay_cb) (void *ctx, void *raw, int raw_size);
+/*
+ * speed <= 0表示全速回放，1.0为录制速度，N为N倍速。
+ * 返回回放的帧数，失败返回负的ETR_*错误码。
+ */
+int64_t record_replay(const char *path, double speed,
+		      record_replay_cb cb, void *ctx);
+#endif /*_USER_RECORD_H_ */
@@ -72,6 +72,7 @@
 #include <sys/queue.h>
 
 #include "ring.h"
+#include "mem.h"
 #include "log.h"
 
 #define MAX_TAILQ 64
@@ -192,15 +193,24 @@ struct ring *ring_create(const char *name, unsigned count,
 		return NULL;
 	}
 
-	/* reserve a memory zone for this ring. If we can't get config or
-	 * we are secondary process, the memzone_reserve function will set
-	 * errno for us appropriately - hence no check in this this function */
-	r = calloc(ring_size, 1);
+	/*
+	 * Large rings are hugepage-backed when the allocator is enabled
+	 * (mem_alloc_pages() only kicks in from MEM_HUGE_PAGE_SIZE up);
+	 * with an explicit socket_id the ring additionally gets bound to
+	 * that NUMA node (page-aligned mmap even for small rings). The
+	 * mmap'ed memory is already zeroed, matching the calloc() path.
+	 */
+	size_t mz_len = 0;
+	r = mem_alloc_pages_node(ring_size, &mz_len, socket_id);
+	if (r == NULL) {
+		r = calloc(ring_size, 1);
+		mz_len = 0;
+	}
 	if (r != NULL) {
 		/* no need to check return value here, we already checked the
 		 * arguments above */
 		ring_init(r, name, requested_count, flags);
-
+		r->mz_len = mz_len;
 	} else {
 		r = NULL;
 		ebpf_info("Cannot reserve memory\n");
@@ -215,6 +225,11 @@ void ring_free(struct ring *r)
 	if (r == NULL)
 		return;
 
+	if (r->mz_len) {
+		mem_free_pages(r, r->mz_len);
+		return;
+	}
+
 	free(r);
 }
 
@@ -195,6 +195,7 @@ struct ring {
 	uint32_t size;		 /**< Size of ring. */
 	uint32_t mask;		 /**< Mask (size-1) of ring. */
 	uint32_t capacity;	 /**< Usable size of ring */
+	uint32_t mz_len;	 /**< Hugepage mapping length, 0 if heap */
 
 	/** Ring producer status. */
 	struct ring_headtail prod __aligned(PROD_ALIGN);
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "log.h"
+#include "tracer.h"
+#include "shm_stats.h"
+
+static struct shm_stats_segment *stats_seg;
+// tracer记录可能从多个perf reader线程发布，忙时直接跳过本次发布
+static volatile int tracer_pub_lock;
+
+int shm_stats_create(int queues_nr)
+{
+	if (queues_nr <= 0 || queues_nr > MAX_CPU_NR)
+		return ETR_INVAL;
+
+	int fd = open(SHM_STATS_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		ebpf_warning("[%s] open() %s failed, %s\n", __func__,
+			     SHM_STATS_PATH, strerror(errno));
+		return ETR_SYSCALL;
+	}
+
+	if (ftruncate(fd, sizeof(struct shm_stats_segment)) != 0) {
+		ebpf_warning("[%s] ftruncate() failed, %s\n", __func__,
+			     strerror(errno));
+		close(fd);
+		return ETR_SYSCALL;
+	}
+
+	struct shm_stats_segment *seg =
+	    mmap(NULL, sizeof(*seg), PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		 0);
+	close(fd);
+	if (seg == MAP_FAILED) {
+		ebpf_warning("[%s] mmap() failed, %s\n", __func__,
+			     strerror(errno));
+		return ETR_SYSCALL;
+	}
+
+	memset(seg, 0, sizeof(*seg));
+	seg->version = SHM_STATS_VERSION;
+	seg->queues_nr = queues_nr;
+	// magic最后写入，读方看到magic即可认为布局已就绪
+	__sync_synchronize();
+	seg->magic = SHM_STATS_MAGIC;
+
+	stats_seg = seg;
+	ebpf_info("shm stats segment created, file:%s queues:%d\n",
+		  SHM_STATS_PATH, queues_nr);
+	return ETR_OK;
+}
+
+struct shm_stats_segment *shm_stats_attach(void)
+{
+	int fd = open(SHM_STATS_PATH, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 ||
+	    sb.st_size < sizeof(struct shm_stats_segment)) {
+		close(fd);
+		return NULL;
+	}
+
+	struct shm_stats_segment *seg =
+	    mmap(NULL, sizeof(*seg), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (seg == MAP_FAILED)
+		return NULL;
+
+	if (seg->magic != SHM_STATS_MAGIC ||
+	    seg->version != SHM_STATS_VERSION) {
+		munmap(seg, sizeof(*seg));
+		return NULL;
+	}
+
+	return seg;
+}
+
+/*
+ * 发布一条队列记录。调用方持有q->consume_lock（同一时刻单写方），
+ * 计数器本身是原子的，任意线程读取都安全。
+ */
+void shm_queue_stats_publish(struct queue *q)
+{
+	if (stats_seg == NULL)
+		return;
+
+	int idx = q - q->t->queues;
+	struct shm_queue_stats *s = &stats_seg->queues[idx];
+
+	s->seq++;
+	__sync_synchronize();
+	s->enqueue_nr = atomic64_read(&q->enqueue_nr);
+	s->enqueue_lost = atomic64_read(&q->enqueue_lost);
+	s->dequeue_nr = atomic64_read(&q->dequeue_nr);
+	s->burst_count = atomic64_read(&q->burst_count);
+	s->heap_get_faild = atomic64_read(&q->heap_get_faild);
+	s->stolen_nr = atomic64_read(&q->stolen_nr);
+	s->reconfirm_nr = atomic64_read(&q->reconfirm_nr);
+	s->reconfirm_rewrite_nr = atomic64_read(&q->reconfirm_rewrite_nr);
+	__sync_synchronize();
+	s->seq++;
+}
+
+void shm_tracer_stats_publish(struct bpf_tracer *t)
+{
+	if (stats_seg == NULL)
+		return;
+
+	if (__sync_lock_test_and_set(&tracer_pub_lock, 1))
+		return;
+
+	struct shm_tracer_stats *s = &stats_seg->tracer;
+	int i;
+
+	s->seq++;
+	__sync_synchronize();
+	s->lost = atomic64_read(&t->lost);
+	// 分协议统计按per-queue分片存放，读取时求和
+	int qi;
+	for (i = 0; i < PROTO_NUM; i++) {
+		uint64_t sum = 0;
+		for (qi = 0; qi < t->dispatch_workers_nr; qi++)
+			sum += atomic64_read(&t->queues[qi].proto_status[i]);
+		s->proto_status[i] = sum;
+	}
+	__sync_synchronize();
+	s->seq++;
+
+	__sync_lock_release(&tracer_pub_lock);
+}
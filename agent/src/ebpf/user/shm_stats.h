@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2022 Yunshan Networks
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USER_SHM_STATS_H_
+#define _USER_SHM_STATS_H_
+#include <stdint.h>
+
+/*
+ * 共享内存统计通道。热点计数器（队列入队/出队、内核丢失、协议分布）
+ * 通过mmap的共享文件以seqlock方式发布，监控端（deepflow-ebpfctl、
+ * Rust agent）任意频率读取都不产生syscall，也不在数据路径上引入任何
+ * 竞争；低频的完整快照仍走sockopt通道。
+ *
+ * 每条记录独占cache line（发布线程间无伪共享）。写方：seq加到奇数、
+ * 写数据、seq再加到偶数；读方：seq为奇数或前后两次seq不一致则重读。
+ */
+
+#define SHM_STATS_PATH		"/var/run/deepflow_bpf_stats"
+#define SHM_STATS_MAGIC		0x53544154534644ULL	/* "DFSTATS" */
+#define SHM_STATS_VERSION	2
+
+struct shm_queue_stats {
+	uint32_t seq;
+	uint32_t __pad;
+	uint64_t enqueue_nr;
+	uint64_t enqueue_lost;
+	uint64_t dequeue_nr;
+	uint64_t burst_count;
+	uint64_t heap_get_faild;
+	uint64_t stolen_nr;
+	uint64_t reconfirm_nr;	// 批量协议再确认检查的事件数
+	uint64_t reconfirm_rewrite_nr;	// 再确认改写协议的事件数
+} __attribute__ ((aligned(64)));
+
+struct shm_tracer_stats {
+	uint32_t seq;
+	uint32_t __pad;
+	uint64_t lost;		// perf buffer内核侧丢失的事件数
+	uint64_t proto_status[PROTO_NUM];
+} __attribute__ ((aligned(64)));
+
+struct shm_stats_segment {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t queues_nr;
+	struct shm_tracer_stats tracer;
+	struct shm_queue_stats queues[MAX_CPU_NR];
+} __attribute__ ((aligned(64)));
+
+// tracer进程：创建（或重建）segment并mmap，失败返回ETR_*
+int shm_stats_create(int queues_nr);
+// 监控端：只读attach，失败返回NULL
+struct shm_stats_segment *shm_stats_attach(void);
+
+struct queue;
+struct bpf_tracer;
+void shm_queue_stats_publish(struct queue *q);
+void shm_tracer_stats_publish(struct bpf_tracer *t);
+
+// seqlock读取一条队列记录，读到一致快照为止
+static inline void
+shm_stats_read_queue(struct shm_stats_segment *seg, int idx,
+		     struct shm_queue_stats *out)
+{
+	struct shm_queue_stats *s = &seg->queues[idx];
+	uint32_t s1, s2;
+	do {
+		s1 = s->seq;
+		__sync_synchronize();
+		*out = *s;
+		__sync_synchronize();
+		s2 = s->seq;
+	} while ((s1 & 1) || s1 != s2);
+}
+
+static inline void
+shm_stats_read_tracer(struct shm_stats_segment *seg,
+		      struct shm_tracer_stats *out)
+{
+	struct shm_tracer_stats *s = &seg->tracer;
+	uint32_t s1, s2;
+	do {
+		s1 = s->seq;
+		__sync_synchronize();
+		*out = *s;
+		__sync_synchronize();
+		s2 = s->seq;
+	} while ((s1 & 1) || s1 != s2);
+}
+#endif /* _USER_SHM_STATS_H_ */
@@ -19,6 +19,8 @@
 #include "libbpf/include/linux/err.h"
 #include <sched.h>
 #include <sys/prctl.h>
+#include <sys/utsname.h>
+#include <fcntl.h>
 #include "symbol.h"
 #include "tracer.h"
 #include "probe.h"
@@ -27,10 +29,15 @@
 #include "socket.h"
 #include "log.h"
 #include "go_tracer.h"
+#include "record.h"
+#include "shm_stats.h"
+#include "proto_reconfirm.h"
+#include "profiler.h"
 
 #include "socket_trace_bpf_common.c"
 #include "socket_trace_bpf_5_2.c"
 #include "socket_trace_bpf_core.c"
+#include "socket_trace_bpf_core_rb.c"
 
 // eBPF Map Name
 #define MAP_MEMBERS_OFFSET_NAME		"__members_offset"
@@ -39,6 +46,9 @@
 #define MAP_PERF_SOCKET_DATA_NAME	"__socket_data"
 #define MAP_TRACE_UID_NAME		"__trace_uid_map"
 #define MAP_TRACE_STATS_NAME		"__trace_stats_map"
+#define MAP_TRACE_FILTER_NAME		"__trace_filter_map"
+#define MAP_FILTER_PID_NAME		"__filter_pid_map"
+#define MAP_SAMPLE_RATE_NAME		"__sample_rate_map"
 
 // 在socket map回收时，对每条socket信息超过10秒没有收发动作就回收掉
 #define SOCKET_RECLAIM_TIMEOUT_DEF  10
@@ -61,6 +71,9 @@ static uint32_t conf_max_trace_entries;
 // socket map 进行回收的最大阈值，超过这个值进行map回收。
 static uint32_t conf_socket_map_max_reclaim;
 
+// burst级回调，见register_socket_data_burst_handle()
+static l7_handle_burst_fn socket_data_burst_handle;
+
 extern int major, minor;
 
 extern uint64_t sys_boot_time_ns;
@@ -69,61 +82,108 @@ extern uint64_t prev_sys_boot_time_ns;
 static bool bpf_stats_map_collect(struct bpf_tracer *tracer,
 				  struct trace_stats *stats_total);
 static bool is_adapt_success(struct bpf_tracer *t);
+static int update_offsets_table(struct bpf_tracer *t,
+				struct bpf_offset_param *offset);
 static int socket_tracer_stop(void);
 static int socket_tracer_start(void);
 
-static void socket_tracer_set_probes(struct tracer_probes_conf *tps)
-{
-	int index = 0, curr_idx;
-
-	probes_set_enter_symbol(tps, "__sys_sendmsg");
-	probes_set_enter_symbol(tps, "__sys_sendmmsg");
-	probes_set_enter_symbol(tps, "__sys_recvmsg");
-	probes_set_enter_symbol(tps, "__sys_recvmmsg");
-	probes_set_enter_symbol(tps, "do_writev");
-	probes_set_enter_symbol(tps, "do_readv");
-	tps->kprobes_nr = index;
-
-	/* tracepoints */
-	index = 0;
+// 当前已附着/已注册过的探针能力组（enum socket_trace_caps位掩码）
+static uint32_t tracer_caps;
+static uint32_t tracer_caps_loaded;
 
-	/*
-	 * 由于在Linux 4.17+ sys_write, sys_read, sys_sendto, sys_recvfrom
-	 * 接口会发生变化为了避免对内核的依赖采用tracepoints方式
-	 */
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_enter_write");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_enter_read");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_enter_sendto");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_enter_recvfrom");
-
-	// exit tracepoints
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_socket");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_read");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_write");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_sendto");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_recvfrom");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_sendmsg");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_sendmmsg");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_recvmsg");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_recvmmsg");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_writev");
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_exit_readv");
-	// process execute
-	tps_set_symbol(tps, "tracepoint/sched/sched_process_exec");
+#define CAP_SYMS_NUM(a)	((int)(sizeof(a) / sizeof((a)[0])))
 
+/*
+ * 探针能力组的符号表，按组选择性注册/附着（见socket.h中
+ * enum socket_trace_caps说明）。
+ *
+ * 由于在Linux 4.17+ sys_write, sys_read, sys_sendto, sys_recvfrom
+ * 接口会发生变化为了避免对内核的依赖采用tracepoints方式。
+ */
+static const char *base_io_tps[] = {
+	"tracepoint/syscalls/sys_enter_write",
+	"tracepoint/syscalls/sys_enter_read",
+	"tracepoint/syscalls/sys_enter_sendto",
+	"tracepoint/syscalls/sys_enter_recvfrom",
+	"tracepoint/syscalls/sys_exit_socket",
+	"tracepoint/syscalls/sys_exit_read",
+	"tracepoint/syscalls/sys_exit_write",
+	"tracepoint/syscalls/sys_exit_sendto",
+	"tracepoint/syscalls/sys_exit_recvfrom",
 	// 周期性触发用于缓存的数据的超时检查
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_enter_getppid");
-
+	"tracepoint/syscalls/sys_enter_getppid",
 	// clear trace connection
-	tps_set_symbol(tps, "tracepoint/syscalls/sys_enter_close");
+	"tracepoint/syscalls/sys_enter_close",
+};
+
+static const char *msg_io_kprobes[] = {
+	"__sys_sendmsg",
+	"__sys_sendmmsg",
+	"__sys_recvmsg",
+	"__sys_recvmmsg",
+	"do_writev",
+	"do_readv",
+};
+
+static const char *msg_io_tps[] = {
+	"tracepoint/syscalls/sys_exit_sendmsg",
+	"tracepoint/syscalls/sys_exit_sendmmsg",
+	"tracepoint/syscalls/sys_exit_recvmsg",
+	"tracepoint/syscalls/sys_exit_recvmmsg",
+	"tracepoint/syscalls/sys_exit_writev",
+	"tracepoint/syscalls/sys_exit_readv",
+};
 
-	// Used for process offsets management
-	tps_set_symbol(tps, "tracepoint/sched/sched_process_exit");
+// process execute/exit, used for process offsets management
+static const char *proc_event_tps[] = {
+	"tracepoint/sched/sched_process_exec",
+	"tracepoint/sched/sched_process_exit",
+};
 
+static void socket_tracer_set_probes(struct tracer_probes_conf *tps,
+				     uint32_t caps)
+{
+	int index, curr_idx, i;
+
+	index = tps->kprobes_nr;
+	if (caps & TRACE_CAP_MSG_IO) {
+		for (i = 0; i < CAP_SYMS_NUM(msg_io_kprobes); i++)
+			probes_set_enter_symbol(tps, msg_io_kprobes[i]);
+	}
+	tps->kprobes_nr = index;
+
+	/* tracepoints */
+	index = tps->tps_nr;
+	if (caps & TRACE_CAP_BASE_IO) {
+		for (i = 0; i < CAP_SYMS_NUM(base_io_tps); i++)
+			tps_set_symbol(tps, base_io_tps[i]);
+	}
+
+	if (caps & TRACE_CAP_MSG_IO) {
+		for (i = 0; i < CAP_SYMS_NUM(msg_io_tps); i++)
+			tps_set_symbol(tps, msg_io_tps[i]);
+	}
+
+	if (caps & TRACE_CAP_PROC_EVENTS) {
+		for (i = 0; i < CAP_SYMS_NUM(proc_event_tps); i++)
+			tps_set_symbol(tps, proc_event_tps[i]);
+	}
 	tps->tps_nr = index;
 
-	// 收集go可执行文件uprobe符号信息
-	collect_uprobe_syms_from_procfs(tps);
+	/*
+	 * go可执行文件的uprobe符号收集（procfs扫描 + ELF解析）不在
+	 * 这里进行：启动路径放在独立线程与BPF字节码加载并行（见
+	 * running_socket_tracer()），运行时增量开启由
+	 * socket_tracer_update_caps()同步收集。
+	 */
+}
+
+// 与BPF字节码加载并行的go uprobe符号扫描线程入口
+static void *uprobe_syms_collect_worker(void *arg)
+{
+	prctl(PR_SET_NAME, "uprobe-scan");
+	collect_uprobe_syms_from_procfs((struct tracer_probes_conf *)arg);
+	return NULL;
 }
 
 /* ==========================================================
@@ -256,9 +316,88 @@ static int kernel_offset_infer_init(void)
 	return ETR_OK;
 }
 
+/*
+ * 内核数据过滤配置。
+ * SOCKOPT_SET_SOCKTRACE_SET：下发struct trace_filter_t整体配置；
+ * SOCKOPT_SET_SOCKTRACE_ADD/DEL：向pid过滤表添加/删除pid（u32数组）；
+ * SOCKOPT_SET_SOCKTRACE_FLUSH：清空过滤配置和pid过滤表；
+ * SOCKOPT_SET_SOCKTRACE_SNAPLEN：按协议下发捕获截断长度
+ * （struct proto_snaplen_t数组）。
+ */
 static int socktrace_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
 {
-	return 0;
+	struct bpf_tracer *t = find_bpf_tracer(SK_TRACER_NAME);
+	if (t == NULL)
+		return ETR_NOTEXIST;
+
+	struct trace_filter_t filter;
+	uint32_t *pids = (uint32_t *) conf;
+	uint32_t i, count, val = 1;
+
+	switch (opt) {
+	case SOCKOPT_SET_SOCKTRACE_SET:
+		if (size != sizeof(filter))
+			return ETR_INVAL;
+		if (!bpf_table_set_value(t, MAP_TRACE_FILTER_NAME, 0,
+					 (void *)conf))
+			return ETR_SYSCALL;
+		break;
+	case SOCKOPT_SET_SOCKTRACE_ADD:
+	case SOCKOPT_SET_SOCKTRACE_DEL:
+		if (size == 0 || size % sizeof(uint32_t) != 0)
+			return ETR_INVAL;
+		count = size / sizeof(uint32_t);
+		for (i = 0; i < count; i++) {
+			if (opt == SOCKOPT_SET_SOCKTRACE_ADD) {
+				if (!bpf_table_set_value(t, MAP_FILTER_PID_NAME,
+							 pids[i], &val))
+					return ETR_SYSCALL;
+			} else {
+				bpf_table_delete_key(t, MAP_FILTER_PID_NAME,
+						     pids[i]);
+			}
+		}
+		break;
+	case SOCKOPT_SET_SOCKTRACE_FLUSH:
+		memset(&filter, 0, sizeof(filter));
+		if (!bpf_table_set_value(t, MAP_TRACE_FILTER_NAME, 0, &filter))
+			return ETR_SYSCALL;
+		bpf_table_clear(t, MAP_FILTER_PID_NAME);
+		break;
+	case SOCKOPT_SET_SOCKTRACE_SNAPLEN: {
+		const struct proto_snaplen_t *sl = conf;
+		if (size == 0 || size % sizeof(*sl) != 0)
+			return ETR_INVAL;
+		// 读-改-写保留已有的过滤配置
+		if (!bpf_table_get_value(t, MAP_TRACE_FILTER_NAME, 0, &filter))
+			return ETR_SYSCALL;
+		count = size / sizeof(*sl);
+		for (i = 0; i < count; i++) {
+			if (sl[i].proto >= PROTO_NUM)
+				return ETR_INVAL;
+			filter.proto_snaplen[sl[i].proto] = sl[i].snap_len;
+		}
+		if (!bpf_table_set_value(t, MAP_TRACE_FILTER_NAME, 0, &filter))
+			return ETR_SYSCALL;
+		break;
+	}
+	case SOCKOPT_SET_SOCKTRACE_RECORD: {
+		const struct record_conf_t *rc = conf;
+		char path[sizeof(rc->path)];
+		if (size != sizeof(*rc))
+			return ETR_INVAL;
+		if (!rc->on)
+			return record_stop();
+		// 确保NUL结尾，不信任客户端传来的内容
+		memcpy(path, rc->path, sizeof(path));
+		path[sizeof(path) - 1] = '\0';
+		return record_start(path, rc->max_bytes);
+	}
+	default:
+		return ETR_INVAL;
+	}
+
+	return ETR_OK;
 }
 
 static bool bpf_offset_map_collect(struct bpf_tracer *tracer,
@@ -310,6 +449,29 @@ static int socktrace_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
 		params->kern_trace_map_used = stats_total.trace_map_count;
 	}
 
+	// 各分发队列的分阶段时延直方图汇总后输出
+	int qi, s, b;
+	for (qi = 0; qi < t->dispatch_workers_nr; qi++) {
+		for (s = 0; s < LAT_STAGE_NUM; s++) {
+			struct latency_hist *h = &t->queues[qi].lat_hists[s];
+			struct stage_latency_stats *out_s =
+			    &params->latency_stats[s];
+			out_s->count += atomic64_read(&h->count);
+			out_s->sum_ns += atomic64_read(&h->sum_ns);
+			for (b = 0; b < LATENCY_HIST_BUCKETS; b++)
+				out_s->buckets[b] +=
+				    atomic64_read(&h->buckets[b]);
+		}
+	}
+
+	// BPF程序运行时开销，周期线程采样更新，此处只做快照拷贝
+	int pi, nr = t->prog_stats_nr;
+	if (nr > PROG_RT_STATS_MAX)
+		nr = PROG_RT_STATS_MAX;
+	for (pi = 0; pi < nr; pi++)
+		params->prog_stats[pi] = t->prog_stats[pi];
+	params->prog_stats_nr = nr;
+
 	if (!bpf_offset_map_collect(t, array)) {
 		free(*out);
 		return -1;
@@ -321,19 +483,22 @@ static int socktrace_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
 static struct tracer_sockopts socktrace_sockopts = {
 	.version = SOCKOPT_VERSION,
 	.set_opt_min = SOCKOPT_SET_SOCKTRACE_ADD,
-	.set_opt_max = SOCKOPT_SET_SOCKTRACE_FLUSH,
+	.set_opt_max = SOCKOPT_SET_SOCKTRACE_RECORD,
 	.set = socktrace_sockopt_set,
 	.get_opt_min = SOCKOPT_GET_SOCKTRACE_SHOW,
 	.get_opt_max = SOCKOPT_GET_SOCKTRACE_SHOW,
 	.get = socktrace_sockopt_get,
 };
 
-// TODO : 标记上层是否需要重新确认协议准确性
-// 目前上层没有实现协议再次确认的功能,对需要重新确认的包直接丢弃,这里临时设置数据包不需要重新确认
-// 上层实现重新确认功能后再使用
+/*
+ * 标记需要在用户态再确认协议准确性的事件。内核侧基于长度头推断的
+ * MySQL/Kafka误判率较高，交给分发worker的批量再确认阶段
+ * （proto_reconfirm.c）用SIMD签名核对；确认/改写后下发到上层时
+ * need_reconfirm恒为false，上层行为不变。
+ */
 static inline bool need_proto_reconfirm(uint16_t l7_proto)
 {
-	return false;
+	return l7_proto == PROTO_MYSQL || l7_proto == PROTO_KAFKA;
 }
 
 static void process_event(struct process_event_t *e)
@@ -349,6 +514,105 @@ static inline int dispatch_queue_index(uint64_t val, int count)
 	return xxhash(val) % count;
 }
 
+/*
+ * flow分发表：xxhash(五元组) -> 队列的粘性映射。flow首次出现（或空
+ * 闲超过DISPATCH_IDLE_RESEED_NS后再次出现）时用two-choices在两个候
+ * 选队列里选积压少的（ring_count()），之后保持不变以维持per-flow有
+ * 序。顺序分配的socket_id不再直接决定队列，单个深队列也能被绕开。
+ *
+ * 槽位打包成一个u64：低8位为队列号+1（0表示未分配），其余位是粗粒
+ * 度（约1s）的最后活跃时间。首次分配的并发竞争由CAS裁决，输掉的一
+ * 方沿用赢家的选择。重新选择只发生在flow空闲了足够久之后，此时它
+ * 之前的事件早已处理完，不会乱序。
+ */
+#define DISPATCH_TABLE_SIZE	4096	// 2的次幂
+#define DISPATCH_IDLE_RESEED_NS	(10ULL * NANOSEC_PER_SEC)
+#define DISPATCH_SLOT_TIME_SHIFT 30	// ns -> 约1s
+
+static uint64_t dispatch_table[DISPATCH_TABLE_SIZE];
+
+static inline uint64_t tuple_hash(struct __tuple_t *t)
+{
+	uint64_t h = 0, w;
+	int i;
+	// 38字节：4个u64加6字节尾部（memcpy避免未对齐访问）
+	for (i = 0; i < 4; i++) {
+		memcpy(&w, (uint8_t *) t + i * 8, 8);
+		h = xxhash(h ^ w);
+	}
+	w = 0;
+	memcpy(&w, (uint8_t *) t + 32, sizeof(*t) - 32);
+	return xxhash(h ^ w);
+}
+
+/*
+ * NUMA本节点优先：候选队列落在异地节点时，向后线性探测换成装配线
+ * 程所在节点的队列；本节点没有活跃队列则保持原候选（仍可分发，只
+ * 是跨节点）。单节点系统或未绑核线程（node < 0）直接返回原候选。
+ */
+static inline int numa_local_prefer(struct bpf_tracer *tracer, int idx,
+				    int count)
+{
+	int node = thread_numa_node;
+	if (node < 0 || tracer->queues[idx].numa_node < 0 ||
+	    tracer->queues[idx].numa_node == node)
+		return idx;
+
+	int i, j;
+	for (i = 1; i < count; i++) {
+		j = (idx + i) % count;
+		if (tracer->queues[j].numa_node == node)
+			return j;
+	}
+
+	return idx;
+}
+
+static inline int dispatch_flow_queue(struct bpf_tracer *tracer,
+				      struct __tuple_t *tuple)
+{
+	// 播种只在当前活跃的worker里选；沿用映射按预创建上限校验，
+	// 弹性缩容后存量flow继续走原队列，空闲重播种时才迁到活跃队
+	// 列，迁移前的事件那时早已处理完，per-socket有序性不变。
+	int count = tracer->dispatch_workers_active;
+	if (count < 1)
+		count = 1;
+	if (count == 1 && tracer->dispatch_workers_nr == 1)
+		return 0;
+
+	uint64_t hash = tuple_hash(tuple);
+	uint64_t *slot = &dispatch_table[hash & (DISPATCH_TABLE_SIZE - 1)];
+	uint64_t now_coarse = lat_now_ns() >> DISPATCH_SLOT_TIME_SHIFT;
+	uint64_t old = *slot, packed;
+	int q_idx;
+
+	if ((old & 0xff) != 0 &&
+	    (int)(old & 0xff) - 1 < tracer->dispatch_workers_nr &&
+	    now_coarse - (old >> 8) <=
+	    (DISPATCH_IDLE_RESEED_NS >> DISPATCH_SLOT_TIME_SHIFT)) {
+		// 活跃flow沿用已有映射，只刷新活跃时间
+		q_idx = (int)(old & 0xff) - 1;
+		*slot = (now_coarse << 8) | (old & 0xff);
+		return q_idx;
+	}
+
+	// two-choices：两个独立候选里选当前积压少的（候选先做本节点优先）
+	int c1 = numa_local_prefer(tracer, hash % count, count);
+	int c2 = numa_local_prefer(tracer, xxhash(hash) % count, count);
+	q_idx = ring_count(tracer->queues[c1].r) <=
+	    ring_count(tracer->queues[c2].r) ? c1 : c2;
+
+	packed = (now_coarse << 8) | (uint64_t) (q_idx + 1);
+	if (!__sync_bool_compare_and_swap(slot, old, packed)) {
+		old = *slot;
+		if ((old & 0xff) != 0 &&
+		    (int)(old & 0xff) - 1 < tracer->dispatch_workers_nr)
+			q_idx = (int)(old & 0xff) - 1;
+	}
+
+	return q_idx;
+}
+
 // Some event types of data are handled by the user using a separate callback interface,
 // which completes the dispatch logic after reading the data from the Perf-Reader.
 static int register_events_handle(struct event_meta *meta,
@@ -382,7 +646,8 @@ static int register_events_handle(struct event_meta *meta,
 	q_idx = dispatch_queue_index((uint64_t)meta->event_type,
 				     tracer->dispatch_workers_nr);
 	q = &tracer->queues[q_idx];
-	block_head = malloc(sizeof(struct mem_block_head) + size);
+	block_head =
+	    block_heap_get(&q->heap, sizeof(struct mem_block_head) + size);
 	if (block_head == NULL) {
 		ebpf_warning("block_head alloc memory faild\n");
 		return ETR_NOMEM;
@@ -390,10 +655,11 @@ static int register_events_handle(struct event_meta *meta,
 
 	void *data = block_head + 1;
 	memcpy(data, meta, size);
-	nr = ring_sp_enqueue_burst(q->r, (void **)&data, 1, NULL);
+	nr = ring_enqueue_burst(q->r, (void **)&data, 1, NULL);
+	queue_occupancy_update(q, nr < 1);
 	if (nr < 1) {
 		atomic64_add(&q->enqueue_lost, 1);
-		free(block_head);
+		block_heap_put(block_head);
 		ebpf_warning("Add ring(q:%d) faild\n", q_idx);
 		return ETR_NOROOM;
 	}
@@ -401,10 +667,10 @@ static int register_events_handle(struct event_meta *meta,
 	block_head->free_ptr = block_head;
 	block_head->is_last = 1;
 	block_head->fn = fn;
+	block_head->reader = NULL;
+	block_head->lat_enq_ts = 0;
 
-	pthread_mutex_lock(&q->mutex);
-	pthread_cond_signal(&q->cond);
-	pthread_mutex_unlock(&q->mutex);
+	queue_wakeup(q);
 
 	atomic64_add(&q->enqueue_nr, nr);
 
@@ -412,11 +678,15 @@ static int register_events_handle(struct event_meta *meta,
 }
 
 // Read datas from perf ring-buffer and dispatch.
-static void reader_raw_cb(void *t, void *raw, int raw_size)
+static void reader_raw_cb_do(void *t, void *raw, int raw_size)
 {
 	struct bpf_tracer *tracer = (struct bpf_tracer *)t;
 	struct event_meta *ev_meta = raw;
 
+	// 录制开启时把原始字节流落盘，供record_replay()离线回放
+	if (record_active)
+		record_append(raw, raw_size);
+
 	/*
 	 * If 0 < ev_meta->event_type < EVENT_TYPE_MIN is 'socket data buffer'
 	 * else if ev_meta->event_type >= EVENT_TYPE_MIN is register events.
@@ -446,9 +716,9 @@ static void reader_raw_cb(void *t, void *raw, int raw_size)
 	int i, start = 0;
 	struct __socket_data *sd;
 
-	// 确定分发到哪个队列上，通过第一个socket_data来确定
+	// 确定分发到哪个队列上，通过第一个socket_data的五元组来确定
 	sd = (struct __socket_data *)&buf->data[start];
-	q_idx = dispatch_queue_index(sd->socket_id, tracer->dispatch_workers_nr);
+	q_idx = dispatch_flow_queue(tracer, &sd->tuple);
 	q = &tracer->queues[q_idx];
 
 	if (buf->events_num > MAX_PKT_BURST) {
@@ -458,6 +728,30 @@ static void reader_raw_cb(void *t, void *raw, int raw_size)
 		return;
 	}
 
+	/*
+	 * 分阶段时延采样（1/64个burst）：这里记录内核发出到用户态读到
+	 * 的时延（sd->timestamp与本函数同为monotonic时基），入队时刻写
+	 * 进首事件的block_head，排队等待和处理耗时由worker出队时补全。
+	 */
+	bool lat_sample = ((q->lat_sample_seq++ & LATENCY_SAMPLE_MASK) == 0);
+	uint64_t lat_now = 0;
+	if (lat_sample) {
+		lat_now = lat_now_ns();
+		latency_hist_record(&q->lat_hists[LAT_STAGE_KERN_TO_USER],
+				    lat_now > sd->timestamp ?
+				    lat_now - sd->timestamp : 0);
+	}
+
+	/*
+	 * 零拷贝：perf记录在burst处理完成前不会被内核覆盖（data_tail延迟
+	 * 到释放时才推进），cap_data直接指向perf mmap区域里的payload，省
+	 * 去用户态的再次拷贝。记录跨ring边界或走ringbuf通道时claim失败，
+	 * 回退到拷贝方式。claim成功后本函数的所有返回路径都要负责释放。
+	 */
+	struct perf_reader *zc_reader = NULL;
+	uint32_t zc_slot = 0;
+	bool zero_copy = (perf_reader_record_claim(&zc_reader, &zc_slot) == 0);
+
 	struct socket_bpf_data *burst_data[MAX_PKT_BURST];
 
 	/*
@@ -481,30 +775,66 @@ static void reader_raw_cb(void *t, void *raw, int raw_size)
 	int len;
 	void *data_buf_ptr;
 
-	// 所有载荷的数据总大小（去掉头）
-	int alloc_len = buf->len - offsetof(typeof(struct __socket_data),
-					    data) * buf->events_num;
-	alloc_len += sizeof(*submit_data) * buf->events_num;	// 计算长度包含要提交的数据的头
-	alloc_len += sizeof(struct mem_block_head) * buf->events_num;	// 包含内存块head
-	alloc_len += sizeof(sd->extra_data) * buf->events_num;	// 可能包含额外数据
+	int alloc_len;
+	if (zero_copy) {
+		// 视图模式只需分配提交头，payload留在perf记录里
+		alloc_len = (sizeof(struct mem_block_head) +
+			     sizeof(*submit_data)) * buf->events_num;
+	} else {
+		// 所有载荷的数据总大小（去掉头）
+		alloc_len = buf->len - offsetof(typeof(struct __socket_data),
+						data) * buf->events_num;
+		alloc_len += sizeof(*submit_data) * buf->events_num;	// 计算长度包含要提交的数据的头
+		alloc_len += sizeof(struct mem_block_head) * buf->events_num;	// 包含内存块head
+		alloc_len += sizeof(sd->extra_data) * buf->events_num;	// 可能包含额外数据
+	}
 	alloc_len = CACHE_LINE_ROUNDUP(alloc_len);	// 保持cache line对齐
 
-	void *socket_data_buff = malloc(alloc_len);
+	void *socket_data_buff = block_heap_get(&q->heap, alloc_len);
 	if (socket_data_buff == NULL) {
-		ebpf_warning("malloc() error.\n");
+		ebpf_warning("block_heap_get() error.\n");
 		atomic64_inc(&q->heap_get_faild);
+		if (zero_copy)
+			perf_reader_record_put(zc_reader, zc_slot);
 		return;
 	}
 
+	// 统计预分配块耗尽而回退到malloc()的情况
+	if (!block_from_heap(socket_data_buff))
+		atomic64_inc(&q->heap_get_faild);
+
 	data_buf_ptr = socket_data_buff;
 
+	/*
+	 * 零拷贝模式下视图末尾要写字符串终结符，该字节是记录内下一个事件
+	 * 头的首字节，因此先把全部事件头复制出来，终结符写入的就只是已经
+	 * 解析完的死数据。复制量只有事件头（~百字节），payload不拷贝。
+	 */
+	uint8_t hdrs[MAX_PKT_BURST][offsetof(struct __socket_data, data)];
+	uint32_t starts[MAX_PKT_BURST];
+	if (zero_copy) {
+		for (i = 0; i < buf->events_num; i++) {
+			starts[i] = start;
+			memcpy(hdrs[i], &buf->data[start], sizeof(hdrs[0]));
+			sd = (struct __socket_data *)hdrs[i];
+			start += offsetof(typeof(struct __socket_data), data) +
+			    sd->data_len;
+		}
+		start = 0;
+	}
+
 	for (i = 0; i < buf->events_num; i++) {
-		sd = (struct __socket_data *)&buf->data[start];
+		if (zero_copy)
+			sd = (struct __socket_data *)hdrs[i];
+		else
+			sd = (struct __socket_data *)&buf->data[start];
 		len = sd->data_len;
 		block_head = (struct mem_block_head *)data_buf_ptr;
 		block_head->is_last = 0;
 		block_head->free_ptr = socket_data_buff;
 		block_head->fn = NULL;
+		block_head->reader = NULL;
+		block_head->lat_enq_ts = (lat_sample && i == 0) ? lat_now : 0;
 
 		data_buf_ptr = block_head + 1;
 		submit_data = data_buf_ptr;
@@ -523,8 +853,6 @@ static void reader_raw_cb(void *t, void *raw, int raw_size)
 		submit_data->process_id = sd->tgid;
 		submit_data->thread_id = sd->pid;
 		submit_data->coroutine_id = sd->coroutine_id;
-		submit_data->cap_data =
-		    (char *)((void **)&submit_data->cap_data + 1);
 		submit_data->syscall_len = sd->syscall_len;
 		submit_data->tcp_seq = sd->tcp_seq;
 		submit_data->cap_seq = sd->data_seq;
@@ -539,39 +867,70 @@ static void reader_raw_cb(void *t, void *raw, int raw_size)
 		if (sd->data_type >= PROTO_NUM)
 			sd->data_type = PROTO_UNKNOWN;
 
-		atomic64_inc(&tracer->proto_status[sd->data_type]);
+		atomic64_inc(&q->proto_status[sd->data_type]);
 		int offset = 0;
-		if (len > 0) {
-			if (sd->extra_data_count > 0) {
-				*(uint32_t *) submit_data->cap_data =
-				    sd->extra_data;
+		if (zero_copy) {
+			/*
+			 * cap_data是perf记录内payload的视图。extra_data前置
+			 * 写入本事件头的最后4字节（头已复制走，原位置是死
+			 * 数据），终结符同理写入下一个事件头的首字节。
+			 */
+			char *view = (char *)&buf->data[starts[i]] +
+			    offsetof(typeof(struct __socket_data), data);
+			if (len > 0 && sd->extra_data_count > 0) {
+				view -= sizeof(sd->extra_data);
+				*(uint32_t *) view = sd->extra_data;
 				offset = sizeof(sd->extra_data);
 			}
-
-			memcpy_fast(submit_data->cap_data + offset, sd->data,
-				    len);
-			submit_data->cap_data[len + offset] = '\0';
+			submit_data->cap_data = view;
+			if (len > 0)
+				view[len + offset] = '\0';
+		} else {
+			submit_data->cap_data =
+			    (char *)((void **)&submit_data->cap_data + 1);
+			if (len > 0) {
+				if (sd->extra_data_count > 0) {
+					*(uint32_t *) submit_data->cap_data =
+					    sd->extra_data;
+					offset = sizeof(sd->extra_data);
+				}
+
+				memcpy_fast(submit_data->cap_data + offset,
+					    sd->data, len);
+				submit_data->cap_data[len + offset] = '\0';
+			}
 		}
 		submit_data->syscall_len += offset;
 		submit_data->cap_len = len + offset;
 		burst_data[i] = submit_data;
 
-		start +=
-		    (offsetof(typeof(struct __socket_data), data) +
-		     sd->data_len);
+		if (zero_copy) {
+			data_buf_ptr += sizeof(*submit_data);
+		} else {
+			start +=
+			    (offsetof(typeof(struct __socket_data), data) +
+			     sd->data_len);
 
-		data_buf_ptr += sizeof(*submit_data) + submit_data->cap_len;
+			data_buf_ptr +=
+			    sizeof(*submit_data) + submit_data->cap_len;
+		}
 	}
 
-	nr = ring_sp_enqueue_burst
+	PROF_START(PROF_STAGE_ENQUEUE);
+	nr = ring_enqueue_burst
 	    (q->r, (void **)burst_data, buf->events_num, NULL);
+	PROF_END(PROF_STAGE_ENQUEUE);
+
+	queue_occupancy_update(q, nr < buf->events_num);
 
 	if (nr < buf->events_num) {
 		int lost = buf->events_num - nr;
 		ebpf_info("%s, ring_sp_enqueue lost %d.\n", __func__, lost);
 		atomic64_add(&q->enqueue_lost, lost);
 		if (lost == buf->events_num) {
-			free(socket_data_buff);
+			if (zero_copy)
+				perf_reader_record_put(zc_reader, zc_slot);
+			block_heap_put(socket_data_buff);
 			return;
 		}
 	}
@@ -579,15 +938,48 @@ static void reader_raw_cb(void *t, void *raw, int raw_size)
 	submit_data = burst_data[nr - 1];
 	block_head = (struct mem_block_head *)submit_data - 1;
 	block_head->is_last = 1;
+	if (zero_copy) {
+		block_head->reader = zc_reader;
+		block_head->record_slot = zc_slot;
+	}
 
 	/*
 	 * 通知工作线程进行dequeue，并进行数据处理。
 	 */
-	pthread_mutex_lock(&q->mutex);
-	pthread_cond_signal(&q->cond);
-	pthread_mutex_unlock(&q->mutex);
+	queue_wakeup(q);
+
+	// 队列积压时唤醒相邻队列的worker前来偷取
+	queue_stealer_wakeup(tracer, q);
 
 	atomic64_add(&q->enqueue_nr, nr);
+
+	// 周期性把tracer级计数器（丢失、协议分布）发布到共享内存统计段
+	static __thread uint32_t shm_pub_seq;
+	if ((++shm_pub_seq & 0x3f) == 0)
+		shm_tracer_stats_publish(tracer);
+}
+
+// PROF构建时对装配回调整体打点，默认构建下与reader_raw_cb_do()等价
+static void reader_raw_cb(void *t, void *raw, int raw_size)
+{
+	PROF_START(PROF_STAGE_RAW_CB);
+	reader_raw_cb_do(t, raw, raw_size);
+	PROF_END(PROF_STAGE_RAW_CB);
+}
+
+/*
+ * 供test下的benchmark使用，用录制的__socket_data_buffer数据
+ * 直接驱动用户态装配/分发流水线。
+ */
+void *socket_tracer_raw_cb(void)
+{
+	return (void *)reader_raw_cb;
+}
+
+// 供test下的benchmark使用：flow分发表实际使用的五元组哈希
+uint64_t socket_tracer_tuple_hash(struct __tuple_t *tuple)
+{
+	return tuple_hash(tuple);
 }
 
 static void reader_lost_cb(void *t, uint64_t lost)
@@ -596,6 +988,26 @@ static void reader_lost_cb(void *t, uint64_t lost)
 	atomic64_add(&tracer->lost, lost);
 }
 
+// 回收遍历时的超时判断参数
+struct reclaim_args {
+	uint32_t uptime;
+	uint32_t timeout;
+};
+
+static bool trace_info_expired(void *value, void *arg)
+{
+	struct trace_info_t *v = (struct trace_info_t *)value;
+	struct reclaim_args *args = (struct reclaim_args *)arg;
+	return (args->uptime - v->update_time > args->timeout);
+}
+
+static bool socket_info_expired(void *value, void *arg)
+{
+	struct socket_info_t *v = (struct socket_info_t *)value;
+	struct reclaim_args *args = (struct reclaim_args *)arg;
+	return (args->uptime - v->update_time > args->timeout);
+}
+
 static void reclaim_trace_map(struct bpf_tracer *tracer, uint32_t timeout)
 {
 	struct bpf_map *map =
@@ -607,6 +1019,17 @@ static void reclaim_trace_map(struct bpf_tracer *tracer, uint32_t timeout)
 	struct trace_info_t value;
 	uint32_t uptime = get_sys_uptime();
 
+	// 优先使用批量syscall方式回收（内核5.6+）
+	struct reclaim_args args = {.uptime = uptime,.timeout = timeout };
+	if (bpf_table_reclaim_batch(tracer, MAP_TRACE_NAME,
+				    trace_info_expired, (void *)&args,
+				    &reclaim_count) == ETR_OK) {
+		trace_map_reclaim_count += reclaim_count;
+		ebpf_info("[%s] trace map batch reclaim_count :%u\n", __func__,
+			  reclaim_count);
+		return;
+	}
+
 	while (bpf_map_get_next_key(map_fd, &trace_key, &next_trace_key) == 0) {
 		if (bpf_map_lookup_elem(map_fd, &next_trace_key, &value) == 0) {
 			if (uptime - value.update_time > timeout) {
@@ -635,6 +1058,17 @@ static void reclaim_socket_map(struct bpf_tracer *tracer, uint32_t timeout)
 	conn_key = 0;
 	uint32_t uptime = get_sys_uptime();
 
+	// 优先使用批量syscall方式回收（内核5.6+）
+	struct reclaim_args args = {.uptime = uptime,.timeout = timeout };
+	if (bpf_table_reclaim_batch(tracer, MAP_SOCKET_INFO_NAME,
+				    socket_info_expired, (void *)&args,
+				    &sockets_reclaim_count) == ETR_OK) {
+		socket_map_reclaim_count += sockets_reclaim_count;
+		ebpf_info("[%s] sockets batch reclaim_count :%u\n", __func__,
+			  sockets_reclaim_count);
+		return;
+	}
+
 	while (bpf_map_get_next_key(map_fd, &conn_key, &next_conn_key) == 0) {
 		if (bpf_map_lookup_elem(map_fd, &next_conn_key, &value) == 0) {
 			if (uptime - value.update_time > timeout) {
@@ -650,12 +1084,41 @@ static void reclaim_socket_map(struct bpf_tracer *tracer, uint32_t timeout)
 		  sockets_reclaim_count);
 }
 
+/*
+ * socket_map/trace_map使用LRU类型时（当前所有字节码版本，内核4.10+
+ * 即支持），map满由内核淘汰最久未访问表项，用户态的扫描回收退化为
+ * legacy fallback，只在加载了普通HASH类型字节码时才会被调度。
+ */
+static bool map_is_lru(struct bpf_tracer *tracer, const char *map_name)
+{
+	struct bpf_map *map =
+	    bpf_object__find_map_by_name(tracer->pobj, map_name);
+	if (map == NULL)
+		return false;
+
+	const struct bpf_map_def *def = bpf_map__def(map);
+	return def != NULL && def->type == BPF_MAP_TYPE_LRU_HASH;
+}
+
 static int check_map_exceeded(void)
 {
 	struct bpf_tracer *t = find_bpf_tracer(SK_TRACER_NAME);
 	if (t == NULL)
 		return -1;
 
+	// -1表示未探测；探测一次后缓存，避免每轮重复查询map定义
+	static int socket_map_lru = -1, trace_map_lru = -1;
+	if (socket_map_lru == -1) {
+		socket_map_lru = map_is_lru(t, MAP_SOCKET_INFO_NAME);
+		trace_map_lru = map_is_lru(t, MAP_TRACE_NAME);
+		if (socket_map_lru && trace_map_lru)
+			ebpf_info("socket/trace map is LRU type, kernel-side"
+				  " eviction, userspace reclaim disabled.\n");
+	}
+
+	if (socket_map_lru && trace_map_lru)
+		return 0;
+
 	uint64_t kern_socket_map_used = 0, kern_trace_map_used = 0;
 
 	struct trace_stats stats_total;
@@ -664,18 +1127,24 @@ static int check_map_exceeded(void)
 		kern_socket_map_used = stats_total.socket_map_count;
 		kern_trace_map_used = stats_total.trace_map_count;
 	}
-	// 校准map的统计数量
-	kern_socket_map_used -= socket_map_reclaim_count;
-	kern_trace_map_used -= trace_map_reclaim_count;
+	/*
+	 * 校准map的统计数量：用户态回收删除的表项不会扣减内核侧计数，
+	 * 减去累计回收数；防止无符号回绕（统计与回收存在竞争窗口）。
+	 */
+	kern_socket_map_used = kern_socket_map_used > socket_map_reclaim_count ?
+	    kern_socket_map_used - socket_map_reclaim_count : 0;
+	kern_trace_map_used = kern_trace_map_used > trace_map_reclaim_count ?
+	    kern_trace_map_used - trace_map_reclaim_count : 0;
 
-	if (kern_socket_map_used >= conf_socket_map_max_reclaim) {
+	if (!socket_map_lru &&
+	    kern_socket_map_used >= conf_socket_map_max_reclaim) {
 		ebpf_info("Current socket map used %u exceed"
 			  " conf_socket_map_max_reclaim %u,reclaim map\n",
 			  kern_socket_map_used, conf_socket_map_max_reclaim);
 		reclaim_socket_map(t, SOCKET_RECLAIM_TIMEOUT_DEF);
 	}
 
-	if (kern_trace_map_used >=
+	if (!trace_map_lru && kern_trace_map_used >=
 	    (uint64_t) (conf_max_trace_entries * RECLAIM_TRACE_MAP_SCALE)) {
 		ebpf_info("Current trace map used %u exceed"
 			  " reclaim_map_max %u,reclaim map\n",
@@ -688,6 +1157,124 @@ static int check_map_exceeded(void)
 	return 0;
 }
 
+/*
+ * 内核结构体偏移推断结果的磁盘缓存。偏移只取决于内核版本（以uname
+ * 的release+version串为键，version含build日期），命中时启动直接把
+ * 缓存的bpf_offset_param灌入offsets map，内核适配在首个周期检查就
+ * 完成，省去数秒的在线推断和合成流量；键不匹配则回退在线推断，并
+ * 在推断成功后刷新缓存。
+ */
+#define OFFSET_CACHE_PATH	"/var/lib/deepflow_bpf_offsets"
+#define OFFSET_CACHE_MAGIC	0x5453464644ULL	// "DFOFST"
+#define OFFSET_CACHE_VERSION	1
+
+struct offset_cache_file {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t __pad;
+	char krelease[65];
+	char kversion[65];
+	struct bpf_offset_param param;
+};
+
+static bool offset_cache_load(struct bpf_tracer *t)
+{
+	struct offset_cache_file f;
+	struct utsname uts;
+
+	int fd = open(OFFSET_CACHE_PATH, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	ssize_t n = read(fd, &f, sizeof(f));
+	close(fd);
+	if (n != sizeof(f) || f.magic != OFFSET_CACHE_MAGIC ||
+	    f.version != OFFSET_CACHE_VERSION || f.param.ready != 1)
+		return false;
+
+	if (uname(&uts) != 0)
+		return false;
+
+	if (strncmp(f.krelease, uts.release, sizeof(f.krelease)) != 0 ||
+	    strncmp(f.kversion, uts.version, sizeof(f.kversion)) != 0) {
+		ebpf_info("offset cache stale (cached %s, running %s),"
+			  " fallback to inference.\n", f.krelease, uts.release);
+		return false;
+	}
+
+	if (update_offsets_table(t, &f.param) != ETR_OK)
+		return false;
+
+	ebpf_info("kernel offsets loaded from cache (%s), inference"
+		  " skipped.\n", uts.release);
+	return true;
+}
+
+static void offset_cache_save(struct bpf_tracer *t)
+{
+	struct offset_cache_file f;
+	struct utsname uts;
+	char tmp_path[PATH_MAX];
+	int i;
+
+	if (sys_cpus_count <= 0 || uname(&uts) != 0)
+		return;
+
+	struct bpf_offset_param *offset;
+	struct bpf_offset_param_array *array =
+	    malloc(sizeof(*array) + sizeof(*offset) * sys_cpus_count);
+	if (array == NULL) {
+		ebpf_warning("malloc() error.\n");
+		return;
+	}
+
+	array->count = sys_cpus_count;
+	if (!bpf_offset_map_collect(t, array)) {
+		free(array);
+		return;
+	}
+
+	offset = (struct bpf_offset_param *)(array + 1);
+	memset(&f, 0, sizeof(f));
+	for (i = 0; i < sys_cpus_count; i++) {
+		if (cpu_online[i] && offset[i].ready == 1) {
+			f.param = offset[i];
+			break;
+		}
+	}
+
+	free(array);
+	if (f.param.ready != 1)
+		return;
+
+	f.magic = OFFSET_CACHE_MAGIC;
+	f.version = OFFSET_CACHE_VERSION;
+	snprintf(f.krelease, sizeof(f.krelease), "%s", uts.release);
+	snprintf(f.kversion, sizeof(f.kversion), "%s", uts.version);
+
+	// 先写临时文件再rename，避免被并发读到半截内容
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", OFFSET_CACHE_PATH);
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		ebpf_warning("open(%s) failed, offset cache not saved,"
+			     " error:%s\n", tmp_path, strerror(errno));
+		return;
+	}
+
+	if (write(fd, &f, sizeof(f)) != sizeof(f) ||
+	    rename(tmp_path, OFFSET_CACHE_PATH) != 0) {
+		ebpf_warning("write offset cache failed, error:%s\n",
+			     strerror(errno));
+		close(fd);
+		unlink(tmp_path);
+		return;
+	}
+
+	close(fd);
+	ebpf_info("kernel offsets cached to %s (%s).\n", OFFSET_CACHE_PATH,
+		  uts.release);
+}
+
 static int check_kern_adapt_and_state_update(void)
 {
 	struct bpf_tracer *t = find_bpf_tracer(SK_TRACER_NAME);
@@ -702,6 +1289,63 @@ static int check_kern_adapt_and_state_update(void)
 		}
 		set_period_event_invalid("check-kern-adapt");
 		t->adapt_success = true;
+		offset_cache_save(t);
+	}
+
+	return 0;
+}
+
+// 过载整流采样率的下限（约1.6%的流）与恢复前的静默周期数
+#define SAMPLE_RATE_MIN			1024
+#define SAMPLE_RECOVER_PERIODS		5
+
+/*
+ * 过载反馈控制：周期检查内核丢失（reader_lost_cb）与用户态入队丢
+ * 失的增量。本周期有丢失则乘性降低内核整流采样率（按socket_id整
+ * 条流保留或丢弃，见sample_rate_map），连续SAMPLE_RECOVER_PERIODS
+ * 个周期无丢失后逐步加性恢复到满刻度。过载时保留的流数据完整，
+ * 而不是所有流都随机缺块。
+ */
+static int sample_rate_adjust(void)
+{
+	static uint32_t rate_cur = SAMPLE_SCALE_FULL;
+	static uint64_t last_lost;
+	static int clean_periods;
+
+	struct bpf_tracer *t = find_bpf_tracer(SK_TRACER_NAME);
+	if (t == NULL || t->state != TRACER_RUNNING)
+		return 0;
+
+	uint64_t lost = atomic64_read(&t->lost);
+	int i;
+	for (i = 0; i < t->dispatch_workers_nr; i++)
+		lost += atomic64_read(&t->queues[i].enqueue_lost);
+
+	uint64_t delta = lost - last_lost;
+	last_lost = lost;
+
+	uint32_t rate_new = rate_cur;
+	if (delta > 0) {
+		clean_periods = 0;
+		rate_new = rate_cur - (rate_cur >> 2);
+		if (rate_new < SAMPLE_RATE_MIN)
+			rate_new = SAMPLE_RATE_MIN;
+	} else if (rate_cur < SAMPLE_SCALE_FULL &&
+		   ++clean_periods >= SAMPLE_RECOVER_PERIODS) {
+		clean_periods = 0;
+		rate_new = rate_cur + (SAMPLE_SCALE_FULL >> 4);
+		if (rate_new > SAMPLE_SCALE_FULL)
+			rate_new = SAMPLE_SCALE_FULL;
+	}
+
+	if (rate_new != rate_cur) {
+		if (!bpf_table_set_value(t, MAP_SAMPLE_RATE_NAME, 0,
+					 &rate_new))
+			return ETR_SYSCALL;
+		ebpf_info("overload sampling rate %u -> %u (/%u),"
+			  " period lost %" PRIu64 "\n",
+			  rate_cur, rate_new, SAMPLE_SCALE_FULL, delta);
+		rate_cur = rate_new;
 	}
 
 	return 0;
@@ -748,9 +1392,17 @@ int running_socket_tracer(l7_handle_fn handle,
 			  uint32_t queue_size,
 			  uint32_t max_socket_entries,
 			  uint32_t max_trace_entries,
-			  uint32_t socket_map_max_reclaim)
+			  uint32_t socket_map_max_reclaim,
+			  uint32_t caps)
 {
 	int ret;
+
+	// 基础IO组是tracer的核心功能且内核适配依赖它，始终开启
+	caps = (caps & TRACE_CAP_ALL) | TRACE_CAP_BASE_IO;
+	// uprobe的增删依赖进程exec/exit事件
+	if (caps & TRACE_CAP_GO_UPROBE)
+		caps |= TRACE_CAP_PROC_EVENTS;
+	tracer_caps = tracer_caps_loaded = caps;
 	// Used to record which eBPF buffer was loaded.
 	char bpf_load_buffer_name[NAME_LEN];
 	void *bpf_bin_buffer;
@@ -764,7 +1416,18 @@ int running_socket_tracer(l7_handle_fn handle,
 		return -EINVAL;
 	}
 
-	if (is_core_kernel()) {
+	/*
+	 * Linux 5.8+使用BPF ringbuf（各CPU共享一个buffer）代替per-CPU
+	 * perf buffer向用户态传递数据，更老的内核保持perf buffer方式。
+	 */
+	bool use_ringbuf = false;
+	if (is_core_kernel() && (major > 5 || (major == 5 && minor >= 8))) {
+		snprintf(bpf_load_buffer_name, NAME_LEN,
+			 "socket-trace-bpf-linux-core-rb");
+		bpf_bin_buffer = (void *)socket_trace_core_rb_ebpf_data;
+		buffer_sz = sizeof(socket_trace_core_rb_ebpf_data);
+		use_ringbuf = true;
+	} else if (is_core_kernel()) {
 		snprintf(bpf_load_buffer_name, NAME_LEN,
 			 "socket-trace-bpf-linux-core");
 		bpf_bin_buffer = (void *)socket_trace_core_ebpf_data;
@@ -792,7 +1455,7 @@ int running_socket_tracer(l7_handle_fn handle,
 	}
 	memset(tps, 0, sizeof(*tps));
 	INIT_LIST_HEAD(&tps->uprobe_syms_head);
-	socket_tracer_set_probes(tps);
+	socket_tracer_set_probes(tps, caps);
 	struct bpf_tracer *tracer =
 	    create_bpf_tracer(SK_TRACER_NAME, bpf_load_buffer_name,
 			      bpf_bin_buffer, buffer_sz, tps,
@@ -803,6 +1466,10 @@ int running_socket_tracer(l7_handle_fn handle,
 	tracer->state = TRACER_INIT;
 	tracer->adapt_success = false;
 
+	// 提前注册的burst级回调在此生效
+	tracer->process_burst_fn = (void *)socket_data_burst_handle;
+	tracer->burst_reconfirm_fn = (void *)socket_burst_reconfirm;
+
 	/*
 	 * config perf ring-buffer reader callback
 	 */
@@ -825,7 +1492,27 @@ int running_socket_tracer(l7_handle_fn handle,
 
 	conf_max_trace_entries = max_trace_entries;
 
-	if (tracer_bpf_load(tracer))
+	/*
+	 * go进程的procfs扫描/ELF符号解析与BPF字节码的加载验证互不依
+	 * 赖，都是冷启动路径上最耗时的阶段（大机器上各自可达数十秒），
+	 * 扫描放到独立线程与加载并行，tracer_probes_init()消费符号表
+	 * 之前join。线程创建失败退回同步扫描。
+	 */
+	pthread_t uprobe_scan_thread = 0;
+	if (caps & TRACE_CAP_GO_UPROBE) {
+		if (pthread_create(&uprobe_scan_thread, NULL,
+				   uprobe_syms_collect_worker, (void *)tps)) {
+			ebpf_warning("uprobe scan thread create failed,"
+				     " fallback to synchronous scan.\n");
+			uprobe_scan_thread = 0;
+			collect_uprobe_syms_from_procfs(tps);
+		}
+	}
+
+	ret = tracer_bpf_load(tracer);
+	if (uprobe_scan_thread)
+		pthread_join(uprobe_scan_thread, NULL);
+	if (ret)
 		return -EINVAL;
 
 	if (tracer_probes_init(tracer))
@@ -837,7 +1524,10 @@ int running_socket_tracer(l7_handle_fn handle,
 	if (tracer_hooks_attach(tracer))
 		return -EINVAL;
 
-	if (perf_map_init(tracer, MAP_PERF_SOCKET_DATA_NAME))
+	if (use_ringbuf) {
+		if (ringbuf_map_init(tracer, MAP_PERF_SOCKET_DATA_NAME))
+			return -EINVAL;
+	} else if (perf_map_init(tracer, MAP_PERF_SOCKET_DATA_NAME))
 		return -EINVAL;
 
 	uint64_t uid_base = (gettime(CLOCK_REALTIME, TIME_TYPE_NAN) / 100) &
@@ -845,20 +1535,38 @@ int running_socket_tracer(l7_handle_fn handle,
 	if (uid_base == 0)
 		return -EINVAL;
 
-	uint16_t cpu;
-	struct trace_uid_t t_uid[MAX_CPU_NR];
-	for (cpu = 0; cpu < MAX_CPU_NR; cpu++) {
+	// per-cpu map的value数组按CPU数分配，兼容超过MAX_CPU_NR的主机
+	uint32_t cpu, nr_cpus = sys_cpus_count > MAX_CPU_NR ?
+	    sys_cpus_count : MAX_CPU_NR;
+	struct trace_uid_t *t_uid = calloc(nr_cpus, sizeof(*t_uid));
+	if (t_uid == NULL) {
+		ebpf_warning("calloc() error.\n");
+		return -ENOMEM;
+	}
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
 		t_uid[cpu].socket_id = (uint64_t) cpu << 56 | uid_base;
 		t_uid[cpu].coroutine_trace_id = t_uid[cpu].socket_id;
 		t_uid[cpu].thread_trace_id = t_uid[cpu].socket_id;
 	}
 
-	if (!bpf_table_set_value(tracer, MAP_TRACE_UID_NAME, 0, (void *)&t_uid))
+	if (!bpf_table_set_value(tracer, MAP_TRACE_UID_NAME, 0, (void *)t_uid)) {
+		free(t_uid);
 		return -EINVAL;
+	}
+
+	free(t_uid);
 
 	if ((ret = dispatch_worker(tracer, queue_size)))
 		return ret;
 
+	/*
+	 * 偏移缓存命中时首个check-kern-adapt周期即可完成内核适配；
+	 * 推断服务仍照常注册，作为缓存失效场景的兜底。
+	 */
+	if (!offset_cache_load(tracer))
+		ebpf_info("offset cache miss, run kernel offset inference.\n");
+
 	// use for inference struct offset.
 	if (kernel_offset_infer_init() != ETR_OK)
 		return -EINVAL;
@@ -883,6 +1591,14 @@ int running_socket_tracer(l7_handle_fn handle,
 				      check_kern_adapt_and_state_update)))
 		return ret;
 
+	if ((ret =
+	     register_period_event_op("sample-adjust", sample_rate_adjust)))
+		return ret;
+
+	// BPF程序运行时开销统计，内核不支持时内部降级为不采样
+	if ((ret = tracer_prog_stats_init(tracer)))
+		return ret;
+
 	if ((ret = sockopt_register(&socktrace_sockopts)) != ETR_OK)
 		return ret;
 
@@ -958,6 +1674,8 @@ static int socket_tracer_start(void)
 	// Protect the probes operation in multiple threads, similar to socket_tracer_stop()
 	pthread_mutex_lock(&t->mutex_probes_lock);
 	if ((ret = tracer_hooks_attach(t)) == 0) {
+		// 全量附着会重新arm所有已注册组
+		tracer_caps = tracer_caps_loaded;
 		t->state = TRACER_RUNNING;
 		ebpf_info
 		    ("Tracer start success, current state: TRACER_RUNNING\n");
@@ -967,6 +1685,112 @@ static int socket_tracer_start(void)
 	return ret;
 }
 
+// 判断probe是否属于mask中的能力组（kprobe只有MSG_IO组使用，uprobe属GO组）
+static bool probe_in_caps(struct probe *p, uint32_t mask)
+{
+	int i;
+
+	if (p->type == UPROBE)
+		return !!(mask & TRACE_CAP_GO_UPROBE);
+
+	if (!(mask & TRACE_CAP_MSG_IO))
+		return false;
+
+	const char *fn = strchr(p->name, '/');
+	fn = fn ? fn + 1 : p->name;
+	for (i = 0; i < CAP_SYMS_NUM(msg_io_kprobes); i++) {
+		if (strcmp(fn, msg_io_kprobes[i]) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+static void caps_tracepoints_process(struct bpf_tracer *t, uint32_t mask,
+				     enum tracer_hook_type type)
+{
+	int i;
+
+	if (mask & TRACE_CAP_BASE_IO) {
+		for (i = 0; i < CAP_SYMS_NUM(base_io_tps); i++)
+			tracer_tracepoint_process(t, base_io_tps[i], type);
+	}
+
+	if (mask & TRACE_CAP_MSG_IO) {
+		for (i = 0; i < CAP_SYMS_NUM(msg_io_tps); i++)
+			tracer_tracepoint_process(t, msg_io_tps[i], type);
+	}
+
+	if (mask & TRACE_CAP_PROC_EVENTS) {
+		for (i = 0; i < CAP_SYMS_NUM(proc_event_tps); i++)
+			tracer_tracepoint_process(t, proc_event_tps[i], type);
+	}
+}
+
+/*
+ * 运行时增量调整探针能力组：新启用的组注册（如此前从未注册过）
+ * 并附着，关闭的组解除附着（probe对象保留，再次开启时直接重新
+ * 附着）。只在适配完成且TRACER_RUNNING状态下生效。
+ */
+int socket_tracer_update_caps(uint32_t caps)
+{
+	struct bpf_tracer *t = find_bpf_tracer(SK_TRACER_NAME);
+	if (t == NULL)
+		return ETR_NOTEXIST;
+
+	if (t->state != TRACER_RUNNING || !t->adapt_success) {
+		ebpf_warning
+		    ("update probe caps only permitted in running state.\n");
+		return ETR_INVAL;
+	}
+
+	caps &= TRACE_CAP_ALL;
+	if (caps & TRACE_CAP_GO_UPROBE)
+		caps |= TRACE_CAP_PROC_EVENTS;
+
+	uint32_t enable = caps & ~tracer_caps;
+	uint32_t disable = tracer_caps & ~caps;
+	if (enable == 0 && disable == 0)
+		return ETR_OK;
+
+	pthread_mutex_lock(&t->mutex_probes_lock);
+
+	// 此前从未注册过的组补注册符号并创建probe对象
+	uint32_t fresh = enable & ~tracer_caps_loaded;
+	if (fresh) {
+		socket_tracer_set_probes(t->tps, fresh);
+		if (fresh & TRACE_CAP_MSG_IO)
+			tracer_kprobes_update(t);
+		if (fresh & TRACE_CAP_GO_UPROBE) {
+			collect_uprobe_syms_from_procfs(t->tps);
+			tracer_uprobes_update(t);
+		}
+		tracer_caps_loaded |= fresh;
+	}
+
+	struct probe *p;
+	list_for_each_entry(p, &t->probes_head, list) {
+		if (probe_in_caps(p, enable))
+			probe_attach(p);
+		else if (probe_in_caps(p, disable))
+			probe_detach(p);
+	}
+
+	caps_tracepoints_process(t, disable, HOOK_DETACH);
+	caps_tracepoints_process(t, enable, HOOK_ATTACH);
+
+	if (enable & TRACE_CAP_GO_UPROBE)
+		update_go_offsets_to_map(t);
+
+	tracer_caps = caps;
+	pthread_mutex_unlock(&t->mutex_probes_lock);
+
+	ebpf_info("probe caps updated, enable 0x%x disable 0x%x,"
+		  " current 0x%x\n", enable, disable, caps);
+
+	return ETR_OK;
+}
+
 static bool bpf_stats_map_collect(struct bpf_tracer *tracer,
 				  struct trace_stats *stats_total)
 {
@@ -991,16 +1815,25 @@ static bool bpf_stats_map_collect(struct bpf_tracer *tracer,
 // Update offsets tables for all cpus
 static int update_offsets_table(struct bpf_tracer *t, struct bpf_offset_param *offset)
 {
-	struct bpf_offset_param offs[MAX_CPU_NR];
-	int i;
-	memset(&offs, 0, sizeof(offs));
-	for (i = 0; i < MAX_CPU_NR; i++) {
+	// per-cpu map的value数组按CPU数分配，兼容超过MAX_CPU_NR的主机
+	int i, nr_cpus = sys_cpus_count > MAX_CPU_NR ?
+	    sys_cpus_count : MAX_CPU_NR;
+	struct bpf_offset_param *offs = calloc(nr_cpus, sizeof(*offs));
+	if (offs == NULL) {
+		ebpf_warning("calloc() error.\n");
+		return ETR_NOMEM;
+	}
+
+	for (i = 0; i < nr_cpus; i++) {
 		offs[i] = *offset;
 	}
 
-	if (!bpf_table_set_value(t, MAP_MEMBERS_OFFSET_NAME, 0, (void *)&offs))
+	if (!bpf_table_set_value(t, MAP_MEMBERS_OFFSET_NAME, 0, (void *)offs)) {
+		free(offs);
 		return ETR_UPDATE_MAP_FAILD;
+	}
 
+	free(offs);
 	return ETR_OK;
 }
 
@@ -1130,6 +1963,34 @@ int register_event_handle(uint32_t type, void (*fn)(void *))
 	return 0;
 }
 
+/**
+ * Register burst-level socket data handle.
+ *
+ * worker把一次出队的整个burst（最多MAX_PKT_BURST个socket_bpf_data
+ * 指针）一次性交给回调，C->Rust的FFI开销从每事件一次降到每burst一次，
+ * 上层可对批量数据做向量化处理。注册后原per-event回调（running_
+ * socket_tracer()的handle参数）仅用于兜底（fn为NULL时不再逐条调用）；
+ * 注册事件（exec/exit等）仍逐条分发。建议在running_socket_tracer()
+ * 之前调用，之后调用对已在处理中的burst不保证立即生效。
+ *
+ * Parameter:
+ * @fn Burst callback function, NULL to unregister
+ *
+ * @return 0 is success, if not 0 is faild
+ */
+int register_socket_data_burst_handle(l7_handle_burst_fn fn)
+{
+	socket_data_burst_handle = fn;
+
+	struct bpf_tracer *t = find_bpf_tracer(SK_TRACER_NAME);
+	if (t != NULL)
+		t->process_burst_fn = (void *)fn;
+
+	ebpf_info("%s burst-level socket data handle %p\n",
+		  fn != NULL ? "Register" : "Unregister", fn);
+	return 0;
+}
+
 // -------------------------------------
 // 协议测试
 // -------------------------------------
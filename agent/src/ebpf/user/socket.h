@@ -139,12 +139,27 @@ struct bpf_offset_param_array {
 	struct bpf_offset_param offsets[0];
 };
 
+/*
+ * 分阶段时延直方图的汇总（所有分发队列相加），桶为log2(ns)，
+ * 阶段定义见tracer.h的enum latency_stage。
+ */
+struct stage_latency_stats {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t buckets[LATENCY_HIST_BUCKETS];
+};
+
 struct bpf_socktrace_params {
 	uint8_t  tracer_state;
 	uint32_t kern_socket_map_max;
 	uint32_t kern_socket_map_used;
 	uint32_t kern_trace_map_max;
 	uint32_t kern_trace_map_used;
+	struct stage_latency_stats latency_stats[LAT_STAGE_NUM];
+	// BPF程序运行时开销（见tracer.h的struct bpf_prog_rt_stat），
+	// 内核不支持统计时prog_stats_nr为0
+	uint32_t prog_stats_nr;
+	struct bpf_prog_rt_stat prog_stats[PROG_RT_STATS_MAX];
 	struct bpf_offset_param_array offset_array;
 };
 
@@ -157,6 +172,24 @@ struct extra_event {
 	void (*h)(void *);
 };
 
+/*
+ * 探针能力组，running_socket_tracer()的caps参数按位选择。
+ * 未选中的组不注册也不附着，内核不产生相应开销。
+ */
+enum socket_trace_caps {
+	// read/write/sendto/recvfrom跟踪及清理/超时检查等基础设施，
+	// 内核适配依赖此组，启动时强制开启
+	TRACE_CAP_BASE_IO = 1 << 0,
+	// sendmsg/sendmmsg/recvmsg/recvmmsg/writev/readv族
+	TRACE_CAP_MSG_IO = 1 << 1,
+	// 进程exec/exit事件（Go uprobe管理依赖此组）
+	TRACE_CAP_PROC_EVENTS = 1 << 2,
+	// Go进程uprobe跟踪（含TLS）
+	TRACE_CAP_GO_UPROBE = 1 << 3,
+
+	TRACE_CAP_ALL = 0xf,
+};
+
 struct socket_trace_stats socket_tracer_stats(void);
 int running_socket_tracer(l7_handle_fn handle,
 			  int thread_nr,
@@ -164,6 +197,15 @@ int running_socket_tracer(l7_handle_fn handle,
 			  uint32_t queue_size,
 			  uint32_t max_socket_entries,
 			  uint32_t max_trace_entries,
-			  uint32_t socket_map_max_reclaim);
+			  uint32_t socket_map_max_reclaim,
+			  uint32_t caps);
+// 运行时增量调整探针能力组，新启用的组附着、关闭的组解除
+int socket_tracer_update_caps(uint32_t caps);
 int register_event_handle(uint32_t type, void (*fn)(void *));
+// 注册burst级socket数据回调，整个burst一次性交给上层处理
+int register_socket_data_burst_handle(l7_handle_burst_fn fn);
+// 供test下的benchmark使用：返回perf记录的装配/分发回调
+void *socket_tracer_raw_cb(void);
+// 供test下的benchmark使用：flow分发表实际使用的五元组哈希
+uint64_t socket_tracer_tuple_hash(struct __tuple_t *tuple);
 #endif /*_USER_SOCKET_H_*/
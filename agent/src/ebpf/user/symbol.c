@@ -66,7 +66,7 @@ void free_uprobe_symbol(struct symbol_uprobe *u_sym,
 void add_uprobe_symbol(int pid, struct symbol_uprobe *u_sym,
 		       struct tracer_probes_conf *conf)
 {
-	u_sym->starttime = get_process_starttime(pid);
+	u_sym->starttime = proc_meta_get_starttime(pid);
 	u_sym->in_probe = false;
 	list_add_tail(&u_sym->list, &conf->uprobe_syms_head);
 	conf->uprobe_count++;
@@ -88,6 +88,238 @@ int copy_uprobe_symbol(struct symbol_uprobe *src, struct symbol_uprobe *dst)
 	return ETR_OK;
 }
 
+/* ==========================================================
+ * ELF符号解析结果缓存
+ *
+ * Kubernetes场景下大量进程运行同一个二进制镜像，符号表遍历、
+ * 地址转换和返回地址反汇编对每个不同的二进制只做一次，后续pid
+ * 直接用缓存模板生成symbol_uprobe。以(st_dev, st_ino, st_mtime)
+ * 标识同一个二进制（容器内路径不同但指向相同文件）。符号不存在
+ * 的结果同样缓存，避免对同一文件反复扫描符号表。
+ * ==========================================================
+ */
+struct symbol_cache_entry {
+	struct list_head list;
+	dev_t dev;
+	ino_t ino;
+	uint64_t mtime;
+	char *sym_name;
+	bool isret;
+	bool resolved;		// false表示该二进制中没有此符号
+	// 以下为解析结果，都是文件内偏移，跨pid复用
+	uint64_t entry;
+	uint64_t size;
+	int rets_count;
+	size_t rets[FUNC_RET_MAX];
+};
+
+static LIST_HEAD(symbol_cache_head);
+static pthread_mutex_t symbol_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 缓存项插入后不再修改，返回的指针无需持锁读取
+static struct symbol_cache_entry *symbol_cache_find(dev_t dev, ino_t ino,
+						    uint64_t mtime,
+						    const char *sym_name,
+						    bool isret)
+{
+	struct symbol_cache_entry *e, *found = NULL;
+	pthread_mutex_lock(&symbol_cache_lock);
+	list_for_each_entry(e, &symbol_cache_head, list) {
+		if (e->dev == dev && e->ino == ino && e->mtime == mtime &&
+		    e->isret == isret && strcmp(e->sym_name, sym_name) == 0) {
+			found = e;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&symbol_cache_lock);
+	return found;
+}
+
+// uprobe_sym为NULL时记录负结果（二进制中没有该符号）
+static void symbol_cache_add(dev_t dev, ino_t ino, uint64_t mtime,
+			     const char *sym_name, bool isret,
+			     struct symbol_uprobe *uprobe_sym)
+{
+	struct symbol_cache_entry *e = calloc(1, sizeof(*e));
+	if (e == NULL) {
+		ebpf_warning("symbol_cache_entry calloc() failed.\n");
+		return;
+	}
+
+	e->sym_name = strdup(sym_name);
+	if (e->sym_name == NULL) {
+		free(e);
+		return;
+	}
+
+	e->dev = dev;
+	e->ino = ino;
+	e->mtime = mtime;
+	e->isret = isret;
+	if (uprobe_sym != NULL) {
+		e->resolved = true;
+		e->entry = uprobe_sym->entry;
+		e->size = uprobe_sym->size;
+		e->rets_count = uprobe_sym->rets_count;
+		memcpy(e->rets, uprobe_sym->rets, sizeof(e->rets));
+	}
+
+	pthread_mutex_lock(&symbol_cache_lock);
+	list_add_tail(&e->list, &symbol_cache_head);
+	pthread_mutex_unlock(&symbol_cache_lock);
+}
+
+/* ==========================================================
+ * /proc元数据缓存（pid维度）
+ *
+ * 一次exec事件的处理流程会反复读取同一进程的procfs元数据：事件
+ * 入队、批量解析各读一次exe链接，每个uprobe符号登记读一次
+ * starttime，启动扫描读一次status判断进程/线程。这里把exe路径、
+ * starttime和Tgid==Pid三项按pid缓存，靠socket tracer已有的
+ * exec/exit事件失效（见go_process_exec/go_process_exit），稳态下
+ * procfs读取次数与进程事件数同阶。这些值对存活的pid不会变化
+ * （exec会改变exe，但exec事件本身就是失效点），不需要TTL。
+ * ==========================================================
+ */
+struct proc_meta_entry {
+	struct hlist_node hash;
+	int pid;
+	unsigned long long starttime;
+	bool is_main_proc;	// status中Tgid == Pid
+	char *elf_path;		// NULL表示exe链接不可读（如内核线程）
+};
+
+#define PROC_META_HASH_BUCKETS 512
+static struct hlist_head proc_meta_hash[PROC_META_HASH_BUCKETS];
+static pthread_mutex_t proc_meta_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t proc_meta_bucket(int pid)
+{
+	return (uint32_t) xxhash((uint64_t) pid) & (PROC_META_HASH_BUCKETS - 1);
+}
+
+// 调用者持有proc_meta_lock
+static struct proc_meta_entry *proc_meta_find(int pid)
+{
+	struct proc_meta_entry *e;
+	struct hlist_node *pos;
+	hlist_for_each_entry(e, pos, &proc_meta_hash[proc_meta_bucket(pid)],
+			     hash) {
+		if (e->pid == pid)
+			return e;
+	}
+
+	return NULL;
+}
+
+// 读/proc/<pid>/status，Tgid == Pid为进程，否则是线程
+static bool read_status_is_process(int pid)
+{
+	char file[PATH_MAX], buff[4096];
+	int fd;
+	int read_tgid = -1, read_pid = -1;
+
+	snprintf(file, sizeof(file), "/proc/%d/status", pid);
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	memset(buff, 0, sizeof(buff));
+	read(fd, buff, sizeof(buff) - 1);
+	close(fd);
+
+	char *p = strstr(buff, "Tgid:");
+	if (p)
+		sscanf(p, "Tgid:\t%d", &read_tgid);
+
+	p = strstr(buff, "Pid:");
+	if (p)
+		sscanf(p, "Pid:\t%d", &read_pid);
+
+	return read_tgid != -1 && read_pid != -1 && read_tgid == read_pid;
+}
+
+// 调用者持有proc_meta_lock。进程不存在时不缓存负结果直接返回NULL
+static struct proc_meta_entry *proc_meta_fill(int pid)
+{
+	unsigned long long stime = get_process_starttime(pid);
+	if (stime == 0)
+		return NULL;
+
+	struct proc_meta_entry *e = calloc(1, sizeof(*e));
+	if (e == NULL) {
+		ebpf_warning("proc_meta_entry calloc() failed.\n");
+		return NULL;
+	}
+
+	e->pid = pid;
+	e->starttime = stime;
+	e->is_main_proc = read_status_is_process(pid);
+	e->elf_path = get_elf_path_by_pid(pid);
+	hlist_add_head(&e->hash, &proc_meta_hash[proc_meta_bucket(pid)]);
+	return e;
+}
+
+unsigned long long proc_meta_get_starttime(int pid)
+{
+	unsigned long long stime = 0;
+	struct proc_meta_entry *e;
+
+	pthread_mutex_lock(&proc_meta_lock);
+	e = proc_meta_find(pid);
+	if (e == NULL)
+		e = proc_meta_fill(pid);
+	if (e != NULL)
+		stime = e->starttime;
+	pthread_mutex_unlock(&proc_meta_lock);
+	return stime;
+}
+
+bool proc_meta_is_process(int pid)
+{
+	bool is_proc = false;
+	struct proc_meta_entry *e;
+
+	pthread_mutex_lock(&proc_meta_lock);
+	e = proc_meta_find(pid);
+	if (e == NULL)
+		e = proc_meta_fill(pid);
+	if (e != NULL)
+		is_proc = e->is_main_proc;
+	pthread_mutex_unlock(&proc_meta_lock);
+	return is_proc;
+}
+
+// 返回副本，调用者负责free()，与get_elf_path_by_pid()的约定一致
+char *proc_meta_get_elf_path(int pid)
+{
+	char *path = NULL;
+	struct proc_meta_entry *e;
+
+	pthread_mutex_lock(&proc_meta_lock);
+	e = proc_meta_find(pid);
+	if (e == NULL)
+		e = proc_meta_fill(pid);
+	if (e != NULL && e->elf_path != NULL)
+		path = strdup(e->elf_path);
+	pthread_mutex_unlock(&proc_meta_lock);
+	return path;
+}
+
+void proc_meta_evict(int pid)
+{
+	struct proc_meta_entry *e;
+
+	pthread_mutex_lock(&proc_meta_lock);
+	e = proc_meta_find(pid);
+	if (e != NULL) {
+		hlist_del_init(&e->hash);
+		free(e->elf_path);
+		free(e);
+	}
+	pthread_mutex_unlock(&proc_meta_lock);
+}
+
 static int find_sym(const char *symname, uint64_t addr, uint64_t size,
 		    void *payload)
 {
@@ -207,6 +439,9 @@ struct symbol_uprobe *resolve_and_gen_uprobe_symbol(const char *bin_file,
 		return NULL;
 	}
 
+	struct stat sb;
+	bool cache_usable = false, cache_negative = false;
+
 	uprobe_sym->type = sym->type;
 	uprobe_sym->isret = sym->is_probe_ret;
 	uprobe_sym->name = strdup(sym->symbol);
@@ -230,14 +465,41 @@ struct symbol_uprobe *resolve_and_gen_uprobe_symbol(const char *bin_file,
 	uprobe_sym->name = strdup(sym->symbol);
 	uprobe_sym->entry = addr;
 
+	/*
+	 * 同一个二进制（以dev/ino/mtime标识）的解析结果直接取缓存，
+	 * 只有地址未给定时才有查表动作需要缓存。
+	 */
+	cache_usable = (addr == 0x0 && uprobe_sym->name != NULL &&
+			stat(uprobe_sym->binary_path, &sb) == 0);
+
+	if (cache_usable) {
+		struct symbol_cache_entry *cached =
+		    symbol_cache_find(sb.st_dev, sb.st_ino, sb.st_mtime,
+				      sym->symbol, uprobe_sym->isret);
+		if (cached != NULL) {
+			if (!cached->resolved)
+				goto invalid;
+
+			uprobe_sym->entry = cached->entry;
+			uprobe_sym->size = cached->size;
+			uprobe_sym->rets_count = cached->rets_count;
+			memcpy(uprobe_sym->rets, cached->rets,
+			       sizeof(uprobe_sym->rets));
+			return uprobe_sym;
+		}
+	}
+
 	if (uprobe_sym->name && uprobe_sym->entry == 0x0)
 		if (bcc_elf_foreach_sym
 		    (uprobe_sym->binary_path, find_sym, &default_option,
 		     uprobe_sym) < 0)
 			goto invalid;
 
-	if (uprobe_sym->entry == 0x0)
+	if (uprobe_sym->entry == 0x0) {
+		// 符号表遍历成功但符号不存在，这是二进制自身的属性，缓存负结果
+		cache_negative = true;
 		goto invalid;
+	}
 
 	/* 
 	 * 对于可执行的二进制文件(ET_EXEC), 把virtual address转换成物理地址。
@@ -270,9 +532,16 @@ struct symbol_uprobe *resolve_and_gen_uprobe_symbol(const char *bin_file,
 		resolve_func_ret_addr(uprobe_sym);
 	}
 
+	if (cache_usable)
+		symbol_cache_add(sb.st_dev, sb.st_ino, sb.st_mtime,
+				 sym->symbol, uprobe_sym->isret, uprobe_sym);
+
 	return uprobe_sym;
 
 invalid:
+	if (cache_usable && cache_negative)
+		symbol_cache_add(sb.st_dev, sb.st_ino, sb.st_mtime,
+				 sym->symbol, sym->is_probe_ret, NULL);
 	free_uprobe_symbol(uprobe_sym, NULL);
 	return NULL;
 }
@@ -65,6 +65,7 @@ struct symbol_uprobe {
 
 struct symbol_kprobe {
 	bool isret;		// only use kprobe
+	bool in_probe;		// 是否已创建probe对象
 	char *symbol;		// only use uprobe
 	char *func;
 };
@@ -79,6 +80,14 @@ void add_uprobe_symbol(int pid, struct symbol_uprobe *u_sym,
 		       struct tracer_probes_conf *conf);
 int copy_uprobe_symbol(struct symbol_uprobe *src, struct symbol_uprobe *dst);
 char *get_elf_path_by_pid(int pid);
+/*
+ * /proc元数据缓存接口。get系列未命中时读procfs填充，proc_meta_evict
+ * 由exec/exit事件调用使pid的缓存失效。
+ */
+unsigned long long proc_meta_get_starttime(int pid);
+bool proc_meta_is_process(int pid);
+char *proc_meta_get_elf_path(int pid);
+void proc_meta_evict(int pid);
 struct symbol_uprobe *resolve_and_gen_uprobe_symbol(const char *bin_file,
 						    struct symbol *sym,
 						    const uint64_t addr,
@@ -76,13 +76,219 @@ bool bpf_table_get_value(struct bpf_tracer * tracer,
 	return true;
 }
 
+/* ==========================================================
+ * 批量map操作
+ *
+ * 依赖Linux 5.6+的BPF_MAP_LOOKUP_BATCH/BPF_MAP_UPDATE_BATCH/
+ * BPF_MAP_DELETE_BATCH命令，一次syscall处理一批表项。内核不支持
+ * 时返回ETR_NOTSUPP，调用方回退到bpf_map_get_next_key()逐条遍历。
+ * ==========================================================
+ */
+
+// 一次批量syscall处理的表项数量
+#define TABLE_BATCH_NUM 256
+
+// 批量命令不被内核支持时的错误返回（老内核为EINVAL）
+static inline bool batch_unsupported(int err)
+{
+	int e = (err < -1) ? -err : errno;
+	return (e == EINVAL || e == ENOTSUP || e == 524 /* ENOTSUPP */ );
+}
+
+int bpf_table_delete_batch(struct bpf_tracer *tracer,
+			   const char *tb_name, void *keys, uint32_t *count)
+{
+	struct bpf_map *map =
+	    bpf_object__find_map_by_name(tracer->pobj, tb_name);
+	int map_fd = bpf_map__fd(map);
+	DECLARE_LIBBPF_OPTS(bpf_map_batch_opts, opts);
+
+	int err = bpf_map_delete_batch(map_fd, keys, count, &opts);
+	if (err) {
+		if (batch_unsupported(err))
+			return ETR_NOTSUPP;
+
+		ebpf_warning("[%s] err tb_name:%s, err_message:%s\n",
+			     __func__, tb_name, strerror(errno));
+		return ETR_SYSCALL;
+	}
+
+	return ETR_OK;
+}
+
+int bpf_table_update_batch(struct bpf_tracer *tracer,
+			   const char *tb_name, void *keys, void *values,
+			   uint32_t *count)
+{
+	struct bpf_map *map =
+	    bpf_object__find_map_by_name(tracer->pobj, tb_name);
+	int map_fd = bpf_map__fd(map);
+	DECLARE_LIBBPF_OPTS(bpf_map_batch_opts, opts);
+
+	int err = bpf_map_update_batch(map_fd, keys, values, count, &opts);
+	if (err) {
+		if (batch_unsupported(err))
+			return ETR_NOTSUPP;
+
+		ebpf_warning("[%s] err tb_name:%s, err_message:%s\n",
+			     __func__, tb_name, strerror(errno));
+		return ETR_SYSCALL;
+	}
+
+	return ETR_OK;
+}
+
+int bpf_table_reclaim_batch(struct bpf_tracer *tracer,
+			    const char *tb_name, tb_expired_fn is_expired,
+			    void *arg, uint32_t *reclaim_count)
+{
+	struct bpf_map *map =
+	    bpf_object__find_map_by_name(tracer->pobj, tb_name);
+	int map_fd = bpf_map__fd(map);
+	uint32_t key_size = bpf_table_key_size(map);
+	uint32_t value_size = bpf_table_value_size(map);
+	if (key_size == 0 || value_size == 0)
+		return ETR_INVAL;
+
+	// 批量遍历的位置标识，内核要求与key大小一致
+	uint32_t batch_size = key_size > 8 ? key_size : 8;
+	void *in_batch = NULL, *out_batch = NULL;
+	void *keys = NULL, *values = NULL, *del_keys = NULL;
+	uint32_t count, del_nr, total = 0;
+	int i, err, ret = ETR_OK;
+	bool first = true;
+	DECLARE_LIBBPF_OPTS(bpf_map_batch_opts, opts);
+
+	in_batch = malloc(batch_size);
+	out_batch = malloc(batch_size);
+	keys = malloc((uint64_t) key_size * TABLE_BATCH_NUM);
+	values = malloc((uint64_t) value_size * TABLE_BATCH_NUM);
+	del_keys = malloc((uint64_t) key_size * TABLE_BATCH_NUM);
+	if (!in_batch || !out_batch || !keys || !values || !del_keys) {
+		ebpf_warning("[%s] malloc() error.\n", __func__);
+		ret = ETR_NOMEM;
+		goto exit;
+	}
+
+	for (;;) {
+		count = TABLE_BATCH_NUM;
+		err = bpf_map_lookup_batch(map_fd, first ? NULL : in_batch,
+					   out_batch, keys, values, &count,
+					   &opts);
+		if (err && first && batch_unsupported(err)) {
+			ret = ETR_NOTSUPP;
+			goto exit;
+		}
+
+		// ENOENT表示已经遍历到表尾，本次返回的count仍然有效
+		if (err && errno != ENOENT && -err != ENOENT) {
+			ebpf_warning("[%s] err tb_name:%s, err_message:%s\n",
+				     __func__, tb_name, strerror(errno));
+			ret = ETR_SYSCALL;
+			goto exit;
+		}
+
+		del_nr = 0;
+		for (i = 0; i < count; i++) {
+			if (is_expired((uint8_t *) values +
+				       (uint64_t) i * value_size, arg)) {
+				memcpy((uint8_t *) del_keys +
+				       (uint64_t) del_nr * key_size,
+				       (uint8_t *) keys +
+				       (uint64_t) i * key_size, key_size);
+				del_nr++;
+			}
+		}
+
+		if (del_nr > 0) {
+			uint32_t del_count = del_nr;
+			if (bpf_map_delete_batch
+			    (map_fd, del_keys, &del_count, &opts) == 0)
+				total += del_count;
+		}
+
+		if (err)	/* ENOENT, 遍历结束 */
+			break;
+
+		memcpy(in_batch, out_batch, batch_size);
+		first = false;
+	}
+
+exit:
+	free(in_batch);
+	free(out_batch);
+	free(keys);
+	free(values);
+	free(del_keys);
+
+	if (ret == ETR_OK && reclaim_count != NULL)
+		*reclaim_count = total;
+
+	return ret;
+}
+
+/*
+ * 遍历计数表项数量。占用率检查优先使用内核侧维护的计数
+ * （trace_stats_map中的socket_map_count/trace_map_count，经
+ * bpf_stats_map_collect()一次lookup取得），本接口保留用于调试和
+ * 校验场景：内核5.6+用批量遍历（每TABLE_BATCH_NUM项一次syscall），
+ * 否则退化为bpf_map_get_next_key()逐key遍历。
+ */
 uint32_t bpf_table_elems_count(struct bpf_tracer * tracer, const char *tb_name)
 {
 	struct bpf_map *map =
 	    bpf_object__find_map_by_name(tracer->pobj, tb_name);
 	int map_fd = bpf_map__fd(map);
+	uint32_t key_size = bpf_table_key_size(map);
+	uint32_t value_size = bpf_table_value_size(map);
+
+	if (key_size > 0 && value_size > 0) {
+		uint32_t batch_size = key_size > 8 ? key_size : 8;
+		void *in_batch = malloc(batch_size);
+		void *out_batch = malloc(batch_size);
+		void *keys = malloc((uint64_t) key_size * TABLE_BATCH_NUM);
+		void *values = malloc((uint64_t) value_size * TABLE_BATCH_NUM);
+		uint32_t batch_count, total = 0;
+		bool first = true, batch_ok;
+		int err;
+		DECLARE_LIBBPF_OPTS(bpf_map_batch_opts, opts);
+
+		batch_ok = (in_batch && out_batch && keys && values);
+		while (batch_ok) {
+			batch_count = TABLE_BATCH_NUM;
+			err = bpf_map_lookup_batch(map_fd,
+						   first ? NULL : in_batch,
+						   out_batch, keys, values,
+						   &batch_count, &opts);
+			if (err && first && batch_unsupported(err)) {
+				batch_ok = false;
+				break;
+			}
 
-	//int key_size = bpf_table_key_size(map);
+			// ENOENT表示已经遍历到表尾，本次返回的count仍然有效
+			if (err && errno != ENOENT && -err != ENOENT) {
+				batch_ok = false;
+				break;
+			}
+
+			total += batch_count;
+			if (err)	/* ENOENT, 遍历结束 */
+				break;
+
+			memcpy(in_batch, out_batch, batch_size);
+			first = false;
+		}
+
+		free(in_batch);
+		free(out_batch);
+		free(keys);
+		free(values);
+
+		if (batch_ok)
+			return total;
+	}
+
+	// 旧内核fallback：逐key遍历，每个表项一次syscall
 	uint64_t key, next_key, count = 0;
 	key = 0;
 	while (bpf_map_get_next_key(map_fd, &key, &next_key) == 0) {
@@ -109,3 +315,38 @@ bool bpf_table_set_value(struct bpf_tracer * tracer,
 
 	return true;
 }
+
+bool bpf_table_delete_key(struct bpf_tracer * tracer,
+			  const char *tb_name, uint64_t key)
+{
+	struct bpf_map *map =
+	    bpf_object__find_map_by_name(tracer->pobj, tb_name);
+	int map_fd = bpf_map__fd(map);
+
+	if (bpf_map_delete_elem(map_fd, &key) != 0) {
+		ebpf_warning("[%s] bpf_map_delete_elem, err tb_name:%s, key : %"
+			     PRIu64 ", err_message:%s\n", __func__, tb_name,
+			     key, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+// 清空整个表，返回删除的表项数量
+uint32_t bpf_table_clear(struct bpf_tracer * tracer, const char *tb_name)
+{
+	struct bpf_map *map =
+	    bpf_object__find_map_by_name(tracer->pobj, tb_name);
+	int map_fd = bpf_map__fd(map);
+	uint64_t next_key = 0;
+	uint32_t count = 0;
+
+	while (bpf_map_get_next_key(map_fd, NULL, &next_key) == 0) {
+		if (bpf_map_delete_elem(map_fd, &next_key) != 0)
+			break;
+		count++;
+	}
+
+	return count;
+}
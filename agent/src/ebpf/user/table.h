@@ -29,6 +29,24 @@ bool bpf_table_get_value(struct bpf_tracer *tracer,
                          void *val_buf);
 bool bpf_table_set_value(struct bpf_tracer * tracer,
                          const char *tb_name, uint64_t key, void *val_buf);
+bool bpf_table_delete_key(struct bpf_tracer * tracer,
+			  const char *tb_name, uint64_t key);
+uint32_t bpf_table_clear(struct bpf_tracer * tracer, const char *tb_name);
 uint32_t bpf_table_elems_count(struct bpf_tracer * tracer,
 			       const char *tb_name);
+
+/*
+ * 批量map操作（Linux 5.6+ BPF_MAP_*_BATCH）。
+ * 返回ETR_NOTSUPP表示内核不支持，调用方回退到逐条遍历。
+ */
+int bpf_table_delete_batch(struct bpf_tracer *tracer,
+			   const char *tb_name, void *keys, uint32_t *count);
+int bpf_table_update_batch(struct bpf_tracer *tracer,
+			   const char *tb_name, void *keys, void *values,
+			   uint32_t *count);
+// 表项超时判断回调，返回true表示需要回收
+typedef bool (*tb_expired_fn) (void *value, void *arg);
+int bpf_table_reclaim_batch(struct bpf_tracer *tracer,
+			    const char *tb_name, tb_expired_fn is_expired,
+			    void *arg, uint32_t *reclaim_count);
 #endif
@@ -20,6 +20,8 @@
 #include <sched.h>
 #include <sys/utsname.h>
 #include <sys/prctl.h>
+#include <sys/eventfd.h>
+#include <zlib.h>
 #include "probe.h"
 #include "table.h"
 #include "common.h"
@@ -29,6 +31,8 @@
 #include "libbpf/src/libbpf_internal.h"
 #include "symbol.h"
 #include "tracer.h"
+#include "shm_stats.h"
+#include "profiler.h"
 
 int major, minor;		// Linux kernel主版本，次版本
 
@@ -54,7 +58,7 @@ static pthread_t cpus_kick_pthread;
 /*
  * 用于额外事务处理, 目前利用这个机制来实现socket_trace的内核结构偏移推断。
  */
-static volatile int ready_flag_cpus[MAX_CPU_NR];
+static volatile int *ready_flag_cpus;	// 按实际CPU数在bpf_tracer_init()分配
 
 static struct list_head extra_waiting_head;	// 额外事务处理的注册
 
@@ -64,6 +68,84 @@ static struct list_head period_events_head;	// 周期性事件处理的注册
 int sys_cpus_count;
 bool *cpu_online;		// 用于判断CPU是否是online
 
+/*
+ * NUMA拓扑：各CPU所属节点在bpf_tracer_init()里读取sysfs缓存一次。
+ * 单节点系统numa_nodes_nr为1，所有NUMA放置逻辑退化为无操作。
+ */
+static int numa_nodes_nr = 1;
+static int8_t cpu_to_numa[MAX_CPU_NR];
+__thread int thread_numa_node = -1;
+
+/*
+ * perf ring-buffer读取方式, 默认使用单线程轮询的方式。
+ */
+static enum perf_reader_mode perf_rd_mode = PERF_READER_MODE_SINGLE;
+
+/*
+ * 读取线程在阻塞等待前的busy-poll窗口（微秒）。最近消费到数据后
+ * 的这段时间内持续在用户态轮询，保证高速率时的亚毫秒延迟；窗口
+ * 内持续无数据则进入epoll_wait()阻塞，空闲时不占用CPU。
+ * 0表示不busy-poll，无数据直接阻塞等待。
+ */
+static uint32_t perf_busy_poll_us;
+
+/*
+ * 自适应perf buffer大小。流量在CPU间高度不均（IRQ定向的网络CPU
+ * 溢出而大多数CPU的buffer闲置），统一按配置页数分配在大机器上
+ * 浪费大量锁定内存。开启后每CPU从小buffer起步，按丢失事件反馈
+ * 翻倍增长（受全局页预算限制），空闲的CPU减半收缩，让页预算流
+ * 向真正有流量的CPU。
+ */
+static bool perf_adaptive_sizing = true;
+#define PERF_PAGES_MIN		8	// 每CPU起步/最小页数（2的次幂）
+#define PERF_PAGES_MAX		1024	// 每CPU上限
+#define PERF_ADJUST_INTERVAL_NS	(5 * NANOSEC_PER_SEC)
+// 一个调整周期内读出的事件数低于该值认为该CPU空闲
+#define PERF_IDLE_EVENTS	128
+static uint32_t perf_pages_budget;	// 全部CPU合计页数预算，0为配置页数*读者数
+static volatile int64_t perf_pages_inuse;	// 当前已分配页数
+
+/*
+ * dispatch队列间的work stealing。flow哈希不均时（例如单个大流打满
+ * 一个队列），空闲的worker帮助积压的兄弟队列消费。
+ */
+static bool dispatch_steal_enabled = true;
+
+// 队列积压超过该值时，生产者唤醒相邻队列的worker前来偷取
+#define QUEUE_STEAL_WATERMARK (MAX_PKT_BURST * 4)
+
+/*
+ * 弹性worker：队列/线程按dispatch_workers_nr预创建（不参与分发的
+ * worker park在eventfd上，只占内存），周期线程按队列深度调整参与
+ * 新flow分发的worker数（dispatch_workers_active）。深度连续越过高
+ * 水位则扩容，全部队列连续接近空则缩容。
+ */
+static bool dispatch_autoscale_enabled = true;
+static struct bpf_tracer *autoscale_tracer;
+static int autoscale_high_ticks;
+static int autoscale_idle_ticks;
+
+// 高水位：任一队列深度达到ring容量的一半
+#define AUTOSCALE_HIGH_WM(q) ((q)->ring_size >> 1)
+// 低水位：全部队列深度合计不足一个burst
+#define AUTOSCALE_LOW_WM MAX_PKT_BURST
+#define AUTOSCALE_UP_TICKS 2	// 扩容需连续越过高水位的周期数
+#define AUTOSCALE_DOWN_TICKS 30	// 缩容需连续低于低水位的周期数
+
+/*
+ * 消费worker park在eventfd之前的spin窗口（微秒）。spin期间数据到来
+ * 无需任何唤醒动作，0表示队列一空立即park。
+ */
+static uint32_t worker_spin_us;
+
+/*
+ * perf记录零拷贝消费。开启后socket_bpf_data的cap_data直接指向perf
+ * mmap区域（data_tail延迟到burst处理完成后推进），省去payload在用户
+ * 态的再次拷贝。仅对perf buffer通道生效，ringbuf记录在回调返回后即
+ * 被释放，必须拷贝。
+ */
+static bool perf_zero_copy = true;
+
 // 所有tracer成功完成启动，会被应用设置为1
 static volatile uint64_t all_probes_ready;
 
@@ -155,10 +237,6 @@ struct bpf_tracer *create_bpf_tracer(const char *name,
 	memset(bt, 0, sizeof(*bt));
 	atomic64_init(&bt->lost);
 
-	int i;
-	for (i = 0; i < PROTO_NUM; i++)
-		atomic64_init(&bt->proto_status[i]);
-
 	snprintf(bt->bpf_load_name, sizeof(bt->bpf_load_name), "%s", load_name);
 	bt->tps = tps;
 	bt->buffer_ptr = bpf_bin_buffer;
@@ -167,6 +245,42 @@ struct bpf_tracer *create_bpf_tracer(const char *name,
 	snprintf(bt->name, sizeof(bt->name), "%s", name);
 	bt->dispatch_workers_nr = workers_nr;
 
+	/*
+	 * worker/队列/读者数组按实际CPU数分配。bpf_tracer_init()未执行
+	 * 时（单元测试/bench直接调用本函数）回退到sysconf探测。
+	 */
+	int cpus = sys_cpus_count;
+	if (cpus <= 0)
+		cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (cpus <= 0)
+		cpus = 1;
+	if (workers_nr > cpus)
+		cpus = workers_nr;
+
+	bt->perf_worker = calloc(cpus, sizeof(pthread_t));
+	bt->dispatch_workers = calloc(workers_nr, sizeof(pthread_t));
+	bt->readers = calloc(cpus, sizeof(struct perf_reader *));
+	bt->readers_cpu = calloc(cpus, sizeof(int));
+	// 队列含per-role cacheline隔离的计数器组，保持64字节对齐
+	if (posix_memalign((void **)&bt->queues, CACHE_LINE_BYTES,
+			   workers_nr * sizeof(struct queue)) != 0)
+		bt->queues = NULL;
+
+	if (bt->perf_worker == NULL || bt->dispatch_workers == NULL ||
+	    bt->readers == NULL || bt->readers_cpu == NULL ||
+	    bt->queues == NULL) {
+		ebpf_warning("Tracer '%s' faild, no memory!", name);
+		free(bt->perf_worker);
+		free(bt->dispatch_workers);
+		free(bt->readers);
+		free(bt->readers_cpu);
+		free(bt->queues);
+		free(bt);
+		return NULL;
+	}
+
+	memset(bt->queues, 0, workers_nr * sizeof(struct queue));
+
 	tracers[tracers_count++] = bt;
 	bt->process_fn = handle;
 
@@ -179,6 +293,8 @@ struct bpf_tracer *create_bpf_tracer(const char *name,
 
 	INIT_LIST_HEAD(&bt->probes_head);
 	INIT_LIST_HEAD(&bt->maps_conf_head);
+	for (int i = 0; i < PROBES_PID_HASH_BUCKETS; i++)
+		INIT_HLIST_HEAD(&bt->probes_pid_hash[i]);
 
 	pthread_mutex_init(&bt->mutex_probes_lock, NULL);
 
@@ -197,29 +313,73 @@ static int map_resize_set(struct bpf_object *pobj, struct map_config *m_conf)
 	return bpf_map__resize(map, m_conf->max_entries);
 }
 
+/*
+ * 嵌入的eBPF字节码为zlib压缩格式（见tools/ebpftobuffer.c），头部
+ * 4字节魔数"EBPZ" + 4字节原始长度（小端）。仅被选中加载的那份在
+ * 此解压，其余版本保持压缩状态存放。无魔数的buffer（老格式或测试
+ * 数据）返回NULL，调用方直接使用原buffer。
+ */
+static void *ebpf_buffer_decompress(void *buf, int size, int *out_size)
+{
+	uint8_t *p = (uint8_t *) buf;
+	if (size <= 8 || memcmp(p, "EBPZ", 4) != 0)
+		return NULL;
+
+	uint32_t orig_size = (uint32_t) p[4] | (uint32_t) p[5] << 8 |
+	    (uint32_t) p[6] << 16 | (uint32_t) p[7] << 24;
+	void *out = malloc(orig_size);
+	if (out == NULL) {
+		ebpf_warning("malloc() error.\n");
+		return NULL;
+	}
+
+	uLongf dst_len = orig_size;
+	if (uncompress(out, &dst_len, p + 8, size - 8) != Z_OK ||
+	    dst_len != orig_size) {
+		ebpf_warning("eBPF buffer uncompress() faild.\n");
+		free(out);
+		return NULL;
+	}
+
+	*out_size = (int)orig_size;
+	return out;
+}
+
 int tracer_bpf_load(struct bpf_tracer *tracer)
 {
 	struct bpf_object *pobj;
 	int ret;
-	pobj = bpf_object__open_buffer(tracer->buffer_ptr,
-				       tracer->buffer_sz,
+	void *buffer = tracer->buffer_ptr;
+	int buffer_sz = tracer->buffer_sz;
+
+	// 解压选中的字节码到临时buffer，加载完成后释放
+	void *scratch = ebpf_buffer_decompress(buffer, buffer_sz, &buffer_sz);
+	if (scratch != NULL)
+		buffer = scratch;
+
+	pobj = bpf_object__open_buffer(buffer, buffer_sz,
 				       tracer->bpf_load_name);
 	if (IS_ERR_OR_NULL(pobj)) {
 		ebpf_info("bpf_object__open_buffer \"%s\" failed, error:%s\n",
 			  tracer->bpf_load_name, strerror(errno));
+		free(scratch);
 		return -ENOENT;
 	}
 
 	struct map_config *m_conf;
 	list_for_each_entry(m_conf, &tracer->maps_conf_head, list) {
-		if ((ret = map_resize_set(pobj, m_conf)))
+		if ((ret = map_resize_set(pobj, m_conf))) {
+			free(scratch);
 			return ret;
+		}
 
 		ebpf_info("map_resize_set \"%s\" map. max_entries:%d\n",
 			  m_conf->map_name, m_conf->max_entries);
 	}
 
 	ret = bpf_object__load(pobj);
+	// 打开的ELF在load期间仍引用buffer，load结束后才能释放
+	free(scratch);
 	if (ret != 0) {
 		ebpf_info("bpf load \"%s\" failed, error:%s\n",
 			  tracer->bpf_load_name, strerror(errno));
@@ -274,8 +434,14 @@ static struct tracepoint *get_tracepoint_from_tracer(struct bpf_tracer *tracer,
 void add_probe_to_tracer(struct probe *pb)
 {
 	struct bpf_tracer *tracer = pb->tracer;
-	if (pb->type == UPROBE && pb->private_data != NULL)
-		((struct symbol_uprobe *)pb->private_data)->in_probe = true;
+	if (pb->type == UPROBE && pb->private_data != NULL) {
+		struct symbol_uprobe *sym_u = pb->private_data;
+		sym_u->in_probe = true;
+		// 与probes_head并行维护pid哈希索引，按pid查找O(1)
+		hlist_add_head(&pb->pid_hash,
+			       &tracer->probes_pid_hash[probe_pid_bucket
+							(sym_u->pid)]);
+	}
 
 	list_add_tail(&pb->list, &tracer->probes_head);
 	tracer->probes_count++;
@@ -289,6 +455,8 @@ void free_probe_from_tracer(struct probe *pb)
 		free_uprobe_symbol(sym_u, tracer->tps);
 	}
 
+	if (!hlist_unhashed(&pb->pid_hash))
+		hlist_del_init(&pb->pid_hash);
 	list_head_del(&pb->list);
 	tracer->probes_count--;
 	free(pb);
@@ -400,7 +568,7 @@ static struct bpf_link *exec_attach_kprobe(struct bpf_program *prog, char *name,
 	return link;
 }
 
-static int probe_attach(struct probe *p)
+int probe_attach(struct probe *p)
 {
 	if (p->link || p->installed) {
 		return ETR_EXIST;
@@ -528,6 +696,72 @@ static int tracepoint_detach(struct tracepoint *tp)
 	return ETR_OK;
 }
 
+/*
+ * probe的并行attach/detach。每个uprobe都是一次perf_event_open+ioctl
+ * 往返，Go进程动辄数十个符号，串行处理在大量进程场景下需要分钟级
+ * 时间。probe之间相互独立，worker按下标领取并行执行；对probes链表
+ * 的修改（失败项清理）仍由调用线程串行完成，mutex_probes_lock语义
+ * 不变。
+ */
+#define PROBE_TASK_WORKERS_MAX 8
+
+struct probe_task_ctx {
+	struct probe **probes;
+	int *errors;
+	int nr;
+	volatile int next;	// worker用fetch-add领取下一个下标
+	int (*fn) (struct probe * p);
+};
+
+static void *probe_task_worker(void *arg)
+{
+	struct probe_task_ctx *ctx = arg;
+	int i;
+
+	prctl(PR_SET_NAME, "probe-worker");
+	for (;;) {
+		i = __sync_fetch_and_add(&ctx->next, 1);
+		if (i >= ctx->nr)
+			break;
+		ctx->errors[i] = ctx->fn(ctx->probes[i]);
+	}
+
+	return NULL;
+}
+
+static void probe_tasks_run(struct probe **probes, int *errors, int nr,
+			    int (*fn) (struct probe * p))
+{
+	int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers > PROBE_TASK_WORKERS_MAX)
+		workers = PROBE_TASK_WORKERS_MAX;
+	if (workers > nr)
+		workers = nr;
+
+	struct probe_task_ctx ctx = {
+		.probes = probes,
+		.errors = errors,
+		.nr = nr,
+		.next = 0,
+		.fn = fn,
+	};
+
+	pthread_t threads[PROBE_TASK_WORKERS_MAX];
+	int i, created = 0;
+	for (i = 0; i < workers - 1; i++) {
+		if (pthread_create(&threads[i], NULL, probe_task_worker,
+				   &ctx) != 0)
+			break;
+		created++;
+	}
+
+	// 调用线程也参与消费；线程创建失败时自然退化为串行
+	probe_task_worker(&ctx);
+
+	for (i = 0; i < created; i++)
+		pthread_join(threads[i], NULL);
+}
+
 int tracer_hooks_process(struct bpf_tracer *tracer, enum tracer_hook_type type,
 			 int *probes_count)
 {
@@ -548,13 +782,31 @@ int tracer_hooks_process(struct bpf_tracer *tracer, enum tracer_hook_type type,
 	}
 
 	struct probe *p;
-	int error, count = 0;
+	int error, count = 0, nr = 0, i;
 	struct list_head *c, *n;
+	int pending_max = tracer->probes_count;
+	struct probe **pending = NULL;
+	int *errors = NULL;
+
+	if (pending_max > 0) {
+		pending = calloc(pending_max, sizeof(*pending));
+		errors = calloc(pending_max, sizeof(*errors));
+		if (pending == NULL || errors == NULL) {
+			ebpf_warning("calloc() error.\n");
+			free(pending);
+			free(errors);
+			return ETR_NOMEM;
+		}
+	}
 
+	// 第一遍只收集待处理probe，执行交给worker并行完成
 	list_for_each_safe(c, n, &tracer->probes_head) {
 		p = container_of(c, struct probe, list);
-		if (!p)
+		if (!p) {
+			free(pending);
+			free(errors);
 			return ETR_INVAL;
+		}
 
 		if (tracer->probes_count > OPEN_FILES_MAX) {
 			ebpf_warning
@@ -563,7 +815,18 @@ int tracer_hooks_process(struct bpf_tracer *tracer, enum tracer_hook_type type,
 			break;
 		}
 
-		error = probe_fun(p);
+		if (nr >= pending_max)
+			break;
+
+		pending[nr++] = p;
+	}
+
+	if (nr > 0)
+		probe_tasks_run(pending, errors, nr, probe_fun);
+
+	for (i = 0; i < nr; i++) {
+		p = pending[i];
+		error = errors[i];
 		if (type == HOOK_ATTACH && error == ETR_EXIST)
 			continue;
 
@@ -586,6 +849,9 @@ int tracer_hooks_process(struct bpf_tracer *tracer, enum tracer_hook_type type,
 		count++;
 	}
 
+	free(pending);
+	free(errors);
+
 	if (probes_count != NULL)
 		*probes_count = count;
 
@@ -641,6 +907,7 @@ int tracer_probes_init(struct bpf_tracer *tracer)
 				 tps->ksymbols[i].isret, KPROBE, NULL);
 		if (!p)
 			return ETR_INVAL;
+		tps->ksymbols[i].in_probe = true;
 	}
 
 	list_for_each_entry(usym, &tps->uprobe_syms_head, list) {
@@ -653,6 +920,58 @@ int tracer_probes_init(struct bpf_tracer *tracer)
 	return 0;
 }
 
+/*
+ * 为conf中尚未创建probe的kprobe符号补建probe对象（运行时增量
+ * 启用探针组时使用），与tracer_uprobes_update()对应。
+ */
+int tracer_kprobes_update(struct bpf_tracer *tracer)
+{
+	struct probe *p;
+	struct tracer_probes_conf *tps;
+	int i;
+
+	if (!tracer || tracer->tps == NULL)
+		return ETR_INVAL;
+
+	tps = tracer->tps;
+	for (i = 0; i < tps->kprobes_nr; ++i) {
+		if (tps->ksymbols[i].in_probe)
+			continue;
+		p = create_probe(tracer, tps->ksymbols[i].func,
+				 tps->ksymbols[i].isret, KPROBE, NULL);
+		if (!p)
+			return ETR_INVAL;
+		tps->ksymbols[i].in_probe = true;
+	}
+
+	return 0;
+}
+
+/*
+ * 按名称附着/解除单个tracepoint，供按能力组增量启停探针使用。
+ * 重复附着/解除视为成功。
+ */
+int tracer_tracepoint_process(struct bpf_tracer *tracer, const char *tp_name,
+			      enum tracer_hook_type type)
+{
+	struct tracepoint *tp = get_tracepoint_from_tracer(tracer, tp_name);
+	if (!tp)
+		return ETR_INVAL;
+
+	int error;
+	if (type == HOOK_ATTACH)
+		error = tracepoint_attach(tp);
+	else if (type == HOOK_DETACH)
+		error = tracepoint_detach(tp);
+	else
+		return ETR_INVAL;
+
+	if (error == ETR_EXIST || error == ETR_NOTEXIST)
+		return ETR_OK;
+
+	return error;
+}
+
 int tracer_uprobes_update(struct bpf_tracer *tracer)
 {
 	struct probe *p;
@@ -701,6 +1020,9 @@ int perf_map_init(struct bpf_tracer *tracer, const char *perf_map_name)
 	int perf_fd, ret;
 	int i;
 	int pages_cnt = tracer->perf_pages_cnt;
+	// 自适应模式下从小buffer起步，丢事件的CPU随后按反馈增长
+	if (perf_adaptive_sizing && pages_cnt > PERF_PAGES_MIN)
+		pages_cnt = PERF_PAGES_MIN;
 	for (i = 0; i < sys_cpus_count; i++) {
 		if (!cpu_online[i])
 			continue;
@@ -717,9 +1039,49 @@ int perf_map_init(struct bpf_tracer *tracer, const char *perf_map_name)
 			     __func__);
 			return ret;
 		}
+		if (perf_zero_copy && perf_reader_set_zero_copy(reader))
+			ebpf_warning
+			    ("[%s] set zero-copy failed, cpu:%d, fallback to copy mode.\n",
+			     __func__, i);
+
+		tracer->readers_cpu[tracer->readers_count] = i;
 		tracer->readers[tracer->readers_count++] = reader;
 	}
 
+	if (perf_pages_budget == 0)
+		perf_pages_budget =
+		    (uint32_t) tracer->perf_pages_cnt * tracer->readers_count;
+	perf_pages_inuse = (int64_t) pages_cnt * tracer->readers_count;
+
+	tracer->data_map = map;
+
+	return ETR_OK;
+}
+
+/*
+ * ringbuf记录消费回调，适配到tracer->raw_cb。
+ * ringbuf模式下数据丢失发生在内核reserve失败时，没有用户态丢失回调。
+ */
+static int ringbuf_sample_cb(void *ctx, void *data, size_t size)
+{
+	struct bpf_tracer *tracer = (struct bpf_tracer *)ctx;
+	tracer->raw_cb((void *)tracer, data, size);
+	return 0;
+}
+
+int ringbuf_map_init(struct bpf_tracer *tracer, const char *rb_map_name)
+{
+	struct bpf_map *map =
+	    bpf_object__find_map_by_name(tracer->pobj, rb_map_name);
+	int map_fd = bpf_map__fd(map);
+
+	tracer->rb = bpf_new_ringbuf(map_fd, ringbuf_sample_cb, (void *)tracer);
+	if (tracer->rb == NULL) {
+		ebpf_warning("[%s] bpf_new_ringbuf() failed, map name:%s\n",
+			     __func__, rb_map_name);
+		return ETR_INVAL;
+	}
+
 	tracer->data_map = map;
 
 	return ETR_OK;
@@ -740,14 +1102,134 @@ __always_inline uint64_t clib_cpu_time_now(void)
 }
 #endif
 
+/*
+ * 按丢失事件反馈调整各CPU ring大小：周期内有丢失则翻倍（受全局页
+ * 预算限制），几乎没读到数据则减半。由消费线程自己调用，resize发
+ * 生在两次读取之间（percpu模式下每个线程只调整自己的reader，预算
+ * 以原子方式全局记账）。
+ */
+static void perf_readers_adjust(int num_readers, struct perf_reader **readers,
+				uint64_t * last_lost, uint64_t * last_rd)
+{
+	int i, target, delta;
+	uint64_t lost, rd;
+	struct perf_reader *r;
+
+	for (i = 0; i < num_readers; i++) {
+		r = readers[i];
+		// 上次resize两个mmap都失败的reader没有映射，先按原大小
+		// 重建再谈调整，避免它停留在不可读状态
+		if (r->base == NULL) {
+			if (perf_reader_resize(r, r->page_cnt) == 0)
+				ebpf_info
+				    ("perf buffer remapped, %d pages.\n",
+				     r->page_cnt);
+			continue;
+		}
+
+		lost = r->lost_nr - last_lost[i];
+		rd = r->rd_events - last_rd[i];
+		last_lost[i] = r->lost_nr;
+		last_rd[i] = r->rd_events;
+
+		target = r->page_cnt;
+		if (lost > 0 && r->page_cnt < PERF_PAGES_MAX)
+			target = r->page_cnt * 2;
+		else if (lost == 0 && rd < PERF_IDLE_EVENTS &&
+			 r->page_cnt > PERF_PAGES_MIN)
+			target = r->page_cnt / 2;
+
+		if (target == r->page_cnt)
+			continue;
+
+		delta = target - r->page_cnt;
+		if (delta > 0 &&
+		    __sync_add_and_fetch(&perf_pages_inuse, delta) >
+		    (int64_t) perf_pages_budget) {
+			// 预算耗尽，本周期放弃增长
+			__sync_sub_and_fetch(&perf_pages_inuse, delta);
+			continue;
+		}
+
+		if (perf_reader_resize(r, target) == 0) {
+			if (delta < 0)
+				__sync_add_and_fetch(&perf_pages_inuse, delta);
+			ebpf_info
+			    ("perf buffer resize %d -> %d pages (period lost:%"
+			     PRIu64 " read:%" PRIu64 ", inuse:%" PRId64
+			     "/%u pages)\n", target - delta, target, lost, rd,
+			     perf_pages_inuse, perf_pages_budget);
+		} else if (delta > 0) {
+			// 本次没能调整（如有在途记录），退回预算下次再试
+			__sync_sub_and_fetch(&perf_pages_inuse, delta);
+		}
+	}
+}
+
+/*
+ * 事件驱动的perf buffer读取。数据到来由epoll_wait()唤醒，唤醒后在
+ * busy-poll窗口内持续消费，避免每个事件都付出一次陷入内核的代价。
+ */
+static void reader_event_loop(int num_readers, struct perf_reader **readers)
+{
+	uint64_t deadline = 0, now;
+	uint64_t adj_deadline = 0, iters = 0;
+	uint64_t last_lost[num_readers], last_rd[num_readers];
+	int nr, epoll_fd = perf_reader_epoll_new(num_readers, readers);
+	if (epoll_fd < 0) {
+		ebpf_warning
+		    ("perf_reader_epoll_new() failed, error:%s, use poll().\n",
+		     strerror(errno));
+		for (;;)
+			perf_reader_poll(num_readers, readers, 500);
+	}
+
+	memset(last_lost, 0, sizeof(last_lost));
+	memset(last_rd, 0, sizeof(last_rd));
+	adj_deadline = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) +
+	    PERF_ADJUST_INTERVAL_NS;
+
+	for (;;) {
+		nr = perf_reader_consume(num_readers, readers);
+		if (nr == 0) {
+			now = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+			if (now < deadline) {
+				__pause();
+				continue;
+			}
+
+			nr = perf_reader_epoll_wait(epoll_fd, num_readers, 500);
+		}
+
+		if (nr > 0 && perf_busy_poll_us > 0)
+			deadline = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) +
+			    (uint64_t) perf_busy_poll_us * 1000;
+
+		/*
+		 * 周期性的buffer大小调整。空闲时每次epoll超时后检查；
+		 * 高负载下consume持续返回数据，按迭代计数限频取时间戳。
+		 */
+		if (perf_adaptive_sizing &&
+		    (nr == 0 || (++iters & 0x3ff) == 0)) {
+			now = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+			if (now >= adj_deadline) {
+				perf_readers_adjust(num_readers, readers,
+						    last_lost, last_rd);
+				adj_deadline = now + PERF_ADJUST_INTERVAL_NS;
+			}
+		}
+	}
+	/* never reached */
+}
+
 static void poller(void *t)
 {
 	prctl(PR_SET_NAME, "perf-reader");
 	struct bpf_tracer *tracer = (struct bpf_tracer *)t;
-	for (;;) {
 #ifndef PERFORMANCE_TEST
-		perf_reader_poll(tracer->readers_count, tracer->readers, 500);
+	reader_event_loop(tracer->readers_count, tracer->readers);
 #else
+	for (;;) {
 		uint64_t data_len, rand_seed;
 		rand_seed = clib_cpu_time_now();
 		data_len = random_u32((uint32_t *) & rand_seed) & 0xffff;
@@ -771,18 +1253,178 @@ static void poller(void *t)
 			free(prep_data);
 			atomic64_inc(&q->enqueue_lost);
 		} else {
-			pthread_mutex_lock(&q->mutex);
-			pthread_cond_signal(&q->cond);
-			pthread_mutex_unlock(&q->mutex);
+			queue_wakeup(q);
 			atomic64_inc(&q->enqueue_nr);
 		}
-#endif
 	}
+#endif
 	/* never reached */
 	/* pthread_exit(NULL); */
 	/* return NULL; */
 }
 
+/*
+ * 每CPU读取线程，绑定到perf buffer所属的CPU上，
+ * 只消费自己CPU的ring，使perf buffer的消费能力随CPU数量扩展。
+ */
+static void percpu_poller(void *arg)
+{
+	struct perf_reader **reader = (struct perf_reader **)arg;
+	struct bpf_tracer *tracer = (struct bpf_tracer *)(*reader)->cb_cookie;
+	int cpu = tracer->readers_cpu[reader - tracer->readers];
+	char name[NAME_LEN];
+	snprintf(name, sizeof(name), "perf-reader-%d", cpu);
+	prctl(PR_SET_NAME, name);
+
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	if (-1 ==
+	    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)) {
+		ebpf_warning("reader bind cpu(%d) failed, error:%s\n",
+			     cpu, strerror(errno));
+	}
+
+	// 记录所在节点，装配路径据此优先分发到本节点队列
+	if (numa_nodes_nr > 1 && cpu < MAX_CPU_NR)
+		thread_numa_node = cpu_to_numa[cpu];
+
+	reader_event_loop(1, reader);
+	/* never reached */
+}
+
+// ringbuf读取线程，所有CPU的数据从同一个buffer消费
+static void ringbuf_poller(void *t)
+{
+	prctl(PR_SET_NAME, "rb-reader");
+	struct bpf_tracer *tracer = (struct bpf_tracer *)t;
+	uint64_t deadline = 0, now;
+	int nr;
+	for (;;) {
+		nr = bpf_consume_ringbuf(tracer->rb);
+		if (nr <= 0) {
+			now = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
+			if (now < deadline) {
+				__pause();
+				continue;
+			}
+
+			nr = bpf_poll_ringbuf(tracer->rb, 500);
+		}
+
+		if (nr > 0 && perf_busy_poll_us > 0)
+			deadline = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) +
+			    (uint64_t) perf_busy_poll_us * 1000;
+	}
+	/* never reached */
+}
+
+int set_perf_reader_mode(enum perf_reader_mode mode)
+{
+	if (mode != PERF_READER_MODE_SINGLE && mode != PERF_READER_MODE_PERCPU)
+		return ETR_INVAL;
+
+	perf_rd_mode = mode;
+	ebpf_info("set perf reader mode: %s\n",
+		  mode == PERF_READER_MODE_PERCPU ? "percpu" : "single");
+	return ETR_OK;
+}
+
+enum perf_reader_mode get_perf_reader_mode(void)
+{
+	return perf_rd_mode;
+}
+
+int set_perf_busy_poll_us(uint32_t time_us)
+{
+	perf_busy_poll_us = time_us;
+	ebpf_info("set perf busy-poll window: %u us\n", time_us);
+	return ETR_OK;
+}
+
+uint32_t get_perf_busy_poll_us(void)
+{
+	return perf_busy_poll_us;
+}
+
+// 需要在tracer启动（perf_map_init()）之前调用
+int set_perf_zero_copy(bool enabled)
+{
+	perf_zero_copy = enabled;
+	ebpf_info("set perf zero-copy: %s\n",
+		  enabled ? "enabled" : "disabled");
+	return ETR_OK;
+}
+
+// 需要在tracer启动（perf_map_init()）之前调用
+int set_perf_adaptive_sizing(bool enabled)
+{
+	perf_adaptive_sizing = enabled;
+	ebpf_info("set perf adaptive sizing: %s\n",
+		  enabled ? "enabled" : "disabled");
+	return ETR_OK;
+}
+
+// 全局页预算，0表示使用配置页数*读者数。需要在tracer启动之前调用
+int set_perf_buffer_budget(uint32_t pages)
+{
+	perf_pages_budget = pages;
+	ebpf_info("set perf buffer budget: %u pages\n", pages);
+	return ETR_OK;
+}
+
+int set_dispatch_work_stealing(bool enabled)
+{
+	dispatch_steal_enabled = enabled;
+	ebpf_info("set dispatch work stealing: %s\n",
+		  enabled ? "enabled" : "disabled");
+	return ETR_OK;
+}
+
+int set_dispatch_autoscale(bool enabled)
+{
+	dispatch_autoscale_enabled = enabled;
+	ebpf_info("set dispatch autoscale: %s\n",
+		  enabled ? "enabled" : "disabled");
+	return ETR_OK;
+}
+
+/*
+ * 队列ring与heap块数组改用2MB大页后备（不足时退回THP madvise，再
+ * 退回普通堆内存）。需要在tracer创建之前调用。
+ */
+int set_memory_hugepages(bool enabled)
+{
+	mem_set_hugepages(enabled);
+	ebpf_info("set memory hugepages: %s\n",
+		  enabled ? "enabled" : "disabled");
+	return ETR_OK;
+}
+
+int set_worker_spin_us(uint32_t time_us)
+{
+	worker_spin_us = time_us;
+	ebpf_info("set queue worker spin window: %u us\n", time_us);
+	return ETR_OK;
+}
+
+uint32_t get_worker_spin_us(void)
+{
+	return worker_spin_us;
+}
+
+void queue_stealer_wakeup(struct bpf_tracer *t, struct queue *q)
+{
+	if (!dispatch_steal_enabled || t->dispatch_workers_nr <= 1)
+		return;
+
+	if (ring_count(q->r) < QUEUE_STEAL_WATERMARK)
+		return;
+
+	int q_idx = q - t->queues;
+	queue_wakeup(&t->queues[(q_idx + 1) % t->dispatch_workers_nr]);
+}
+
 static void extra_waiting_process(int type)
 {
 	struct extra_waiting_op *ewo;
@@ -888,6 +1530,128 @@ int set_period_event_invalid(const char *name)
 	return ETR_OK;
 }
 
+/*
+ * ============================================================
+ * BPF程序运行时开销统计
+ *
+ * 内核的BPF_ENABLE_STATS为每个程序累计run_cnt/run_time_ns，周期线程
+ * 做差分得到每个probe上个周期的平均单次执行耗时，经
+ * SOCKOPT_GET_SOCKTRACE_SHOW输出。某个probe变贵时（例如协议推断新增
+ * 匹配器造成回归）直接体现为该probe的ns/次上涨，越过阈值打告警日志。
+ * ===========================================================
+ */
+
+// 单次执行平均耗时的告警阈值，单位：纳秒
+#define PROG_RT_WARN_NS		1000
+
+static struct bpf_tracer *prog_stats_tracer;
+static int bpf_stats_hold_fd = -1;	// 持有期间内核统计保持开启
+static bool bpf_stats_by_sysctl;
+
+static bool bpf_stats_runtime_enable(void)
+{
+	bpf_stats_hold_fd = bpf_enable_stats_fd();
+	if (bpf_stats_hold_fd >= 0)
+		return true;
+
+	// 5.8之前的内核没有BPF_ENABLE_STATS命令，回退到sysctl开关
+	int fd = open("/proc/sys/kernel/bpf_stats_enabled", O_WRONLY);
+	if (fd < 0)
+		return false;
+
+	if (write(fd, "1", 1) != 1) {
+		close(fd);
+		return false;
+	}
+
+	close(fd);
+	bpf_stats_by_sysctl = true;
+	return true;
+}
+
+static int prog_rt_stats_sample(void)
+{
+	struct bpf_tracer *t = prog_stats_tracer;
+	if (t == NULL)
+		return 0;
+
+	int i;
+	for (i = 0; i < t->prog_stats_nr; i++) {
+		struct bpf_prog_rt_stat *s = &t->prog_stats[i];
+		struct bpf_prog_info info;
+		uint32_t len = sizeof(info);
+		memset(&info, 0, sizeof(info));
+		if (bpf_obj_get_info(s->fd, &info, &len) != 0)
+			continue;
+
+		uint64_t d_cnt = info.run_cnt - s->last_run_cnt;
+		uint64_t d_ns = info.run_time_ns - s->last_run_time_ns;
+		uint32_t avg = d_cnt > 0 ? d_ns / d_cnt : 0;
+
+		// 只在越过阈值的那个周期告警，避免持续刷日志
+		if (avg > PROG_RT_WARN_NS &&
+		    s->period_avg_ns <= PROG_RT_WARN_NS)
+			ebpf_warning
+			    ("bpf prog '%s' costs %u ns/run (%" PRIu64
+			     " runs last period), exceeds %d ns.\n",
+			     s->name, avg, d_cnt, PROG_RT_WARN_NS);
+
+		s->period_avg_ns = avg;
+		s->last_run_cnt = info.run_cnt;
+		s->last_run_time_ns = info.run_time_ns;
+		s->run_cnt = info.run_cnt;
+		s->run_time_ns = info.run_time_ns;
+	}
+
+	return 0;
+}
+
+int tracer_prog_stats_init(struct bpf_tracer *tracer)
+{
+	if (tracer->pobj == NULL)
+		return ETR_INVAL;
+
+	if (!bpf_stats_runtime_enable()) {
+		ebpf_info("kernel does not support bpf stats accounting, "
+			  "program runtime statistics disabled.\n");
+		return ETR_OK;
+	}
+
+	struct bpf_prog_rt_stat *stats =
+	    calloc(PROG_RT_STATS_MAX, sizeof(*stats));
+	if (stats == NULL) {
+		ebpf_warning("calloc() failed, no memory.\n");
+		return ETR_NOMEM;
+	}
+
+	int nr = 0;
+	struct bpf_program *prog;
+	bpf_object__for_each_program(prog, tracer->pobj) {
+		int fd = bpf_program__fd(prog);
+		if (fd < 0)
+			continue;
+		if (nr >= PROG_RT_STATS_MAX) {
+			ebpf_warning("too many bpf programs, runtime stats "
+				     "truncated to %d.\n", PROG_RT_STATS_MAX);
+			break;
+		}
+
+		struct bpf_prog_rt_stat *s = &stats[nr++];
+		snprintf(s->name, sizeof(s->name), "%s",
+			 bpf_program__name(prog));
+		s->fd = fd;
+	}
+
+	tracer->prog_stats = stats;
+	tracer->prog_stats_nr = nr;
+	prog_stats_tracer = tracer;
+
+	ebpf_info("bpf runtime stats enabled (%s) for %d programs.\n",
+		  bpf_stats_by_sysctl ? "sysctl" : "BPF_ENABLE_STATS", nr);
+
+	return register_period_event_op("prog-rt-stats", prog_rt_stats_sample);
+}
+
 /*
  * kernel采用捆绑burst发送数据到用户的形式，
  * 下面的方法实现所有CPU触发超时检查把驻留在eBPF buffer中数据发送上来。
@@ -939,6 +1703,73 @@ static int boot_time_update(void)
 	return ETR_OK;
 }
 
+/*
+ * 弹性worker的周期检查。扩容只是把dispatch_workers_active加一：既有
+ * flow沿用分发表里的粘性映射不动，只有新flow（或空闲重播种的flow）
+ * 会落到新队列，per-socket有序性不受影响。缩容同理——退出分发的队列
+ * 不再被播种选中，但仍按原映射接收其存量flow的数据并继续消费，等这
+ * 些flow空闲DISPATCH_IDLE_RESEED_NS后重播种到活跃队列，该worker自然
+ * 排空并park，不需要显式的迁移/屏障。
+ */
+static int dispatch_autoscale_check(void)
+{
+	struct bpf_tracer *t = autoscale_tracer;
+	if (t == NULL || !dispatch_autoscale_enabled ||
+	    t->dispatch_workers_nr <= 1)
+		return ETR_OK;
+
+	int i, active = t->dispatch_workers_active;
+	unsigned max_depth = 0, total_depth = 0, depth;
+	for (i = 0; i < t->dispatch_workers_nr; i++) {
+		depth = ring_count(t->queues[i].r);
+		total_depth += depth;
+		if (depth > max_depth)
+			max_depth = depth;
+	}
+
+	if (max_depth >= AUTOSCALE_HIGH_WM(&t->queues[0])) {
+		autoscale_idle_ticks = 0;
+		if (++autoscale_high_ticks >= AUTOSCALE_UP_TICKS &&
+		    active < t->dispatch_workers_nr) {
+			t->dispatch_workers_active = active + 1;
+			queue_wakeup(&t->queues[active]);
+			autoscale_high_ticks = 0;
+			ebpf_info("dispatch scale up: %d -> %d workers "
+				  "(max queue depth %u)\n", active, active + 1,
+				  max_depth);
+		}
+		return ETR_OK;
+	}
+
+	autoscale_high_ticks = 0;
+	if (total_depth <= AUTOSCALE_LOW_WM) {
+		if (++autoscale_idle_ticks >= AUTOSCALE_DOWN_TICKS &&
+		    active > t->dispatch_workers_min) {
+			t->dispatch_workers_active = active - 1;
+			autoscale_idle_ticks = 0;
+			ebpf_info("dispatch scale down: %d -> %d workers\n",
+				  active, active - 1);
+		}
+	} else {
+		autoscale_idle_ticks = 0;
+	}
+
+	return ETR_OK;
+}
+
+// 推进各队列flow上下文表的代计数，过期条目由新flow就地复用
+static int flow_ctx_period_tick(void)
+{
+	int i, j;
+	for (i = 0; i < tracers_count; i++) {
+		struct bpf_tracer *t = tracers[i];
+		for (j = 0; j < t->dispatch_workers_nr; j++)
+			flow_ctx_advance_gen(&t->queues[j].flow_ctx);
+	}
+
+	return ETR_OK;
+}
+
 static void period_process_main(__unused void *arg)
 {
 	prctl(PR_SET_NAME, "period-process");
@@ -951,7 +1782,8 @@ static void period_process_main(__unused void *arg)
 
 	ebpf_info("cpus_kick begin !!!\n");
 
-	memset((void *)ready_flag_cpus, 1, sizeof(ready_flag_cpus));
+	memset((void *)ready_flag_cpus, 1,
+	       sys_cpus_count * sizeof(*ready_flag_cpus));
 
 	for (;;) {
 		period_events_process();
@@ -959,31 +1791,129 @@ static void period_process_main(__unused void *arg)
 	}
 }
 
+/*
+ * 消费队列q上的一个burst。dequeue和数据处理在q->consume_lock保护下
+ * 作为一个整体进行，同一时刻一个队列只有一个消费者，处理顺序与入队
+ * 顺序一致，保持per-socket的有序性。
+ */
+static int queue_burst_process(struct queue *q, void **rx_burst, bool is_steal)
+{
+	int nr;
+
+	if (is_steal) {
+		/*
+		 * 偷取只在能立即拿到锁时进行，拿不到说明已经有别的
+		 * worker在消费这个队列。
+		 */
+		if (pthread_mutex_trylock(&q->consume_lock) != 0)
+			return 0;
+	} else {
+		pthread_mutex_lock(&q->consume_lock);
+	}
+
+	nr = ring_dequeue_burst(q->r, rx_burst, MAX_PKT_BURST, NULL);
+	if (nr > 0) {
+		atomic64_add(&q->dequeue_nr, nr);
+		if (is_steal)
+			atomic64_add(&q->stolen_nr, nr);
+		PROF_START(PROF_STAGE_PROCESS);
+		prefetch_and_process_datas(q, nr, rx_burst);
+		PROF_END(PROF_STAGE_PROCESS);
+		if (nr == MAX_PKT_BURST)
+			atomic64_inc(&q->burst_count);
+		// consume_lock保证同一时刻本队列记录只有一个发布者
+		shm_queue_stats_publish(q);
+	}
+
+	pthread_mutex_unlock(&q->consume_lock);
+
+	return nr;
+}
+
 /*
  * 工作线程从queue获取数据，进行数据处理。
  */
 static void process_datas(void *queue)
 {
 	prctl(PR_SET_NAME, "queue-worker");
-	int nr;
+	int nr, i;
 	struct queue *q = (struct queue *)queue;
-	struct ring *r = q->r;
+	struct bpf_tracer *t = q->t;
+
+	// 绑定到队列归属NUMA节点的CPU集合，消费不再跨节点访问ring
+	if (q->numa_node >= 0) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		int c, n = 0;
+		for (c = 0; c < sys_cpus_count && c < MAX_CPU_NR; c++) {
+			if (cpu_to_numa[c] == q->numa_node) {
+				CPU_SET(c, &cpuset);
+				n++;
+			}
+		}
+		if (n > 0 &&
+		    pthread_setaffinity_np(pthread_self(), sizeof(cpuset),
+					   &cpuset))
+			ebpf_warning("worker bind numa node(%d) failed,"
+				     " error:%s\n", q->numa_node,
+				     strerror(errno));
+		thread_numa_node = q->numa_node;
+	}
+
+	int q_idx = q - t->queues;
+	struct queue *sq;
 	void *rx_burst[MAX_PKT_BURST];
+	uint64_t ev, spin_deadline = 0;
 	for (;;) {
-		nr = ring_sc_dequeue_burst(r, rx_burst, MAX_PKT_BURST, NULL);
-		if (nr == 0) {
-			/*
-			 * 等着生产者唤醒
-			 */
-			pthread_mutex_lock(&q->mutex);
-			pthread_cond_wait(&q->cond, &q->mutex);
-			pthread_mutex_unlock(&q->mutex);
-		} else {
-			atomic64_add(&q->dequeue_nr, nr);
-			prefetch_and_process_datas(q->t, nr, rx_burst);
-			if (nr == MAX_PKT_BURST)
-				atomic64_inc(&q->burst_count);
+		nr = queue_burst_process(q, rx_burst, false);
+		if (nr > 0) {
+			if (worker_spin_us > 0)
+				spin_deadline =
+				    gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) +
+				    (uint64_t) worker_spin_us * 1000;
+			continue;
+		}
+
+		/*
+		 * 本队列已空，flow哈希不均时帮助积压的兄弟队列消费
+		 * （work stealing）。
+		 */
+		if (dispatch_steal_enabled) {
+			for (i = 1; i < t->dispatch_workers_nr; i++) {
+				sq = &t->queues[(q_idx + i) %
+						t->dispatch_workers_nr];
+				if (ring_count(sq->r) < MAX_PKT_BURST)
+					continue;
+				nr = queue_burst_process(sq, rx_burst, true);
+				if (nr > 0)
+					break;
+			}
+
+			if (nr > 0)
+				continue;
+		}
+
+		/*
+		 * spin-then-park：spin窗口内数据到来无需生产者做任何
+		 * 唤醒动作。
+		 */
+		if (spin_deadline > 0 &&
+		    gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN) < spin_deadline) {
+			__pause();
+			continue;
 		}
+
+		/*
+		 * park在eventfd上等着生产者唤醒。先置sleeping再复查
+		 * 队列，避免与生产者的队列写入+sleeping判断交错造成
+		 * 唤醒丢失。
+		 */
+		__atomic_store_n(&q->sleeping, 1, __ATOMIC_SEQ_CST);
+		if (ring_count(q->r) == 0 &&
+		    read(q->event_fd, &ev, sizeof(ev)) != sizeof(ev))
+			ebpf_warning("eventfd read error:%s\n",
+				     strerror(errno));
+		__atomic_store_n(&q->sleeping, 0, __ATOMIC_SEQ_CST);
 	}
 
 	/* never reached */
@@ -1013,12 +1943,30 @@ int dispatch_worker(struct bpf_tracer *tracer, unsigned int queue_size)
 	else
 		queue_size = 1 << min_log2((unsigned int)queue_size);
 
+	/*
+	 * 每CPU读取模式下存在多个生产者（多个读取线程可能向同一个
+	 * 队列enqueue），ring创建为multi-producer方式。ringbuf模式
+	 * 下始终是单线程消费，单生产者。开启work stealing后，其他
+	 * worker也会从本队列dequeue，需要multi-consumer方式。
+	 */
+	unsigned ring_flags = 0;
+	if (tracer->rb != NULL || perf_rd_mode == PERF_READER_MODE_SINGLE)
+		ring_flags |= RING_F_SP_ENQ;
+	if (!dispatch_steal_enabled)
+		ring_flags |= RING_F_SC_DEQ;
+
 	for (i = 0; i < tracer->dispatch_workers_nr; i++) {
 		struct ring *r = NULL;
 		char name[NAME_LEN];
+		/*
+		 * 多NUMA节点时队列按节点交错归属：ring内存绑到归属节
+		 * 点，消费worker也绑到该节点的CPU上，配合装配侧的本节
+		 * 点优先分发，消除生产/消费跨节点的内存访问。
+		 */
+		int numa_node = numa_nodes_nr > 1 ?
+		    i % numa_nodes_nr : SOCKET_ID_ANY;
 		snprintf(name, sizeof(name), "%s-ring-%d", tracer->name, i);
-		r = ring_create(name, queue_size,
-				SOCKET_ID_ANY, RING_F_SP_ENQ | RING_F_SC_DEQ);
+		r = ring_create(name, queue_size, numa_node, ring_flags);
 		if (r == NULL) {
 			ebpf_info("<%s> ring_create fail. err:%s\n", __func__,
 				  strerror(errno));
@@ -1029,15 +1977,52 @@ int dispatch_worker(struct bpf_tracer *tracer, unsigned int queue_size)
 		tracer->queues[i].t = tracer;
 		tracer->queues[i].nr = 0;
 		tracer->queues[i].ring_size = queue_size;
+		tracer->queues[i].numa_node = numa_node;
+
+		if (block_heap_init(&tracer->queues[i].heap, name) != ETR_OK) {
+			ebpf_info("<%s> block_heap_init fail. err:%s\n",
+				  __func__, strerror(errno));
+			return -ENOMEM;
+		}
+
+		if (flow_ctx_init(&tracer->queues[i].flow_ctx) != ETR_OK) {
+			ebpf_info("<%s> flow_ctx_init fail. err:%s\n",
+				  __func__, strerror(errno));
+			return -ENOMEM;
+		}
 
 		atomic64_init(&tracer->queues[i].enqueue_lost);
 		atomic64_init(&tracer->queues[i].enqueue_nr);
 		atomic64_init(&tracer->queues[i].dequeue_nr);
 		atomic64_init(&tracer->queues[i].burst_count);
 		atomic64_init(&tracer->queues[i].heap_get_faild);
+		atomic64_init(&tracer->queues[i].stolen_nr);
+		atomic64_init(&tracer->queues[i].reconfirm_nr);
+		atomic64_init(&tracer->queues[i].reconfirm_rewrite_nr);
+		atomic64_init(&tracer->queues[i].wakeup_nr);
+		atomic64_init(&tracer->queues[i].wakeup_avoid_nr);
+
+		tracer->queues[i].lat_sample_seq = 0;
+		int s, b;
+		for (s = 0; s < PROTO_NUM; s++)
+			atomic64_init(&tracer->queues[i].proto_status[s]);
+		for (s = 0; s < LAT_STAGE_NUM; s++) {
+			struct latency_hist *h = &tracer->queues[i].lat_hists[s];
+			atomic64_init(&h->count);
+			atomic64_init(&h->sum_ns);
+			for (b = 0; b < LATENCY_HIST_BUCKETS; b++)
+				atomic64_init(&h->buckets[b]);
+		}
 
-		pthread_mutex_init(&tracer->queues[i].mutex, NULL);
-		pthread_cond_init(&tracer->queues[i].cond, NULL);
+		tracer->queues[i].sleeping = 0;
+		tracer->queues[i].event_fd = eventfd(0, EFD_CLOEXEC);
+		if (tracer->queues[i].event_fd < 0) {
+			ebpf_info("<%s> eventfd() fail. err:%s\n", __func__,
+				  strerror(errno));
+			return -ENOMEM;
+		}
+
+		pthread_mutex_init(&tracer->queues[i].consume_lock, NULL);
 		ret =
 		    pthread_create(&tracer->dispatch_workers[i], NULL,
 				   (void *)&process_datas,
@@ -1050,6 +2035,50 @@ int dispatch_worker(struct bpf_tracer *tracer, unsigned int queue_size)
 		}
 	}
 
+	// 全量启动，负载低时由周期检查逐步缩容到下限
+	tracer->dispatch_workers_active = tracer->dispatch_workers_nr;
+	tracer->dispatch_workers_min =
+	    (tracer->dispatch_workers_nr + 3) / 4;
+	autoscale_tracer = tracer;
+	register_period_event_op("dispatch-autoscale",
+				 dispatch_autoscale_check);
+
+	// 失败只影响共享内存统计通道，监控回退到sockopt方式
+	if (shm_stats_create(tracer->dispatch_workers_nr) != ETR_OK)
+		ebpf_warning("shm_stats_create() failed, "
+			     "shared-memory stats disabled.\n");
+
+	if (tracer->rb != NULL) {
+		ret =
+		    pthread_create(&tracer->perf_worker[0], NULL,
+				   (void *)&ringbuf_poller, (void *)tracer);
+		if (ret) {
+			ebpf_info
+			    ("<%s> ringbuf_poller, pthread_create is error:%s\n",
+			     __func__, strerror(errno));
+			return ETR_INVAL;
+		}
+
+		return ETR_OK;
+	}
+
+	if (perf_rd_mode == PERF_READER_MODE_PERCPU) {
+		for (i = 0; i < tracer->readers_count; i++) {
+			ret =
+			    pthread_create(&tracer->perf_worker[i], NULL,
+					   (void *)&percpu_poller,
+					   (void *)&tracer->readers[i]);
+			if (ret) {
+				ebpf_info
+				    ("<%s> percpu_poller, pthread_create is error:%s\n",
+				     __func__, strerror(errno));
+				return ETR_INVAL;
+			}
+		}
+
+		return ETR_OK;
+	}
+
 	ret =
 	    pthread_create(&tracer->perf_worker[0], NULL, (void *)&poller,
 			   (void *)tracer);
@@ -1095,16 +2124,23 @@ static int tracer_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
 		snprintf(btp->name, sizeof(btp->name), "%s", t->name);
 		snprintf(btp->bpf_load_name, sizeof(btp->bpf_load_name), "%s",
 			 t->bpf_load_name);
-		btp->dispatch_workers_nr = t->dispatch_workers_nr;
+		// sockopt ABI的rx_queues数组上限为MAX_CPU_NR，超出部分截断
+		btp->dispatch_workers_nr = t->dispatch_workers_nr > MAX_CPU_NR ?
+		    MAX_CPU_NR : t->dispatch_workers_nr;
 		btp->perf_pg_cnt = t->perf_pages_cnt;
 		btp->lost = atomic64_read(&t->lost);
 		btp->probes_count = t->probes_count;
 		btp->state = t->state;
 		btp->adapt_success = t->adapt_success;
 
+		// 分协议统计按per-queue分片存放，读取时求和
+		int qi;
 		for (j = 0; j < PROTO_NUM; j++) {
-			btp->proto_status[j] =
-			    atomic64_read(&t->proto_status[j]);
+			btp->proto_status[j] = 0;
+			for (qi = 0; qi < t->dispatch_workers_nr; qi++)
+				btp->proto_status[j] +=
+				    atomic64_read(&t->queues[qi].
+						  proto_status[j]);
 		}
 
 		for (j = 0; j < btp->dispatch_workers_nr; j++) {
@@ -1119,8 +2155,19 @@ static int tracer_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
 			    atomic64_read(&t->queues[j].dequeue_nr);
 			rx_q->heap_get_faild =
 			    atomic64_read(&t->queues[j].heap_get_faild);
+			rx_q->wakeup_nr =
+			    atomic64_read(&t->queues[j].wakeup_nr);
+			rx_q->wakeup_avoid_nr =
+			    atomic64_read(&t->queues[j].wakeup_avoid_nr);
 			rx_q->queue_size = ring_count(t->queues[j].r);
 			rx_q->ring_capacity = t->queues[j].r->capacity;
+			// 峰值/增量类指标读取即清零（两次SHOW之间的值）
+			rx_q->occupancy_hwm = t->queues[j].occupancy_hwm;
+			rx_q->full_streak_max = t->queues[j].full_streak_max;
+			rx_q->stall_nr = t->queues[j].stall_nr;
+			t->queues[j].occupancy_hwm = 0;
+			t->queues[j].full_streak_max = 0;
+			t->queues[j].stall_nr = 0;
 		}
 	}
 
@@ -1140,6 +2187,9 @@ static struct tracer_sockopts trace_sockopts = {
 int bpf_tracer_init(const char *log_file, bool is_stdout)
 {
 	int err;
+	// 根据CPU能力选择memcpy_fast的拷贝实现
+	memcpy_fast_init();
+
 	if (max_locked_memory_set_unlimited() != 0)
 		return ETR_INVAL;
 
@@ -1158,11 +2208,31 @@ int bpf_tracer_init(const char *log_file, bool is_stdout)
 		}
 	}
 
+	// 日志输出转交后台线程，数据路径不再做同步IO
+	if (log_async_init() != 0)
+		ebpf_warning("log_async_init() failed, "
+			     "logging stays synchronous.\n");
+
 	max_rlim_open_files_set(OPEN_FILES_MAX);
 	sys_cpus_count = get_cpus_count(&cpu_online);
 	if (sys_cpus_count <= 0)
 		return ETR_INVAL;
 
+	ready_flag_cpus = calloc(sys_cpus_count, sizeof(*ready_flag_cpus));
+	if (ready_flag_cpus == NULL) {
+		ebpf_warning("calloc() failed, no memory.\n");
+		return -ENOMEM;
+	}
+
+	numa_nodes_nr = get_numa_nodes_count();
+	if (numa_nodes_nr > 1) {
+		int c;
+		for (c = 0; c < sys_cpus_count && c < MAX_CPU_NR; c++)
+			cpu_to_numa[c] = (int8_t) get_numa_node_of_cpu(c);
+		ebpf_info("numa nodes %d, enable numa-aware placement.\n",
+			  numa_nodes_nr);
+	}
+
 	uint64_t real_time, monotonic_time;
 	real_time = gettime(CLOCK_REALTIME, TIME_TYPE_NAN);
 	monotonic_time = gettime(CLOCK_MONOTONIC, TIME_TYPE_NAN);
@@ -1179,6 +2249,10 @@ int bpf_tracer_init(const char *log_file, bool is_stdout)
 	if ((err = sockopt_register(&trace_sockopts)) != ETR_OK)
 		return err;
 
+	// PROF构建时注册剖析器的sockopt，默认构建下是空操作
+	if ((err = profiler_init()) != ETR_OK)
+		return err;
+
 	err = pthread_create(&ctrl_pthread, NULL, (void *)&ctrl_main, NULL);
 	if (err) {
 		ebpf_info("<%s> ctrl_pthread, pthread_create is error:%s\n",
@@ -1189,6 +2263,9 @@ int bpf_tracer_init(const char *log_file, bool is_stdout)
 	if (register_period_event_op("kick_kern", cpus_kick_kern))
 		return ETR_INVAL;
 
+	if (register_period_event_op("flow-ctx-gen", flow_ctx_period_tick))
+		return ETR_INVAL;
+
 	/*
 	 * 由于系统运行过程中会存在系统时间被改动而发生变化的情况，
 	 * 因此需要对系统启动时间(精度为纳秒)进行周期性的更新，是之
@@ -36,6 +36,7 @@
 #include <time.h>
 #include <string.h>
 #include "ring.h"
+#include "mem.h"
 #include "ctrl.h"
 #include "atomic.h"
 #include "../libbpf/src/libbpf.h"
@@ -43,14 +44,12 @@
 #include "../kernel/include/xxhash.h"
 #include "../kernel/include/socket_trace_common.h"
 #include "bcc/libbpf.h"
+#include "bcc/perf_reader.h"
+#include "flow_ctx.h"
 #include "symbol.h"
 
-// TODO: 对内存拷贝进行硬件优化。
-
 #define LOOP_DELAY_US  100000
 
-#define memcpy_fast(a,b,c) memcpy(a,b,c)
-
 #define RING_SIZE 16384
 #define MAX_BULK 32
 #define MAX_PKT_BURST 16
@@ -70,6 +69,10 @@
 
 #define PROBE_NAME_SZ   128
 
+/*
+ * 仅用于固定布局的控制面ABI（sockopt参数、共享内存统计段）。tracer
+ * 运行时数组已按实际CPU数动态分配，不受此上限约束。
+ */
 #define MAX_CPU_NR      256
 
 enum tracer_hook_type {
@@ -83,6 +86,16 @@ enum tracer_state {
 	TRACER_STOP
 };
 
+/*
+ * perf ring-buffer的读取方式:
+ * 单线程轮询所有CPU的perf buffer，或者每个online CPU一个读取线程
+ * （线程绑定到对应CPU上，只消费自己CPU的perf buffer）。
+ */
+enum perf_reader_mode {
+	PERF_READER_MODE_SINGLE,	// 单线程轮询（默认）
+	PERF_READER_MODE_PERCPU		// 每CPU一个读取线程
+};
+
 enum probe_type {
 	KPROBE,
 	UPROBE
@@ -161,6 +174,8 @@ enum {
 	SOCKOPT_SET_SOCKTRACE_DEL,
 	SOCKOPT_SET_SOCKTRACE_SET,
 	SOCKOPT_SET_SOCKTRACE_FLUSH,
+	SOCKOPT_SET_SOCKTRACE_SNAPLEN,
+	SOCKOPT_SET_SOCKTRACE_RECORD,
 
 	/* get */
 	SOCKOPT_GET_SOCKTRACE_SHOW,
@@ -170,9 +185,75 @@ struct mem_block_head {
 	uint8_t is_last;
 	void *free_ptr;
 	void (*fn)(void *);
+	/*
+	 * 零拷贝模式：burst中的cap_data是perf记录的视图，burst处理完成
+	 * 后释放该记录（推进data_tail）。非零拷贝模式reader为NULL。
+	 */
+	struct perf_reader *reader;
+	uint32_t record_slot;
+	/*
+	 * 时延采样：非0表示该事件被采样，值为入队时刻（ns），worker
+	 * 出队时据此补全排队等待和处理耗时两段直方图。
+	 */
+	uint64_t lat_enq_ts;
 } __attribute__ ((packed));
 
 typedef void (*l7_handle_fn) (void *sd);
+/*
+ * burst级回调：worker把一次出队的整个burst（最多MAX_PKT_BURST个
+ * socket_bpf_data指针）一次性交给上层，把C->Rust的FFI次数从每事件
+ * 一次降到每burst一次。指针仅在回调执行期间有效。
+ */
+typedef void (*l7_handle_burst_fn) (void **sds, int nr);
+
+struct queue;
+/*
+ * 批量协议再确认：worker出队后、process_fn之前对整个burst的payload
+ * 前缀做一次签名核对（见proto_reconfirm.c），确认/改写l7_protocal_hint
+ * 并清掉need_reconfirm标记。
+ */
+typedef void (*burst_reconfirm_fn_t) (struct queue * q, void **sds, int nr);
+
+/*
+ * 分阶段时延直方图（log2桶，单位ns），用于区分内核发出到perf读取、
+ * 入队到worker出队、process_fn处理三个阶段的耗时，定位是reader跟不
+ * 上还是worker过载。采样记录（1/64的事件），避免热路径上每个事件都
+ * 取两次时间戳。
+ */
+#define LATENCY_HIST_BUCKETS	32
+#define LATENCY_SAMPLE_MASK	0x3f	// 1/64采样
+
+enum latency_stage {
+	LAT_STAGE_KERN_TO_USER,	// 内核发出事件 -> perf reader读到
+	LAT_STAGE_QUEUE_WAIT,	// 入队 -> worker出队
+	LAT_STAGE_PROCESS,	// process_fn回调处理
+	LAT_STAGE_NUM
+};
+
+struct latency_hist {
+	atomic64_t buckets[LATENCY_HIST_BUCKETS];
+	atomic64_t count;
+	atomic64_t sum_ns;
+};
+
+static inline void latency_hist_record(struct latency_hist *h, uint64_t ns)
+{
+	int b = 0;
+	if (ns > 0)
+		b = 63 - __builtin_clzll(ns);
+	if (b >= LATENCY_HIST_BUCKETS)
+		b = LATENCY_HIST_BUCKETS - 1;
+	atomic64_inc(&h->buckets[b]);
+	atomic64_inc(&h->count);
+	atomic64_add(&h->sum_ns, ns);
+}
+
+static inline uint64_t lat_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * NANOSEC_PER_SEC + ts.tv_nsec;
+}
 
 struct tracer_probes_conf {
 	char *bin_file;		// only use uprobe;
@@ -186,6 +267,11 @@ struct tracer_probes_conf {
 
 struct probe {
 	struct list_head list;
+	/*
+	 * pid索引（probes_pid_hash）的挂接点，仅带pid的uprobe入哈希。
+	 * 上千个Go进程时exec/exit的按pid查找不再线性扫probes_head。
+	 */
+	struct hlist_node pid_hash;
 	enum probe_type type;
 	char name[PROBE_NAME_SZ];
 	struct bpf_link *link;
@@ -197,6 +283,15 @@ struct probe {
 	struct bpf_tracer *tracer;
 };
 
+// probes的pid哈希索引桶数，2的幂
+#define PROBES_PID_HASH_BUCKETS 1024
+
+static inline uint32_t probe_pid_bucket(int pid)
+{
+	return (uint32_t) xxhash((uint64_t) pid) &
+	    (PROBES_PID_HASH_BUCKETS - 1);
+}
+
 struct tracepoint {
 	char name[PROBE_NAME_SZ];
 	struct bpf_link *link;
@@ -204,29 +299,122 @@ struct tracepoint {
 	int prog_fd;
 };
 
+#define CACHE_LINE_BYTES 64
+
 struct queue {
 	struct bpf_tracer *t;
 	struct ring *r;
 	unsigned int ring_size;	// 队列配置大小，值为2的次幂
+	// 队列归属的NUMA节点，-1表示未做NUMA放置（单节点系统）
+	int numa_node;
 	void *datas_burst[MAX_PKT_BURST];	// burst的方式获取数据
 	int nr;			// datas_burst中data数量
 
+	/*
+	 * burst数据内存块的分配器，热路径上代替malloc()。
+	 */
+	struct block_heap heap;
+
 	/*
 	 * 用于唤醒工作线程从队列上获取数据进行处理。
+	 * 消费worker空闲时park在event_fd上，sleeping标识worker是否
+	 * 在休眠。醒着时生产者跳过eventfd写，合并掉绝大部分唤醒
+	 * syscall（见queue_wakeup()）。
+	 */
+	int event_fd;
+	volatile int sleeping;
+
+	/*
+	 * 串行化本队列的消费（dequeue和数据处理作为整体），开启work
+	 * stealing后保证同一队列上的处理顺序与入队顺序一致，维持
+	 * per-socket的有序性。
+	 */
+	pthread_mutex_t consume_lock;
+
+	/*
+	 * 各种统计。生产者侧与消费者侧写入的计数分组并按cache line
+	 * 对齐隔离，每个burst的计数更新不再使两侧在同一行上来回弹跳
+	 * （HITM）；读取侧（统计输出）低频扫描两组求和即可。
+	 */
+	struct {
+		atomic64_t enqueue_lost;
+		atomic64_t enqueue_nr;
+		atomic64_t burst_count;
+		atomic64_t heap_get_faild;	// 从heap上获取内存失败的次数统计
+		atomic64_t wakeup_nr;	// 实际发出的eventfd唤醒次数
+		atomic64_t wakeup_avoid_nr;	// 消费者醒着而省掉的唤醒次数
+		// 时延采样计数器，只在装配线程上递增，不要求精确
+		uint32_t lat_sample_seq;
+		/*
+		 * 入队侧水线telemetry（queue_occupancy_update()），
+		 * SHOW读取后清零，反映两次读取之间的峰值。
+		 */
+		uint32_t occupancy_hwm;	// ring占用高水线
+		uint32_t full_streak;	// 当前连续入队受阻次数
+		uint32_t full_streak_max;	// 最大连续入队受阻次数
+		uint64_t stall_nr;	// 入队受阻（队列满丢弃）发生次数
+	} __attribute__ ((aligned(CACHE_LINE_BYTES)));
+
+	struct {
+		atomic64_t dequeue_nr;
+		atomic64_t stolen_nr;	// 本队列上被其他worker偷取消费的数据数量
+		atomic64_t reconfirm_nr;	// 批量协议再确认检查的事件数
+		atomic64_t reconfirm_rewrite_nr;	// 再确认改写协议的事件数
+	} __attribute__ ((aligned(CACHE_LINE_BYTES)));
+
+	/*
+	 * 分协议类型统计的per-queue分片（读取时各队列求和），写入发生
+	 * 在装配线程，独立对齐避免与消费者计数同行。
 	 */
-	pthread_mutex_t mutex;
-	pthread_cond_t cond;
+	atomic64_t proto_status[PROTO_NUM]
+	    __attribute__ ((aligned(CACHE_LINE_BYTES)));
+
+	// 分阶段时延直方图（1/64采样，低频写）
+	struct latency_hist lat_hists[LAT_STAGE_NUM];
 
 	/*
-	 * 各种统计
+	 * per-flow解析上下文（flow_ctx.h）。flow分发把同一socket_id
+	 * 钉在本队列上，协议确认/解析状态跨事件复用。
 	 */
-	atomic64_t enqueue_lost;
-	atomic64_t enqueue_nr;
-	atomic64_t burst_count;
-	atomic64_t dequeue_nr;
-	atomic64_t heap_get_faild;	// 从heap上获取内存失败的次数统计
+	struct flow_ctx_table flow_ctx;
 };
 
+/*
+ * 唤醒队列的消费worker。只在消费者确实休眠时才写eventfd，
+ * 醒着时一次原子load就返回，热路径上没有futex/syscall开销。
+ */
+static inline void queue_wakeup(struct queue *q)
+{
+	if (__atomic_load_n(&q->sleeping, __ATOMIC_SEQ_CST)) {
+		uint64_t kick = 1;
+		if (write(q->event_fd, &kick, sizeof(kick)) !=
+		    sizeof(kick))
+			return;
+		atomic64_inc(&q->wakeup_nr);
+	} else {
+		atomic64_inc(&q->wakeup_avoid_nr);
+	}
+}
+
+/*
+ * 生产者入队后的队列水线/受阻telemetry。多生产者下的普通写并发
+ * 更新允许偶发少记，换取热路径上零原子开销；SHOW读取时清零。
+ */
+static inline void queue_occupancy_update(struct queue *q, bool stalled)
+{
+	uint32_t cnt = ring_count(q->r);
+	if (cnt > q->occupancy_hwm)
+		q->occupancy_hwm = cnt;
+
+	if (stalled) {
+		q->stall_nr++;
+		if (++q->full_streak > q->full_streak_max)
+			q->full_streak_max = q->full_streak;
+	} else {
+		q->full_streak = 0;
+	}
+}
+
 /*
  * map的重新配置，挂在bpf_tracer->maps_conf_head上。
  */
@@ -236,6 +424,25 @@ struct map_config {
 	int max_entries;
 };
 
+/*
+ * BPF程序运行时开销统计。内核开启BPF_ENABLE_STATS后，周期线程对每个
+ * 已加载程序采样run_cnt/run_time_ns做差分，得到上个周期内单次执行的
+ * 平均耗时，用于发现某个probe（如协议推断回归）变贵。该结构同时作为
+ * SOCKOPT_GET_SOCKTRACE_SHOW的输出格式。
+ */
+#define PROG_RT_STATS_MAX	64
+#define PROG_RT_NAME_SZ		64
+
+struct bpf_prog_rt_stat {
+	char name[PROG_RT_NAME_SZ];	// bpf_program节名
+	int fd;
+	uint64_t run_cnt;	// 累计执行次数
+	uint64_t run_time_ns;	// 累计执行耗时
+	uint64_t last_run_cnt;	// 上次采样时的累计值，用于差分
+	uint64_t last_run_time_ns;
+	uint32_t period_avg_ns;	// 上个周期的平均单次执行耗时
+};
+
 typedef int (*tracer_ctl_fun_t) (void);
 struct bpf_object;
 
@@ -255,35 +462,55 @@ struct bpf_tracer {
 	 */
 	struct tracer_probes_conf *tps;	// probe, tracepoint, uprobes config
 	struct list_head probes_head;
+	// 带pid的uprobe的哈希索引，probes_head保持遍历顺序
+	struct hlist_head probes_pid_hash[PROBES_PID_HASH_BUCKETS];
 	int probes_count;	// probe count.
 	struct tracepoint tracepoints[PROBES_NUM_MAX];
 	int tracepoints_count;
 	pthread_mutex_t mutex_probes_lock; // Protect the probes operation in multiple threads
 
 	/*
-	 * 数据分发处理worker，queues
+	 * 数据分发处理worker，queues。数组在create_bpf_tracer()按实际
+	 * CPU数/worker数分配，不再按MAX_CPU_NR静态内嵌。
 	 */
-	pthread_t perf_worker[MAX_CPU_NR];	// 用户态接收perf-buffer数据主线程
-	pthread_t dispatch_workers[MAX_CPU_NR];	// 分发线程
-	int dispatch_workers_nr;	// 分发线程数量
-	struct queue queues[MAX_CPU_NR];	// 分发队列，每个分发线程都有其对应的队列。
+	pthread_t *perf_worker;	// 用户态接收perf-buffer数据主线程
+	pthread_t *dispatch_workers;	// 分发线程
+	int dispatch_workers_nr;	// 分发线程数量（上限，队列/线程按此预创建）
+	volatile int dispatch_workers_active;	// 当前参与新flow分发的worker数，
+						// 由周期线程按队列深度弹性调整
+	int dispatch_workers_min;	// 缩容下限
+	struct queue *queues;	// 分发队列，每个分发线程都有其对应的队列。
 	void *process_fn;	// 回调应用传递过来的接口, 进行数据处理
+	void *process_burst_fn;	// burst级回调（l7_handle_burst_fn），非NULL时
+				// socket数据整个burst一次性交给上层处理
+	void *burst_reconfirm_fn;	// 批量协议再确认（burst_reconfirm_fn_t），
+					// NULL时跳过该阶段
 
 	/*
 	 * perf ring-buffer from kernel to user.
 	 */
 	struct bpf_map *data_map;	// perf ring-buffer map
-	struct perf_reader *readers[MAX_CPU_NR];	// percpu reader (read from percpu ring-buffer map)
-	int readers_count;	// readers count       
+	struct perf_reader **readers;	// percpu reader (read from percpu ring-buffer map)
+	int *readers_cpu;	// readers对应的CPU编号
+	int readers_count;	// readers count
 	unsigned int perf_pages_cnt;	// ring-buffer set memory size (memory pages count)
 	perf_reader_raw_cb raw_cb;	// 用于perf ring-buffer接收回调
 	perf_reader_lost_cb lost_cb;	// 用于perf ring-buffer数据丢失回调
+	struct ring_buffer *rb;	// BPF ringbuf（Linux 5.8+，代替per-CPU perf buffer），
+				// NULL表示使用perf buffer方式
 
 	/*
 	 * statistics
 	 */
 	atomic64_t lost;	// 用户态程序来不及接收造成内核丢数据
-	atomic64_t proto_status[PROTO_NUM];	// 分协议类型统计
+	// 分协议类型统计在各queue上分片存放（见struct queue），读取时求和
+
+	/*
+	 * BPF程序运行时开销，tracer_prog_stats_init()填充，
+	 * 周期线程采样更新
+	 */
+	struct bpf_prog_rt_stat *prog_stats;
+	int prog_stats_nr;
 
 	/*
 	 * maps re-config
@@ -330,8 +557,14 @@ struct rx_queue_info {
 	uint64_t burst_count;
 	uint64_t dequeue_nr;
 	uint64_t heap_get_faild;
+	uint64_t wakeup_nr;
+	uint64_t wakeup_avoid_nr;
 	int queue_size;
 	int ring_capacity;
+	// 以下三项为读取后清零的峰值/增量（两次SHOW之间）
+	uint32_t occupancy_hwm;
+	uint32_t full_streak_max;
+	uint64_t stall_nr;
 };
 
 struct bpf_tracer_param {
@@ -357,8 +590,6 @@ static inline void prefetch0(const volatile void *p)
 	asm volatile ("prefetcht0 %[p]"::[p] "m"(*(const volatile char *)p));
 }
 
-#define CACHE_LINE_BYTES 64
-
 #define PREFETCH_READ 0
 #define PREFETCH_WRITE 1
 
@@ -381,14 +612,24 @@ do {						\
 /* *INDENT-ON* */
 
 static inline void
-prefetch_and_process_datas(struct bpf_tracer *t, int nb_rx, void **datas_burst)
+prefetch_and_process_datas(struct queue *q, int nb_rx, void **datas_burst)
 {
 /* Configure how many socket_data ahead to prefetch, when reading socket_data */
 #define PREFETCH_OFFSET   3
 	int32_t j;
 	struct socket_bpf_data *sd;
 	struct mem_block_head *block_head;
-	l7_handle_fn callback = (l7_handle_fn) t->process_fn;
+	uint64_t lat_enq, lat_t0;
+	l7_handle_fn callback = (l7_handle_fn) q->t->process_fn;
+	l7_handle_burst_fn burst_cb = (l7_handle_burst_fn) q->t->process_burst_fn;
+	burst_reconfirm_fn_t reconfirm =
+	    (burst_reconfirm_fn_t) q->t->burst_reconfirm_fn;
+	void *batch[MAX_PKT_BURST];
+	int batch_nr = 0;
+
+	// 批量协议再确认先于逐事件处理，整个burst一次扫完
+	if (reconfirm != NULL)
+		reconfirm(q, datas_burst, nb_rx);
 
 	/* Prefetch first packets */
 	for (j = 0; j < PREFETCH_OFFSET && j < nb_rx; j++)
@@ -404,14 +645,61 @@ prefetch_and_process_datas(struct bpf_tracer *t, int nb_rx, void **datas_burst)
 				 2 * CACHE_LINE_BYTES, READ);
 		sd = (struct socket_bpf_data *)datas_burst[j];
 		block_head = (struct mem_block_head *)sd - 1;
+
+		// 被采样的事件补全排队等待时延
+		lat_enq = block_head->lat_enq_ts;
+		lat_t0 = 0;
+		if (lat_enq != 0) {
+			lat_t0 = lat_now_ns();
+			latency_hist_record(&q->lat_hists[LAT_STAGE_QUEUE_WAIT],
+					    lat_t0 - lat_enq);
+		}
+
 		if (block_head->fn != NULL) {
+			/*
+			 * 注册事件与socket数据在burst内交错时，先flush已
+			 * 攒下的socket数据，保持与入队顺序一致。
+			 */
+			if (batch_nr > 0) {
+				burst_cb(batch, batch_nr);
+				batch_nr = 0;
+			}
 			block_head->fn(sd);
+		} else if (burst_cb != NULL) {
+			batch[batch_nr++] = sd;
+			/*
+			 * 被采样事件所在的批次立即flush，使处理时延的
+			 * 测量窗口落在本次回调内（含同批的前序事件，
+			 * 近似可接受）。
+			 */
+			if (lat_enq != 0 || batch_nr == MAX_PKT_BURST) {
+				burst_cb(batch, batch_nr);
+				batch_nr = 0;
+			}
 		} else {
 			callback(sd);
 		}
 
-		if (block_head->is_last == 1)
-			free(block_head->free_ptr);
+		if (lat_enq != 0)
+			latency_hist_record(&q->lat_hists[LAT_STAGE_PROCESS],
+					    lat_now_ns() - lat_t0);
+	}
+
+	if (batch_nr > 0)
+		burst_cb(batch, batch_nr);
+
+	/*
+	 * 批量模式下数据可能晚于本事件被处理（攒批），内存块和在途
+	 * perf记录统一在整个burst处理完成后释放。
+	 */
+	for (j = 0; j < nb_rx; j++) {
+		block_head = (struct mem_block_head *)datas_burst[j] - 1;
+		if (block_head->is_last == 1) {
+			if (block_head->reader != NULL)
+				perf_reader_record_put(block_head->reader,
+						       block_head->record_slot);
+			block_heap_put(block_head->free_ptr);
+		}
 	}
 }
 
@@ -421,7 +709,35 @@ int tracer_probes_init(struct bpf_tracer *tracer);
 int tracer_hooks_attach(struct bpf_tracer *tracer);
 int tracer_hooks_detach(struct bpf_tracer *tracer);
 int perf_map_init(struct bpf_tracer *tracer, const char *perf_map_name);
+// BPF ringbuf方式的数据通道初始化（与perf_map_init()二选一）
+int ringbuf_map_init(struct bpf_tracer *tracer, const char *rb_map_name);
 int dispatch_worker(struct bpf_tracer *tracer, unsigned int queue_size);
+// 设置perf ring-buffer读取方式，需要在dispatch_worker()之前调用
+int set_perf_reader_mode(enum perf_reader_mode mode);
+// perf记录零拷贝消费开关，需要在tracer启动之前调用
+int set_perf_zero_copy(bool enabled);
+// 按丢失事件反馈自适应调整每CPU perf buffer大小的开关
+int set_perf_adaptive_sizing(bool enabled);
+// 全部CPU合计的perf buffer页预算，0表示配置页数*读者数
+int set_perf_buffer_budget(uint32_t pages);
+enum perf_reader_mode get_perf_reader_mode(void);
+// 读取线程阻塞等待前的busy-poll窗口（微秒），0表示无数据直接阻塞
+int set_perf_busy_poll_us(uint32_t time_us);
+uint32_t get_perf_busy_poll_us(void);
+// 开启/关闭dispatch队列间的work stealing，需在dispatch_worker()之前调用
+int set_dispatch_work_stealing(bool enabled);
+int set_dispatch_autoscale(bool enabled);
+int set_memory_hugepages(bool enabled);
+/*
+ * 本线程所在的NUMA节点，perf读取线程绑核后设置（其余线程为-1）。
+ * 装配路径按此优先把数据分发到本节点的队列。
+ */
+extern __thread int thread_numa_node;
+// 消费worker park之前的spin窗口（微秒），0表示队列空了立即park
+int set_worker_spin_us(uint32_t time_us);
+uint32_t get_worker_spin_us(void);
+// 队列积压超过水线时唤醒相邻队列的worker前来偷取，生产者enqueue后调用
+void queue_stealer_wakeup(struct bpf_tracer *t, struct queue *q);
 int check_kernel_version(int maj_limit, int min_limit);
 int register_extra_waiting_op(const char *name,
 			      extra_waiting_fun_t f, int type);
@@ -437,6 +753,11 @@ int maps_config(struct bpf_tracer *tracer, const char *map_name, int entries);
 struct bpf_tracer *find_bpf_tracer(const char *name);
 int register_period_event_op(const char *name, period_event_fun_t f);
 int set_period_event_invalid(const char *name);
+/*
+ * 开启BPF运行时统计并登记tracer所有已加载程序，注册周期采样。
+ * 内核不支持（< 5.8且无sysctl）时降级为不采样，不算错误。
+ */
+int tracer_prog_stats_init(struct bpf_tracer *tracer);
 // 停止tracer运行。返回值：0：成功，非0：失败
 int tracer_stop(void);
 // 开启tracer运行。返回值：0：成功，非0：失败
@@ -458,7 +779,19 @@ void add_probe_to_tracer(struct probe *pb);
  * @pb struct probe
  */
 void free_probe_from_tracer(struct probe *pb);
+/**
+ * probe_attach - eBPF probe attach
+ * @p struct probe
+ *
+ * @return 0 if ok, not 0 on error
+ */
+int probe_attach(struct probe *p);
 int tracer_hooks_process(struct bpf_tracer *tracer,
 			 enum tracer_hook_type type, int *probes_count);
 int tracer_uprobes_update(struct bpf_tracer *tracer);
+// 为conf中新增的kprobe符号补建probe对象（增量启用探针组）
+int tracer_kprobes_update(struct bpf_tracer *tracer);
+// 按名称附着/解除单个tracepoint
+int tracer_tracepoint_process(struct bpf_tracer *tracer, const char *tp_name,
+			      enum tracer_hook_type type);
 #endif
@@ -876,6 +876,7 @@ impl EbpfCollector {
                 524288, /* 设置用于socket追踪的hash表项最大值，取决于实际场景中并发请求数量 */
                 524288, /* 设置用于线程追踪会话的hash表项最大值，SK_BPF_DATA结构的syscall_trace_id_session关联这个哈希表 */
                 520000, /* socket map表项进行清理的最大阈值，当前map的表项数量超过这个值进行map清理操作 */
+                ebpf::TRACE_CAP_ALL, /* 探针能力组掩码，全部开启 */
             ) != 0
             {
                 return Err(Error::EbpfRunningError);